@@ -0,0 +1,21 @@
+#version 330 core
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec2 a_texture_position;
+layout(location = 2) in float a_texture_face;
+layout(location = 3) in float a_texture_index;
+
+uniform mat4 u_view_matrix;
+uniform mat4 u_projection_matrix;
+
+out vec2 fragment_a_texture_position;
+flat out float fragment_a_texture_face;
+flat out float fragment_a_texture_index;
+
+void main() {
+    gl_Position = u_projection_matrix * u_view_matrix * vec4(a_position, 1);
+
+    fragment_a_texture_position = a_texture_position;
+    fragment_a_texture_face = a_texture_face;
+    fragment_a_texture_index = a_texture_index;
+}
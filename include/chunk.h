@@ -4,28 +4,57 @@
 #define CHUNK_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "config.h"
 #include "tinycthread/tinycthread.h"
 #include "camera.h"
 #include "random.h"
+#include "column_cache.h"
+#include "chunk_storage.h"
+#include "slab.h"
+#include "perlin/perlin.h"
 #include "geometry/block.h"
+#include "geometry/chunk_mesh.h"
 
 #define CHUNK_DATA_SIZE (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
-#define CHUNK_DATA_VISIBLE_BIT (1 << 7)
-#define CHUNK_COMPRESSED_DATA_REPEAT_BIT (1 << 7)
+#define CHUNK_FACE_BIT(block_side) (1 << (block_side))
 
+// The block storage is only written by the render thread when holding the chunk lock, the workers
+// only read it when holding the chunk lock. The mesh vertices and the database writes of a chunk are
+// also only touched when holding the chunk lock, the faces are swapped when holding the chunk lock but
+// the render thread reads them without it via chunk_get_faces. Only chunks with player edits are
+// written to the database, the others are generated again from the world seed when needed
 typedef struct Chunk {
     int x;
     int y;
     int z;
     bool is_changed;
+    bool is_modified; // Has player edits that are not written to the database yet
     bool is_lighted;
     bool is_relighted;
-    uint8_t* data;
+    int references;
+    int last_used_tick;
+    int cache_index; // The index in the chunk cache of the world
+    size_t cache_memory_size; // The memory size that the chunk cache counts for this chunk
+    ChunkStorage* storage;
+    uint8_t* faces; // The air touching faces of every block, one CHUNK_FACE_BIT per block side, never NULL
+    ChunkMesh* mesh;
     mtx_t chunk_lock;
 } Chunk;
 
+extern uint8_t CHUNK_EMPTY_FACES[CHUNK_DATA_SIZE];
+
+extern Slab* chunk_slab;
+
+extern Slab* chunk_faces_slab;
+
+typedef enum ChunkGenerateType {
+    CHUNK_GENERATE_TYPE_EMPTY,
+    CHUNK_GENERATE_TYPE_SOLID,
+    CHUNK_GENERATE_TYPE_MIXED
+} ChunkGenerateType;
+
 typedef struct BlockPosition {
     int chunk_x;
     int chunk_y;
@@ -38,19 +67,57 @@ typedef struct BlockPosition {
 
 #include "world.h"
 
-BlockType chunk_generate_block(Random *random, int x, int y, int z);
+void chunk_init_slabs(void);
+
+void chunk_generate_columns_row(PerlinNoise* perlin, int x, int z, int heights[CHUNK_SIZE], int drynesses[CHUNK_SIZE]);
+
+BlockType chunk_generate_block(Random *random, int height, int dryness, int y);
+
+ChunkGenerateType chunk_generate_classify(int chunk_y, int min_height, int max_height);
+
+Chunk* chunk_new_from_generator(World* world, int chunk_x, int chunk_y, int chunk_z);
+
+Chunk* chunk_new_from_data(int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data);
+
+Chunk* chunk_new_from_storage(int chunk_x, int chunk_y, int chunk_z, ChunkStorage* chunk_storage);
+
+BlockType chunk_get_block(Chunk* chunk, int block_x, int block_y, int block_z);
+
+void chunk_set_block(Chunk* chunk, int block_x, int block_y, int block_z, BlockType block_type);
 
-Chunk* chunk_new_from_generator(int chunk_x, int chunk_y, int chunk_z);
+extern int CHUNK_BLOCK_SIDE_OFFSETS[BLOCK_SIDE_SIZE][3];
 
-Chunk* chunk_new_from_data(int chunk_x, int chunk_y, int chunk_z, uint8_t* chunk_data);
+uint16_t chunk_get_solid_row(ChunkStorage* chunk_storage, int block_y, int block_z);
+
+void chunk_get_solid_rows(uint16_t* chunk_data, uint16_t* solid_rows);
+
+void chunk_get_border_rows(Chunk* chunk, BlockSide block_side, uint16_t* border_rows);
+
+void chunk_get_face_rows(uint16_t* chunk_data, uint16_t border_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE], uint16_t face_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE]);
+
+void chunk_set_faces_row(uint8_t* faces, int block_y, int block_z, uint16_t face_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE]);
+
+void chunk_build_mesh(ChunkMesh* chunk_mesh, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data, uint16_t face_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE]);
 
 void chunk_update(Chunk* chunk, World* world);
 
 bool chunk_is_visible(Chunk* chunk, Camera* camera);
 
-uint8_t* chunk_data_compress(uint8_t* chunk_data);
+bool chunk_is_in_frustum(int chunk_x, int chunk_y, int chunk_z, Camera* camera);
+
+void chunk_retain(Chunk* chunk);
+
+void chunk_release(Chunk* chunk);
+
+bool chunk_is_uniform(Chunk* chunk);
+
+bool chunk_is_lighted(Chunk* chunk);
+
+uint8_t* chunk_get_faces(Chunk* chunk);
+
+bool chunk_is_empty(Chunk* chunk);
 
-uint8_t* chunk_data_decompress(uint8_t* compressed_data);
+size_t chunk_get_memory_size(Chunk* chunk);
 
 void chunk_free(Chunk* chunk);
 
@@ -0,0 +1,31 @@
+// PlaatCraft - Chunk Codec Header
+
+#ifndef CHUNK_CODEC_H
+#define CHUNK_CODEC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+
+#define CHUNK_CODEC_BLOCKS_COUNT (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+#define CHUNK_CODEC_VERSION 2 // Version 1 is the legacy run length encoding
+#define CHUNK_CODEC_VERSION_BIT (1 << 15) // Set in the size header of all versions after version 1
+#define CHUNK_CODEC_HEADER_SIZE 6
+#define CHUNK_CODEC_MAX_SIZE (CHUNK_CODEC_HEADER_SIZE + CHUNK_CODEC_BLOCKS_COUNT * 2 * 2)
+#define CHUNK_CODEC_LEGACY_REPEAT_BIT (1 << 7)
+
+// The ways the palette indices of a version 2 chunk are stored
+typedef enum ChunkCodecMode {
+    CHUNK_CODEC_MODE_UNIFORM, // The palette has one block type so there are no indices
+    CHUNK_CODEC_MODE_PACKED, // The indices packed in 64 bits little endian words like the chunk storage
+    CHUNK_CODEC_MODE_RUNS // Runs of one index as the index with a run length flag and the run length when it is set
+} ChunkCodecMode;
+
+// A version 2 chunk starts with the size with the version bit set, the version, the mode and the palette size
+// as two bytes, then the palette as two bytes per block type and the indices. All numbers are little endian
+
+int chunk_codec_encode(uint16_t* blocks, uint8_t* buffer);
+
+bool chunk_codec_decode(uint8_t* data, int size, uint16_t* blocks);
+
+#endif
@@ -0,0 +1,35 @@
+// PlaatCraft - Chunk Index Header
+
+#ifndef CHUNK_INDEX_H
+#define CHUNK_INDEX_H
+
+#include <stdint.h>
+
+typedef struct ChunkIndexEntry {
+    int x;
+    int y;
+    int z;
+    struct Chunk* chunk;
+} ChunkIndexEntry;
+
+// An open addressing hash table from chunk position to chunk, the writers
+// must hold one shared lock but the readers can read without any locking
+typedef struct ChunkIndex {
+    ChunkIndexEntry* entries;
+    int capacity;
+    unsigned int sequence;
+} ChunkIndex;
+
+ChunkIndex* chunk_index_new(int capacity);
+
+uint32_t chunk_index_hash(int chunk_x, int chunk_y, int chunk_z);
+
+struct Chunk* chunk_index_get(ChunkIndex* chunk_index, int chunk_x, int chunk_y, int chunk_z);
+
+void chunk_index_set(ChunkIndex* chunk_index, int chunk_x, int chunk_y, int chunk_z, struct Chunk* chunk);
+
+void chunk_index_remove(ChunkIndex* chunk_index, int chunk_x, int chunk_y, int chunk_z);
+
+void chunk_index_free(ChunkIndex* chunk_index);
+
+#endif
@@ -0,0 +1,52 @@
+// PlaatCraft - Chunk Storage Header
+
+#ifndef CHUNK_STORAGE_H
+#define CHUNK_STORAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "geometry/block.h"
+#include "slab.h"
+
+#define CHUNK_STORAGE_SIZE (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+#define CHUNK_STORAGE_MAX_BITS 16
+#define CHUNK_STORAGE_BITS_COUNT 5 // 1, 2, 4, 8 and 16 bits per block need indices
+
+// The blocks of a chunk as indices in a palette of block types, the indices are packed in
+// 64 bits words with 0, 1, 2, 4, 8 or 16 bits per block and grow when the palette is full
+typedef struct ChunkStorage {
+    uint16_t* palette;
+    int palette_size;
+    int bits;
+    uint64_t* indices;
+} ChunkStorage;
+
+extern Slab* chunk_storage_slab;
+
+extern Slab* chunk_storage_indices_slabs[CHUNK_STORAGE_BITS_COUNT];
+
+void chunk_storage_init_slabs(void);
+
+int chunk_storage_get_indices_slab_index(int bits);
+
+ChunkStorage* chunk_storage_new(BlockType block_type);
+
+ChunkStorage* chunk_storage_new_from_blocks(uint16_t* blocks);
+
+int chunk_storage_get_palette_capacity(ChunkStorage* chunk_storage);
+
+BlockType chunk_storage_get(ChunkStorage* chunk_storage, int index);
+
+void chunk_storage_set(ChunkStorage* chunk_storage, int index, BlockType block_type);
+
+void chunk_storage_decode(ChunkStorage* chunk_storage, uint16_t* blocks);
+
+bool chunk_storage_is_uniform(ChunkStorage* chunk_storage);
+
+size_t chunk_storage_get_memory_size(ChunkStorage* chunk_storage);
+
+void chunk_storage_free(ChunkStorage* chunk_storage);
+
+#endif
@@ -0,0 +1,41 @@
+// PlaatCraft - Column Cache Header
+
+#ifndef COLUMN_CACHE_H
+#define COLUMN_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "config.h"
+#include "tinycthread/tinycthread.h"
+
+#define COLUMN_CACHE_LOCKS_COUNT 16
+
+// The generated height and dryness maps of one column of chunks
+typedef struct ColumnCacheEntry {
+    int chunk_x;
+    int chunk_z;
+    bool is_used;
+    int heights[CHUNK_SIZE][CHUNK_SIZE];
+    int drynesses[CHUNK_SIZE][CHUNK_SIZE];
+} ColumnCacheEntry;
+
+// A direct mapped cache of chunk column maps, the entries are guarded by striped locks
+typedef struct ColumnCache {
+    ColumnCacheEntry* entries;
+    int capacity;
+    mtx_t locks[COLUMN_CACHE_LOCKS_COUNT];
+    int hits_count;
+    int misses_count;
+} ColumnCache;
+
+ColumnCache* column_cache_new(int capacity);
+
+bool column_cache_get(ColumnCache* column_cache, int chunk_x, int chunk_z, int heights[CHUNK_SIZE][CHUNK_SIZE], int drynesses[CHUNK_SIZE][CHUNK_SIZE]);
+
+void column_cache_set(ColumnCache* column_cache, int chunk_x, int chunk_z, int heights[CHUNK_SIZE][CHUNK_SIZE], int drynesses[CHUNK_SIZE][CHUNK_SIZE]);
+
+size_t column_cache_get_memory_size(ColumnCache* column_cache);
+
+void column_cache_free(ColumnCache* column_cache);
+
+#endif
@@ -3,26 +3,42 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
-#include <sqlite3.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+#include "database_backend.h"
 #include "tinycthread/tinycthread.h"
 
+// The world database on top of a storage backend. The chunk writes are buffered so the workers never wait
+// for the backend, a newer write of the same chunk replaces the buffered one. The writer thread swaps the
+// buffer with the flushing writes and puts them in one batch, loads look in both so they always see the
+// newest chunk data. Both write lists have a hash map of twice there capacity on the packed chunk key, a slot
+// is the write index plus one or zero when it is empty
 typedef struct Database {
-    sqlite3* database;
-    mtx_t database_lock;
-    int database_changes;
-
-    sqlite3_stmt* settings_select_statement;
-    sqlite3_stmt* settings_insert_statement;
-    sqlite3_stmt* settings_update_statement;
-
-    sqlite3_stmt* chunks_select_statement;
-    sqlite3_stmt* chunks_insert_statement;
-    sqlite3_stmt* chunks_update_statement;
+    DatabaseBackendType* backend_type;
+    void* backend;
+
+    mtx_t writes_lock;
+    cnd_t writes_condition;
+    DatabaseChunkWrite* writes;
+    int writes_count;
+    int writes_capacity;
+    int* writes_slots;
+    DatabaseChunkWrite* flushing_writes;
+    int flushing_writes_count;
+    int flushing_writes_capacity;
+    int* flushing_writes_slots;
+    bool writer_running;
+    thrd_t writer_thread;
+    int flushes_count;
+    int flushed_writes_count;
 } Database;
 
 #include "chunk.h" // Fix circle dependancy
 
-Database* database_new(void);
+DatabaseBackendType* database_get_backend_type(char* name);
+
+Database* database_new(char* path, DatabaseBackendType* backend_type);
 
 
 char* database_settings_get_string(Database* database, char* key, char* default_value);
@@ -39,14 +55,19 @@ void database_settings_set_int(Database* database, char* key, int value);
 void database_settings_set_float(Database* database, char* key, float value);
 
 
+int64_t database_get_chunk_key(int chunk_x, int chunk_y, int chunk_z);
+
+void database_get_chunk_position(int64_t key, int* chunk_x, int* chunk_y, int* chunk_z);
+
 Chunk* database_chunks_get_chunk(Database* database, int chunk_x, int chunk_y, int chunk_z);
 
 void database_chunks_set_chunk(Database* database, Chunk* chunk);
 
+void database_chunks_iterate(Database* database, DatabaseChunkCallback callback, void* argument);
 
-void database_commit(Database* database);
+void database_chunks_flush(Database* database);
 
-void database_check_commit(Database* database);
+int database_writer_thread(void* argument);
 
 
 void database_free(Database* database);
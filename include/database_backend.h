@@ -0,0 +1,38 @@
+// PlaatCraft - Database Backend Header
+
+#ifndef DATABASE_BACKEND_H
+#define DATABASE_BACKEND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A compressed chunk that waits in the write behind buffer until the writer thread flushes it
+typedef struct DatabaseChunkWrite {
+    int x;
+    int y;
+    int z;
+    uint8_t* compressed_data;
+    int compressed_size;
+} DatabaseChunkWrite;
+
+typedef void (*DatabaseChunkCallback)(void* argument, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size);
+
+// The operations of a storage backend, the backend pointer is what open returned. Get chunk is called
+// by many workers at once, the chunk puts only by one thread at a time and the settings by the render thread.
+// Get setting returns a copy of the value or NULL, get chunk decodes the chunk to the chunk data
+// and returns false when it is missing or can't be decoded
+typedef struct DatabaseBackendType {
+    char* name;
+    char* path; // The path of the world of the game
+    void* (*open)(char* path);
+    char* (*get_setting)(void* backend, char* key);
+    void (*set_setting)(void* backend, char* key, char* value);
+    bool (*get_chunk)(void* backend, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data);
+    void (*put_chunk)(void* backend, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size);
+    void (*put_chunks)(void* backend, DatabaseChunkWrite* writes, int writes_count);
+    void (*iterate_chunks)(void* backend, DatabaseChunkCallback callback, void* argument);
+    void (*flush)(void* backend);
+    void (*close)(void* backend);
+} DatabaseBackendType;
+
+#endif
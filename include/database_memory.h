@@ -0,0 +1,52 @@
+// PlaatCraft - Database Memory Header
+
+#ifndef DATABASE_MEMORY_H
+#define DATABASE_MEMORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "database_backend.h"
+#include "tinycthread/tinycthread.h"
+
+#define DATABASE_MEMORY_EMPTY_KEY -1 // Packed chunk keys are never negative
+
+typedef struct DatabaseMemoryChunk {
+    int64_t key;
+    uint8_t* compressed_data;
+    int compressed_size;
+} DatabaseMemoryChunk;
+
+// A backend that keeps everything in memory for tests and benchmarks, the chunks are in an open
+// addressing hash map on the packed chunk key that grows when it is half full
+typedef struct DatabaseMemory {
+    mtx_t lock;
+    char** setting_keys;
+    char** setting_values;
+    int settings_count;
+    int settings_capacity;
+    DatabaseMemoryChunk* chunks;
+    int chunks_count;
+    int chunks_capacity;
+} DatabaseMemory;
+
+extern DatabaseBackendType DATABASE_BACKEND_MEMORY;
+
+void* database_memory_open(char* path);
+
+char* database_memory_get_setting(void* backend, char* key);
+
+void database_memory_set_setting(void* backend, char* key, char* value);
+
+bool database_memory_get_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data);
+
+void database_memory_put_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size);
+
+void database_memory_put_chunks(void* backend, DatabaseChunkWrite* writes, int writes_count);
+
+void database_memory_iterate_chunks(void* backend, DatabaseChunkCallback callback, void* argument);
+
+void database_memory_flush(void* backend);
+
+void database_memory_close(void* backend);
+
+#endif
@@ -0,0 +1,78 @@
+// PlaatCraft - Database Region Header
+
+#ifndef DATABASE_REGION_H
+#define DATABASE_REGION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "database_backend.h"
+#include "database_memory.h"
+#include "tinycthread/tinycthread.h"
+
+#define DATABASE_REGION_SIZE_SHIFT 5
+#define DATABASE_REGION_SIZE (1 << DATABASE_REGION_SIZE_SHIFT) // Chunks per side of a region file
+#define DATABASE_REGION_CHUNKS_COUNT (DATABASE_REGION_SIZE * DATABASE_REGION_SIZE * DATABASE_REGION_SIZE)
+
+#define DATABASE_REGION_ENTRY_SIZE 8 // The offset and size of an entry as little endian 32 bits numbers
+
+// The place of a chunk in a region file, a zero size means the chunk is not in the region.
+// Also used for the free extents of a region file
+typedef struct DatabaseRegionEntry {
+    uint32_t offset;
+    uint32_t size;
+} DatabaseRegionEntry;
+
+// A region file starts with the offset table of all its chunks followed by the compressed chunks,
+// a chunk write goes to a free extent or is appended and then its entry is updated so readers never see
+// half written data. The old extent of a rewritten chunk is pending until no reader can use it anymore
+// and then free for new writes. A region without a file has a file of minus one and no entries so
+// unexplored regions stay small
+typedef struct DatabaseRegion {
+    int x;
+    int y;
+    int z;
+    int file;
+    uint32_t end;
+    bool is_changed;
+    DatabaseRegionEntry* entries;
+    DatabaseRegionEntry* free_extents; // Sorted on offset and never touching each other
+    int free_extents_count;
+    int free_extents_capacity;
+    DatabaseRegionEntry* pending_extents;
+    int pending_extents_count;
+    int pending_extents_capacity;
+} DatabaseRegion;
+
+// A backend that packs the chunks of a world directory in region files and keeps the
+// settings in a text file, the opened regions stay open until the backend is closed
+typedef struct DatabaseRegionFiles {
+    char* path;
+    mtx_t lock;
+    int readers_count; // The chunk reads that are busy without holding the lock
+    DatabaseRegion** regions;
+    int regions_count;
+    int regions_capacity;
+    DatabaseMemory* settings;
+} DatabaseRegionFiles;
+
+extern DatabaseBackendType DATABASE_BACKEND_REGION;
+
+void* database_region_open(char* path);
+
+char* database_region_get_setting(void* backend, char* key);
+
+void database_region_set_setting(void* backend, char* key, char* value);
+
+bool database_region_get_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data);
+
+void database_region_put_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size);
+
+void database_region_put_chunks(void* backend, DatabaseChunkWrite* writes, int writes_count);
+
+void database_region_iterate_chunks(void* backend, DatabaseChunkCallback callback, void* argument);
+
+void database_region_flush(void* backend);
+
+void database_region_close(void* backend);
+
+#endif
@@ -0,0 +1,61 @@
+// PlaatCraft - Database SQLite Header
+
+#ifndef DATABASE_SQLITE_H
+#define DATABASE_SQLITE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "config.h"
+#include "database_backend.h"
+#include "tinycthread/tinycthread.h"
+
+// A read only connection for chunk loads, the database is in WAL mode so loads never wait for the writer
+typedef struct DatabaseSqliteReader {
+    sqlite3* database;
+    mtx_t lock;
+    sqlite3_stmt* chunks_select_statement;
+} DatabaseSqliteReader;
+
+// The SQLite backend, the settings and the chunk writes use the writer connection in an always open transaction
+typedef struct DatabaseSqlite {
+    sqlite3* database;
+    mtx_t database_lock;
+    int database_changes;
+
+    DatabaseSqliteReader readers[DATABASE_READERS_COUNT];
+    unsigned int readers_index;
+
+    sqlite3_stmt* settings_select_statement;
+    sqlite3_stmt* settings_insert_statement;
+    sqlite3_stmt* settings_update_statement;
+
+    sqlite3_stmt* chunks_upsert_statement;
+    sqlite3_stmt* chunks_select_all_statement;
+} DatabaseSqlite;
+
+extern DatabaseBackendType DATABASE_BACKEND_SQLITE;
+
+void* database_sqlite_open(char* path);
+
+char* database_sqlite_get_setting(void* backend, char* key);
+
+void database_sqlite_set_setting(void* backend, char* key, char* value);
+
+bool database_sqlite_get_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data);
+
+void database_sqlite_put_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size);
+
+void database_sqlite_put_chunks(void* backend, DatabaseChunkWrite* writes, int writes_count);
+
+void database_sqlite_iterate_chunks(void* backend, DatabaseChunkCallback callback, void* argument);
+
+void database_sqlite_commit(DatabaseSqlite* database);
+
+void database_sqlite_check_commit(DatabaseSqlite* database);
+
+void database_sqlite_flush(void* backend);
+
+void database_sqlite_close(void* backend);
+
+#endif
@@ -7,6 +7,7 @@
 #include <GLFW/glfw3.h>
 #include "font.h"
 #include "shaders/block_shader.h"
+#include "shaders/chunk_shader.h"
 #include "shaders/flat_shader.h"
 #include "textures/texture_atlas.h"
 #include "textures/texture.h"
@@ -30,6 +31,7 @@ typedef struct Game {
     Font* text_font;
 
     BlockShader* block_shader;
+    ChunkShader* chunk_shader;
     FlatShader* flat_shader;
 
     TextureAtlas* blocks_texture_atlas;
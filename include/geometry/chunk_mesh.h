@@ -0,0 +1,41 @@
+// PlaatCraft - Chunk Mesh Geometry Header
+
+#ifndef CHUNK_MESH_H
+#define CHUNK_MESH_H
+
+#include <stdbool.h>
+#include "glad/glad.h"
+#include "geometry/block.h"
+
+// Vertex position, Texture position, Texture face, Texture index
+#define CHUNK_MESH_VERTEX_SIZE 7
+#define CHUNK_MESH_FACE_VERTICES_COUNT 6
+
+extern int CHUNK_MESH_BLOCK_SIDE_FACES[BLOCK_SIDE_SIZE];
+
+typedef struct ChunkMesh {
+    float* vertices;
+    int vertices_count;
+    int vertices_capacity;
+    bool is_changed;
+
+    GLuint vertex_array;
+    GLuint vertex_buffer;
+    int uploaded_vertices_count;
+} ChunkMesh;
+
+ChunkMesh* chunk_mesh_new(void);
+
+void chunk_mesh_clear(ChunkMesh* chunk_mesh);
+
+void chunk_mesh_add_face(ChunkMesh* chunk_mesh, int x, int y, int z, BlockSide block_side, BlockType block_type);
+
+void chunk_mesh_upload(ChunkMesh* chunk_mesh);
+
+void chunk_mesh_enable(ChunkMesh* chunk_mesh);
+
+void chunk_mesh_disable(ChunkMesh* chunk_mesh);
+
+void chunk_mesh_free(ChunkMesh* chunk_mesh);
+
+#endif
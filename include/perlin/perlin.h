@@ -5,14 +5,19 @@
 #define PERLIN_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
-extern int64_t perlin_seed;
+extern int perlin_permutation[256];
 
-extern int perlin_p[512];
+extern double perlin_gradients[16 * 3];
 
-extern int perlin_permutation[256];
+// A noise context, the tables are only written by perlin_new so many threads can share it
+typedef struct PerlinNoise {
+    int64_t seed;
+    int p[512];
+} PerlinNoise;
 
-void perlin_init(int64_t seed);
+PerlinNoise* perlin_new(int64_t seed, bool is_permutation_seeded);
 
 double perlin_fade(double t);
 
@@ -20,6 +25,16 @@ double perlin_lerp(double t, double a, double b);
 
 double perlin_grad(int hash, double x, double y, double z);
 
-double perlin_noise(double x, double y, double z);
+double perlin_noise(PerlinNoise* perlin, double x, double y, double z);
+
+void perlin_noise_batch(PerlinNoise* perlin, double* x, double* y, double* z, double* noises, int count);
+
+#ifndef NO_SIMD
+    void perlin_noise_batch_sse2(PerlinNoise* perlin, double* x, double* y, double* z, double* noises, int count);
+
+    void perlin_noise_batch_avx2(PerlinNoise* perlin, double* x, double* y, double* z, double* noises, int count);
+#endif
+
+void perlin_free(PerlinNoise* perlin);
 
 #endif
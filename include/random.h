@@ -4,13 +4,23 @@
 #define RANDOM_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef struct Random {
     int64_t seed;
+    bool is_counter_based;
+    uint64_t key;
+    uint64_t counter;
 } Random;
 
 Random* random_new(int64_t seed);
 
+Random* random_new_counter_based(int64_t seed);
+
+uint64_t random_mix(uint64_t x);
+
+void random_seek(Random* random, int x, int y, int z);
+
 double random_random(Random* random);
 
 double random_rand(Random* random, int min, int max);
@@ -0,0 +1,33 @@
+// PlaatCraft - Request Queue Header
+
+#ifndef REQUEST_QUEUE_H
+#define REQUEST_QUEUE_H
+
+#include <stdbool.h>
+
+typedef struct RequestQueueCell {
+    unsigned int sequence;
+    void* item;
+} RequestQueueCell;
+
+// A bounded lock-free multi producer multi consumer ring buffer, the positions
+// are on there own cache lines so producers and consumers don't fight over them
+typedef struct RequestQueue {
+    RequestQueueCell* cells;
+    unsigned int mask;
+    char padding1[64];
+    unsigned int enqueue_position;
+    char padding2[64];
+    unsigned int dequeue_position;
+    char padding3[64];
+} RequestQueue;
+
+RequestQueue* request_queue_new(int capacity);
+
+bool request_queue_push(RequestQueue* request_queue, void* item);
+
+void* request_queue_pop(RequestQueue* request_queue);
+
+void request_queue_free(RequestQueue* request_queue);
+
+#endif
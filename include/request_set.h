@@ -0,0 +1,29 @@
+// PlaatCraft - Request Set Header
+
+#ifndef REQUEST_SET_H
+#define REQUEST_SET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "tinycthread/tinycthread.h"
+
+// An open addressing hash set of non zero keys, checking for a key is lock free
+// and adding or removing keys is serialized by the set lock
+typedef struct RequestSet {
+    uint64_t* keys;
+    int capacity;
+    unsigned int sequence;
+    mtx_t request_set_lock;
+} RequestSet;
+
+RequestSet* request_set_new(int capacity);
+
+bool request_set_contains(RequestSet* request_set, uint64_t key);
+
+bool request_set_add(RequestSet* request_set, uint64_t key);
+
+void request_set_remove(RequestSet* request_set, uint64_t key);
+
+void request_set_free(RequestSet* request_set);
+
+#endif
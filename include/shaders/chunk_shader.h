@@ -0,0 +1,24 @@
+// PlaatCraft - Chunk Shader Header
+
+#ifndef CHUNK_SHADER_H
+#define CHUNK_SHADER_H
+
+#include "shaders/shader.h"
+
+typedef struct ChunkShader {
+    Shader* shader;
+
+    GLint view_matrix_uniform;
+    GLint projection_matrix_uniform;
+    GLint is_flat_shaded_uniform;
+} ChunkShader;
+
+ChunkShader* chunk_shader_new(void);
+
+void chunk_shader_enable(ChunkShader* chunk_shader);
+
+void chunk_shader_disable(ChunkShader* chunk_shader);
+
+void chunk_shader_free(ChunkShader* chunk_shader);
+
+#endif
@@ -0,0 +1,50 @@
+// PlaatCraft - Slab Header
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include "tinycthread/tinycthread.h"
+
+#define SLAB_REGION_SIZE (1024 * 1024)
+#define SLAB_THREAD_CACHES_COUNT 66 // The render thread, the world workers and some spare ones
+#define SLAB_THREAD_CACHE_COUNT 32
+#define SLAB_THREAD_CACHE_BATCH_COUNT 16
+
+// A small stack of free objects that only one thread uses, on its own cache lines
+typedef struct SlabThreadCache {
+    void* objects[SLAB_THREAD_CACHE_COUNT];
+    int objects_count;
+    char padding[64];
+} SlabThreadCache;
+
+// A pool of objects of one size carved out of large mapped regions, the free objects are linked
+// via there first word. Threads that started with slab_thread_start use a cache without locking
+typedef struct Slab {
+    size_t object_size;
+    int region_objects_count;
+    mtx_t lock;
+    void* free_objects;
+    void** regions;
+    int regions_count;
+    int regions_capacity;
+    int used_count;
+    int allocations_count;
+    SlabThreadCache thread_caches[SLAB_THREAD_CACHES_COUNT];
+} Slab;
+
+void slab_thread_start(void);
+
+void slab_thread_stop(void);
+
+Slab* slab_new(size_t object_size);
+
+void* slab_allocate(Slab* slab);
+
+void slab_deallocate(Slab* slab, void* object);
+
+size_t slab_get_memory_size(Slab* slab);
+
+void slab_free(Slab* slab);
+
+#endif
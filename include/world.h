@@ -7,12 +7,16 @@
 #include "config.h"
 #include "tinycthread/tinycthread.h"
 #include "camera.h"
-#include "shaders/block_shader.h"
+#include "shaders/chunk_shader.h"
 #include "textures/texture_atlas.h"
 
 typedef struct World World; // Fix circle dependancy
 #include "chunk.h"
+#include "chunk_index.h"
 #include "database.h"
+#include "request_queue.h"
+#include "request_set.h"
+#include "perlin/perlin.h"
 
 typedef enum WorldRequestType {
     WORLD_REQUEST_TYPE_CHUNK_NEW = 0,
@@ -21,6 +25,10 @@ typedef enum WorldRequestType {
 
 typedef struct WorldRequest {
     WorldRequestType type;
+    uint64_t key;
+    int priority;
+    bool is_visible;
+    unsigned int player_moves;
     union {
         Chunk* chunk_pointer;
 
@@ -32,38 +40,104 @@ typedef struct WorldRequest {
     } arguments;
 } WorldRequest;
 
+typedef struct WorldEvictCandidate {
+    int score;
+    Chunk* chunk;
+} WorldEvictCandidate;
+
+typedef struct WorldWorker {
+    World* world;
+    int index;
+    thrd_t thread;
+    RequestQueue* request_queues[WORLD_REQUEST_PRIORITY_COUNT];
+} WorldWorker;
+
 struct World {
     int64_t seed;
+    int generator_version;
+    PerlinNoise* perlin;
     bool is_wireframed;
     bool is_flat_shaded;
     int render_distance;
+    int ticks;
+    // Written by the render thread and read by the workers with a sequence lock, the player moves
+    // are odd while the player chunk position is written
+    int player_chunk_x;
+    int player_chunk_y;
+    int player_chunk_z;
+    unsigned int player_moves;
+    Camera* camera;
 
     Database *database;
 
     Chunk* chunk_cache[WORLD_CHUNK_CACHE_COUNT];
-    int chunk_cache_start;
+    int chunk_cache_size;
+    size_t chunk_cache_memory;
+    WorldEvictCandidate* evict_candidates;
+    ChunkIndex* chunk_index;
+    ColumnCache* column_cache;
     mtx_t chunk_cache_lock;
 
-    WorldRequest* request_queue[WORLD_REQUEST_QUEUE_COUNT];
-    int request_queue_size;
-    mtx_t request_queue_lock;
+    Chunk** chunk_garbage;
+    int chunk_garbage_size;
+    int chunk_garbage_capacity;
+    uint8_t** faces_garbage; // Replaced chunk faces that the render thread can still be reading
+    int faces_garbage_size;
+    int faces_garbage_capacity;
+
+    WorldRequest* requests;
+    RequestQueue* request_pool;
+    RequestSet* request_set;
 
-    thrd_t worker_threads[WORLD_WORKER_THREAD_COUNT];
+    WorldWorker workers[WORLD_WORKER_THREAD_MAX_COUNT];
+    int workers_count;
+    unsigned int workers_next;
     bool worker_running;
-    mtx_t worker_running_lock;
+    int pending_requests_count;
+    int cancelled_requests_count;
+    int wasted_generations_count;
+    int sleeping_workers_count;
+    mtx_t worker_lock;
+    cnd_t worker_condition;
 };
 
 World* world_new(Camera* camera, BlockType *selected_block_type);
 
-void world_add_chunk_to_cache(World* world, Chunk* chunk);
+void world_update_chunk_cache_memory(World* world, Chunk* chunk);
+
+void world_remove_chunk_from_cache(World* world, Chunk* chunk);
+
+void world_evict_chunks_from_cache(World* world);
+
+Chunk* world_add_chunk_to_cache(World* world, Chunk* chunk);
 
 Chunk* world_get_chunk(World* world, int chunk_x, int chunk_y, int chunk_z);
 
+void world_get_player_chunk(World* world, int* player_chunk_x, int* player_chunk_y, int* player_chunk_z);
+
+int world_get_player_chunk_distance(World* world, int chunk_x, int chunk_y, int chunk_z);
+
+int world_get_request_priority(World* world, int chunk_x, int chunk_y, int chunk_z, bool is_visible);
+
+void world_cancel_request(World* world, WorldRequest* request);
+
+WorldRequest* world_pop_request(World* world, WorldWorker* worker);
+
+WorldRequest* world_wait_request(World* world, WorldWorker* worker);
+
+uint64_t world_get_request_key(WorldRequestType type, int chunk_x, int chunk_y, int chunk_z);
+
+bool world_push_request(World* world, WorldRequestType type, int chunk_x, int chunk_y, int chunk_z, Chunk* chunk);
+
 Chunk* world_request_chunk(World* world, int chunk_x, int chunk_y, int chunk_z);
 
 void world_request_chunk_update(World* world, Chunk* chunk);
 
-int world_render(World* world, Camera* camera, BlockShader* block_shader, TextureAtlas* blocks_texture_atlas);
+void world_add_faces_garbage(World* world, uint8_t* faces);
+
+void world_free_chunk_garbage(World* world);
+
+int world_render(World* world, Camera* camera, ChunkShader* chunk_shader, TextureAtlas* blocks_texture_atlas);
 
 BlockPosition *world_get_selected_block(World* world, Camera* camera);
 
@@ -73,6 +147,8 @@ void world_set_block(World* world, BlockPosition* block_position, BlockType bloc
 
 void world_free(World* world, Camera* camera, BlockType *selected_block_type);
 
+int world_get_processors_count(void);
+
 int world_worker_thread(void* argument);
 
 #endif
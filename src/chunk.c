@@ -5,15 +5,46 @@
 #include <string.h>
 #include "log.h"
 #include "geometry/block.h"
-#include "perlin/perlin.h"
-
-BlockType chunk_generate_block(Random *random, int x, int y, int z) {
+#ifndef NO_SIMD
+    #ifdef __AVX2__
+        #include <immintrin.h>
+    #else
+        #include <emmintrin.h>
+    #endif
+#endif
+
+// The visibility bitsets store a row of blocks in one 16 bits word
+#if CHUNK_SIZE != 16
+    #error "The chunk visibility bitsets only support a CHUNK_SIZE of 16"
+#endif
+
+// Generate the terrain heights and drynesses of a row of block columns, they only depend on x and z
+void chunk_generate_columns_row(PerlinNoise* perlin, int x, int z, int heights[CHUNK_SIZE], int drynesses[CHUNK_SIZE]) {
     float scale = 64;
     int max_height = 24;
     int sea_level = -5;
-    int height = perlin_noise((float)x / scale, 1, (float)z / scale) * max_height;
-    if (height < sea_level) height = sea_level;
-    int dryness = perlin_noise((float)(x + 1000000) / scale, 1, (float)(z + 1000000) / scale) * (max_height / 2);
+
+    // Evaluate the height and dryness noise of the whole row in one batch
+    double noise_x[CHUNK_SIZE * 2], noise_y[CHUNK_SIZE * 2], noise_z[CHUNK_SIZE * 2], noises[CHUNK_SIZE * 2];
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        noise_x[i] = (float)(x + i) / scale;
+        noise_y[i] = 1;
+        noise_z[i] = (float)z / scale;
+        noise_x[CHUNK_SIZE + i] = (float)(x + i + 1000000) / scale;
+        noise_y[CHUNK_SIZE + i] = 1;
+        noise_z[CHUNK_SIZE + i] = (float)(z + 1000000) / scale;
+    }
+    perlin_noise_batch(perlin, noise_x, noise_y, noise_z, noises, CHUNK_SIZE * 2);
+
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        heights[i] = noises[i] * max_height;
+        if (heights[i] < sea_level) heights[i] = sea_level;
+        drynesses[i] = noises[CHUNK_SIZE + i] * (max_height / 2);
+    }
+}
+
+BlockType chunk_generate_block(Random *random, int height, int dryness, int y) {
+    int sea_level = -5;
 
     // Air layer
     if (y > height) {
@@ -54,19 +85,111 @@ BlockType chunk_generate_block(Random *random, int x, int y, int z) {
     return BLOCK_TYPE_STONE;
 }
 
-Chunk* chunk_new_from_generator(int chunk_x, int chunk_y, int chunk_z) {
-    uint8_t* chunk_data = malloc(CHUNK_DATA_SIZE);
-    memset(chunk_data, BLOCK_TYPE_AIR, CHUNK_DATA_SIZE);
+// The shared faces of all empty chunks, they have no faces that touch air
+uint8_t CHUNK_EMPTY_FACES[CHUNK_DATA_SIZE];
+
+// The chunks and there faces churn while flying so they come from slabs instead of the heap
+Slab* chunk_slab;
+
+Slab* chunk_faces_slab;
+
+once_flag chunk_slabs_once = ONCE_FLAG_INIT;
+
+void chunk_new_slabs(void) {
+    chunk_slab = slab_new(sizeof(Chunk));
+    chunk_faces_slab = slab_new(CHUNK_DATA_SIZE);
+    chunk_storage_init_slabs();
+}
+
+// Create the chunk slabs once, they are shared by all worlds
+void chunk_init_slabs(void) {
+    call_once(&chunk_slabs_once, chunk_new_slabs);
+}
+
+// Classify a chunk by the height range of its columns, trees and cactuses never leave their chunk
+ChunkGenerateType chunk_generate_classify(int chunk_y, int min_height, int max_height) {
+    if (chunk_y * CHUNK_SIZE > max_height) {
+        return CHUNK_GENERATE_TYPE_EMPTY;
+    }
+    if (chunk_y * CHUNK_SIZE + CHUNK_SIZE - 1 < min_height) {
+        return CHUNK_GENERATE_TYPE_SOLID;
+    }
+    return CHUNK_GENERATE_TYPE_MIXED;
+}
+
+Chunk* chunk_new_from_generator(World* world, int chunk_x, int chunk_y, int chunk_z) {
+    // Get the height and dryness maps of the chunk column, they are shared with the chunks above and below
+    int heights[CHUNK_SIZE][CHUNK_SIZE];
+    int drynesses[CHUNK_SIZE][CHUNK_SIZE];
+    if (!column_cache_get(world->column_cache, chunk_x, chunk_z, heights, drynesses)) {
+        for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
+            chunk_generate_columns_row(world->perlin, chunk_x * CHUNK_SIZE, chunk_z * CHUNK_SIZE + block_z, heights[block_z], drynesses[block_z]);
+        }
+        column_cache_set(world->column_cache, chunk_x, chunk_z, heights, drynesses);
+    }
+
+    int min_height = INT32_MAX;
+    int max_height = INT32_MIN;
+    int max_heights[CHUNK_SIZE];
+    for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
+        max_heights[block_z] = INT32_MIN;
+        for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
+            if (heights[block_z][block_x] > max_heights[block_z]) {
+                max_heights[block_z] = heights[block_z][block_x];
+            }
+            if (heights[block_z][block_x] < min_height) {
+                min_height = heights[block_z][block_x];
+            }
+        }
+        if (max_heights[block_z] > max_height) {
+            max_height = max_heights[block_z];
+        }
+    }
+
+    // Empty chunks are one palette entry and use no randomness so they are done
+    ChunkGenerateType generate_type = chunk_generate_classify(chunk_y, min_height, max_height);
+    if (generate_type == CHUNK_GENERATE_TYPE_EMPTY) {
+        return chunk_new_from_storage(chunk_x, chunk_y, chunk_z, chunk_storage_new(BLOCK_TYPE_AIR));
+    }
+
+    uint16_t chunk_data[CHUNK_DATA_SIZE];
 
-    Random *random = random_new(chunk_x + chunk_y + chunk_z);
+    // Older worlds use one sin random stream per chunk so their blocks must still be generated
+    // in z, y, x order, newer worlds use a counter based random stream for each block
+    Random *random = world->generator_version >= 3
+        ? random_new_counter_based(world->seed)
+        : random_new(chunk_x + chunk_y + chunk_z);
 
+    // Solid chunks are below the top layer of every column so they have no air, trees or cactuses
+    if (generate_type == CHUNK_GENERATE_TYPE_SOLID) {
+        for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
+            for (int block_y = 0; block_y < CHUNK_SIZE; block_y++) {
+                int y = chunk_y * CHUNK_SIZE + block_y;
+                for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
+                    random_seek(random, chunk_x * CHUNK_SIZE + block_x, y, chunk_z * CHUNK_SIZE + block_z);
+                    chunk_data[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x] =
+                        chunk_generate_block(random, heights[block_z][block_x], drynesses[block_z][block_x], y);
+                }
+            }
+        }
+        random_free(random);
+        return chunk_new_from_data(chunk_x, chunk_y, chunk_z, chunk_data);
+    }
+
+    memset(chunk_data, BLOCK_TYPE_AIR, sizeof(chunk_data));
     for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
-        for (int block_y = 0; block_y < CHUNK_SIZE; block_y++) {
+        // Rows above the highest column are only air and use no randomness so skip them
+        int block_y_end = max_heights[block_z] - chunk_y * CHUNK_SIZE + 1;
+        if (block_y_end > CHUNK_SIZE) block_y_end = CHUNK_SIZE;
+
+        for (int block_y = 0; block_y < block_y_end; block_y++) {
+            int y = chunk_y * CHUNK_SIZE + block_y;
             for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
                 int block_index = block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x;
+                random_seek(random, chunk_x * CHUNK_SIZE + block_x, y, chunk_z * CHUNK_SIZE + block_z);
 
                 // Change block
-                BlockType blockType = chunk_generate_block(random, chunk_x * CHUNK_SIZE + block_x, chunk_y * CHUNK_SIZE + block_y, chunk_z * CHUNK_SIZE + block_z);
+                BlockType blockType = chunk_generate_block(random, heights[block_z][block_x], drynesses[block_z][block_x], y);
                 if (blockType == BLOCK_TYPE_AIR) {
                     if (
                         chunk_data[block_index] != BLOCK_TYPE_OAK_TRUNK &&
@@ -126,146 +249,337 @@ Chunk* chunk_new_from_generator(int chunk_x, int chunk_y, int chunk_z) {
     return chunk_new_from_data(chunk_x, chunk_y, chunk_z, chunk_data);
 }
 
-Chunk* chunk_new_from_data(int chunk_x, int chunk_y, int chunk_z, uint8_t* chunk_data) {
+// Create a chunk from a flat block array, the blocks are copied to a palette storage
+Chunk* chunk_new_from_data(int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data) {
+    return chunk_new_from_storage(chunk_x, chunk_y, chunk_z, chunk_storage_new_from_blocks(chunk_data));
+}
+
+Chunk* chunk_new_from_storage(int chunk_x, int chunk_y, int chunk_z, ChunkStorage* chunk_storage) {
     log_debug("Chunk create %d %d %d", chunk_x, chunk_y, chunk_z);
 
-    Chunk* chunk = malloc(sizeof(Chunk));
+    Chunk* chunk = slab_allocate(chunk_slab);
     chunk->x = chunk_x;
     chunk->y = chunk_y;
     chunk->z = chunk_z;
     chunk->is_changed = false;
+    chunk->is_modified = false;
     chunk->is_lighted = false;
     chunk->is_relighted = false;
-    chunk->data = chunk_data;
+    chunk->references = 0;
+    chunk->last_used_tick = 0;
+    chunk->cache_index = -1;
+    chunk->cache_memory_size = 0;
+    chunk->storage = chunk_storage;
+    chunk->faces = CHUNK_EMPTY_FACES;
+    chunk->mesh = chunk_mesh_new();
     mtx_init(&chunk->chunk_lock, mtx_plain);
     return chunk;
 }
 
-void chunk_update(Chunk* chunk, World* world) {
-    if (chunk->is_changed || !chunk->is_lighted || !chunk->is_relighted) {
-        log_debug("Chunk update %d %d %d", chunk->x, chunk->y, chunk->z);
+// Only call this on the render thread or when holding the chunk lock
+BlockType chunk_get_block(Chunk* chunk, int block_x, int block_y, int block_z) {
+    return chunk_storage_get(chunk->storage, block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x);
+}
 
-        mtx_lock(&chunk->chunk_lock);
+// Only call this on the render thread, the storage can grow so the workers must not read it meanwhile
+void chunk_set_block(Chunk* chunk, int block_x, int block_y, int block_z, BlockType block_type) {
+    mtx_lock(&chunk->chunk_lock);
+    chunk_storage_set(chunk->storage, block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x, block_type);
+    chunk->is_modified = true;
+    mtx_unlock(&chunk->chunk_lock);
+}
 
-        chunk->is_changed = false;
-        chunk->is_lighted = true;
-        chunk->is_relighted = true;
+// The block offsets of the block sides
+int CHUNK_BLOCK_SIDE_OFFSETS[BLOCK_SIDE_SIZE][3] = {
+    { -1, 0, 0 }, // Left
+    { 1, 0, 0 }, // Right
+    { 0, 1, 0 }, // Above
+    { 0, -1, 0 }, // Below
+    { 0, 0, -1 }, // Front
+    { 0, 0, 1 } // Back
+};
+
+// Get the solid (not air) bitset row of 16 blocks in the x direction from a storage
+uint16_t chunk_get_solid_row(ChunkStorage* chunk_storage, int block_y, int block_z) {
+    if (chunk_storage_is_uniform(chunk_storage)) {
+        return chunk_storage->palette[0] != BLOCK_TYPE_AIR ? 0xffff : 0;
+    }
 
-        for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
+    uint16_t solid_row = 0;
+    int index = block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE;
+    for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
+        if (chunk_storage_get(chunk_storage, index + block_x) != BLOCK_TYPE_AIR) {
+            solid_row |= 1 << block_x;
+        }
+    }
+    return solid_row;
+}
+
+// Get all the solid bitset rows of a decoded chunk indexed by z * CHUNK_SIZE + y
+void chunk_get_solid_rows(uint16_t* chunk_data, uint16_t* solid_rows) {
+    #ifndef NO_SIMD
+        #ifdef __AVX2__
+            // Pack two rows of 16 bits block types to bytes, the pack works per lane so restore the order
+            for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i += 2) {
+                __m256i first_is_air = _mm256_cmpeq_epi16(_mm256_loadu_si256((__m256i*)&chunk_data[i * CHUNK_SIZE]), _mm256_setzero_si256());
+                __m256i second_is_air = _mm256_cmpeq_epi16(_mm256_loadu_si256((__m256i*)&chunk_data[(i + 1) * CHUNK_SIZE]), _mm256_setzero_si256());
+                __m256i is_air = _mm256_permute4x64_epi64(_mm256_packs_epi16(first_is_air, second_is_air), _MM_SHUFFLE(3, 1, 2, 0));
+                uint32_t solid_mask = ~_mm256_movemask_epi8(is_air);
+                solid_rows[i] = solid_mask & 0xffff;
+                solid_rows[i + 1] = solid_mask >> 16;
+            }
+        #else
+            for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++) {
+                __m128i low_is_air = _mm_cmpeq_epi16(_mm_loadu_si128((__m128i*)&chunk_data[i * CHUNK_SIZE]), _mm_setzero_si128());
+                __m128i high_is_air = _mm_cmpeq_epi16(_mm_loadu_si128((__m128i*)&chunk_data[i * CHUNK_SIZE + 8]), _mm_setzero_si128());
+                solid_rows[i] = ~_mm_movemask_epi8(_mm_packs_epi16(low_is_air, high_is_air));
+            }
+        #endif
+    #else
+        for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++) {
+            uint16_t solid_row = 0;
+            for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
+                if (chunk_data[i * CHUNK_SIZE + block_x] != BLOCK_TYPE_AIR) {
+                    solid_row |= 1 << block_x;
+                }
+            }
+            solid_rows[i] = solid_row;
+        }
+    #endif
+}
+
+// Get the solid bitset rows of the border that a neighbour chunk shares with the chunk at its block side, the
+// left and right borders are one shifted bit for every row and the others are one row for every z or y.
+// Don't hold an other chunk lock when calling this because it takes the chunk lock of the neighbour chunk
+void chunk_get_border_rows(Chunk* chunk, BlockSide block_side, uint16_t* border_rows) {
+    mtx_lock(&chunk->chunk_lock);
+    ChunkStorage* chunk_storage = chunk->storage;
+    if (block_side == BLOCK_SIDE_LEFT || block_side == BLOCK_SIDE_RIGHT) {
+        for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++) {
+            if (block_side == BLOCK_SIDE_LEFT) {
+                border_rows[i] = chunk_storage_get(chunk_storage, i * CHUNK_SIZE + CHUNK_SIZE - 1) != BLOCK_TYPE_AIR;
+            } else {
+                border_rows[i] = (chunk_storage_get(chunk_storage, i * CHUNK_SIZE) != BLOCK_TYPE_AIR) << (CHUNK_SIZE - 1);
+            }
+        }
+    } else {
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+            if (block_side == BLOCK_SIDE_BELOW) border_rows[i] = chunk_get_solid_row(chunk_storage, CHUNK_SIZE - 1, i);
+            if (block_side == BLOCK_SIDE_ABOVE) border_rows[i] = chunk_get_solid_row(chunk_storage, 0, i);
+            if (block_side == BLOCK_SIDE_FRONT) border_rows[i] = chunk_get_solid_row(chunk_storage, i, CHUNK_SIZE - 1);
+            if (block_side == BLOCK_SIDE_BACK) border_rows[i] = chunk_get_solid_row(chunk_storage, i, 0);
+        }
+    }
+    mtx_unlock(&chunk->chunk_lock);
+}
+
+// Get for every block side the bitset rows of the solid blocks whose face touches air
+void chunk_get_face_rows(uint16_t* chunk_data, uint16_t border_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE], uint16_t face_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE]) {
+    // Solid rows padded with the border rows of the neighbour chunks indexed by [z + 1][y + 1]
+    uint16_t solid_rows[CHUNK_SIZE + 2][CHUNK_SIZE + 2];
+    uint16_t chunk_solid_rows[CHUNK_SIZE * CHUNK_SIZE];
+    chunk_get_solid_rows(chunk_data, chunk_solid_rows);
+    for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
+        memcpy(&solid_rows[block_z + 1][1], &chunk_solid_rows[block_z * CHUNK_SIZE], CHUNK_SIZE * sizeof(uint16_t));
+        solid_rows[block_z + 1][0] = border_rows[BLOCK_SIDE_BELOW][block_z];
+        solid_rows[block_z + 1][CHUNK_SIZE + 1] = border_rows[BLOCK_SIDE_ABOVE][block_z];
+    }
+    for (int block_y = 0; block_y < CHUNK_SIZE; block_y++) {
+        solid_rows[0][block_y + 1] = border_rows[BLOCK_SIDE_FRONT][block_y];
+        solid_rows[CHUNK_SIZE + 1][block_y + 1] = border_rows[BLOCK_SIDE_BACK][block_y];
+    }
+
+    // The left and right neighbour blocks shifted into the rows
+    uint16_t* left_rows = border_rows[BLOCK_SIDE_LEFT];
+    uint16_t* right_rows = border_rows[BLOCK_SIDE_RIGHT];
+
+    // A face touches air when the block is solid and the neighbour block is not
+    for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
+        #ifndef NO_SIMD
+            #ifdef __AVX2__
+                #define CHUNK_FACE_ROWS_STEP 16
+                #define CHUNK_FACE_ROWS_VECTOR __m256i
+                #define CHUNK_FACE_ROWS_LOAD(rows) _mm256_loadu_si256((__m256i*)(rows))
+                #define CHUNK_FACE_ROWS_STORE(rows, vector) _mm256_storeu_si256((__m256i*)(rows), vector)
+                #define CHUNK_FACE_ROWS_ANDNOT _mm256_andnot_si256
+                #define CHUNK_FACE_ROWS_OR _mm256_or_si256
+                #define CHUNK_FACE_ROWS_SHIFT_LEFT _mm256_slli_epi16
+                #define CHUNK_FACE_ROWS_SHIFT_RIGHT _mm256_srli_epi16
+            #else
+                #define CHUNK_FACE_ROWS_STEP 8
+                #define CHUNK_FACE_ROWS_VECTOR __m128i
+                #define CHUNK_FACE_ROWS_LOAD(rows) _mm_loadu_si128((__m128i*)(rows))
+                #define CHUNK_FACE_ROWS_STORE(rows, vector) _mm_storeu_si128((__m128i*)(rows), vector)
+                #define CHUNK_FACE_ROWS_ANDNOT _mm_andnot_si128
+                #define CHUNK_FACE_ROWS_OR _mm_or_si128
+                #define CHUNK_FACE_ROWS_SHIFT_LEFT _mm_slli_epi16
+                #define CHUNK_FACE_ROWS_SHIFT_RIGHT _mm_srli_epi16
+            #endif
+
+            for (int block_y = 0; block_y < CHUNK_SIZE; block_y += CHUNK_FACE_ROWS_STEP) {
+                int row = block_z * CHUNK_SIZE + block_y;
+                CHUNK_FACE_ROWS_VECTOR solid = CHUNK_FACE_ROWS_LOAD(&solid_rows[block_z + 1][block_y + 1]);
+                CHUNK_FACE_ROWS_STORE(&face_rows[BLOCK_SIDE_LEFT][row], CHUNK_FACE_ROWS_ANDNOT(
+                    CHUNK_FACE_ROWS_OR(CHUNK_FACE_ROWS_SHIFT_LEFT(solid, 1), CHUNK_FACE_ROWS_LOAD(&left_rows[row])), solid));
+                CHUNK_FACE_ROWS_STORE(&face_rows[BLOCK_SIDE_RIGHT][row], CHUNK_FACE_ROWS_ANDNOT(
+                    CHUNK_FACE_ROWS_OR(CHUNK_FACE_ROWS_SHIFT_RIGHT(solid, 1), CHUNK_FACE_ROWS_LOAD(&right_rows[row])), solid));
+                CHUNK_FACE_ROWS_STORE(&face_rows[BLOCK_SIDE_ABOVE][row], CHUNK_FACE_ROWS_ANDNOT(
+                    CHUNK_FACE_ROWS_LOAD(&solid_rows[block_z + 1][block_y + 2]), solid));
+                CHUNK_FACE_ROWS_STORE(&face_rows[BLOCK_SIDE_BELOW][row], CHUNK_FACE_ROWS_ANDNOT(
+                    CHUNK_FACE_ROWS_LOAD(&solid_rows[block_z + 1][block_y]), solid));
+                CHUNK_FACE_ROWS_STORE(&face_rows[BLOCK_SIDE_FRONT][row], CHUNK_FACE_ROWS_ANDNOT(
+                    CHUNK_FACE_ROWS_LOAD(&solid_rows[block_z][block_y + 1]), solid));
+                CHUNK_FACE_ROWS_STORE(&face_rows[BLOCK_SIDE_BACK][row], CHUNK_FACE_ROWS_ANDNOT(
+                    CHUNK_FACE_ROWS_LOAD(&solid_rows[block_z + 2][block_y + 1]), solid));
+            }
+        #else
             for (int block_y = 0; block_y < CHUNK_SIZE; block_y++) {
-                for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
-                    int block_index = block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x;
+                int row = block_z * CHUNK_SIZE + block_y;
+                uint16_t solid = solid_rows[block_z + 1][block_y + 1];
+                face_rows[BLOCK_SIDE_LEFT][row] = solid & ~((solid << 1) | left_rows[row]);
+                face_rows[BLOCK_SIDE_RIGHT][row] = solid & ~((solid >> 1) | right_rows[row]);
+                face_rows[BLOCK_SIDE_ABOVE][row] = solid & ~solid_rows[block_z + 1][block_y + 2];
+                face_rows[BLOCK_SIDE_BELOW][row] = solid & ~solid_rows[block_z + 1][block_y];
+                face_rows[BLOCK_SIDE_FRONT][row] = solid & ~solid_rows[block_z][block_y + 1];
+                face_rows[BLOCK_SIDE_BACK][row] = solid & ~solid_rows[block_z + 2][block_y + 1];
+            }
+        #endif
+    }
+}
 
-                    // Check air block
-                    BlockType blockType = chunk->data[block_index];
-                    if (blockType == BLOCK_TYPE_AIR) {
-                        chunk->data[block_index] &= ~CHUNK_DATA_VISIBLE_BIT;
-                        continue;
-                    }
+// Set the face bitmasks of a row of 16 blocks in the x direction from the face bitset rows
+void chunk_set_faces_row(uint8_t* faces, int block_y, int block_z, uint16_t face_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE]) {
+    int row = block_z * CHUNK_SIZE + block_y;
+    uint8_t* block_faces = &faces[row * CHUNK_SIZE];
+    #ifndef NO_SIMD
+        // Spread the row bits over the bytes and compare with the bit selector
+        __m128i bit_selector = _mm_set1_epi64x(0x8040201008040201);
+        __m128i faces_vector = _mm_setzero_si128();
+        for (int i = 0; i < BLOCK_SIDE_SIZE; i++) {
+            __m128i face_bits = _mm_set_epi64x(
+                (uint64_t)(face_rows[i][row] >> 8) * 0x0101010101010101ULL,
+                (uint64_t)(face_rows[i][row] & 0xff) * 0x0101010101010101ULL
+            );
+            __m128i has_face = _mm_cmpeq_epi8(_mm_and_si128(face_bits, bit_selector), bit_selector);
+            faces_vector = _mm_or_si128(faces_vector, _mm_and_si128(has_face, _mm_set1_epi8(CHUNK_FACE_BIT(i))));
+        }
+        _mm_storeu_si128((__m128i*)block_faces, faces_vector);
+    #else
+        for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
+            block_faces[block_x] = 0;
+            for (int i = 0; i < BLOCK_SIDE_SIZE; i++) {
+                if ((face_rows[i][row] & (1 << block_x)) != 0) {
+                    block_faces[block_x] |= CHUNK_FACE_BIT(i);
+                }
+            }
+        }
+    #endif
+}
 
-                    // Check left block
-                    if (block_x == 0) {
-                        Chunk *otherChunk = world_get_chunk(world, chunk->x - 1, chunk->y, chunk->z);
-                        BlockType blockType = otherChunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + (CHUNK_SIZE - 1)];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    } else {
-                        BlockType blockType = chunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + (block_x - 1)];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    }
+// Build the CPU side vertices of a chunk mesh from the face bitset rows, this needs no OpenGL context
+void chunk_build_mesh(ChunkMesh* chunk_mesh, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data, uint16_t face_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE]) {
+    chunk_mesh_clear(chunk_mesh);
+    for (BlockSide block_side = 0; block_side < BLOCK_SIDE_SIZE; block_side++) {
+        for (int row = 0; row < CHUNK_SIZE * CHUNK_SIZE; row++) {
+            uint16_t face_row = face_rows[block_side][row];
+            while (face_row != 0) {
+                int block_x = __builtin_ctz(face_row);
+                face_row &= face_row - 1;
+
+                int block_y = row % CHUNK_SIZE;
+                int block_z = row / CHUNK_SIZE;
+                BlockType block_type = chunk_data[row * CHUNK_SIZE + block_x];
+                chunk_mesh_add_face(
+                    chunk_mesh,
+                    chunk_x * CHUNK_SIZE + block_x,
+                    chunk_y * CHUNK_SIZE + block_y,
+                    chunk_z * CHUNK_SIZE + block_z,
+                    block_side,
+                    block_type
+                );
+            }
+        }
+    }
+}
 
-                    // Check right block
-                    if (block_x == CHUNK_SIZE - 1) {
-                        Chunk *otherChunk = world_get_chunk(world, chunk->x + 1, chunk->y, chunk->z);
-                        BlockType blockType = otherChunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + 0];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    } else {
-                        BlockType blockType = chunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + (block_x + 1)];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    }
+void chunk_update(Chunk* chunk, World* world) {
+    if (chunk->is_changed || !chunk->is_lighted || !chunk->is_relighted) {
+        log_debug("Chunk update %d %d %d", chunk->x, chunk->y, chunk->z);
 
-                    // Check above block
-                    if (block_y == 0) {
-                        Chunk *otherChunk = world_get_chunk(world, chunk->x, chunk->y - 1, chunk->z);
-                        BlockType blockType = otherChunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + (CHUNK_SIZE - 1) * CHUNK_SIZE + block_x];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    } else {
-                        BlockType blockType = chunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + (block_y - 1) * CHUNK_SIZE + block_x];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    }
+        // Empty chunks have no faces whatever their neighbours are so they need no relight, the storage
+        // is only read when holding the chunk lock because the render thread can change it
+        mtx_lock(&chunk->chunk_lock);
+        if (chunk_is_empty(chunk)) {
+            chunk->is_changed = false;
+            chunk->is_relighted = true;
+            uint8_t* old_faces = chunk->faces;
+            __atomic_store_n(&chunk->faces, CHUNK_EMPTY_FACES, __ATOMIC_RELEASE);
+            chunk_mesh_clear(chunk->mesh);
+            __atomic_store_n(&chunk->is_lighted, true, __ATOMIC_RELEASE);
+            mtx_unlock(&chunk->chunk_lock);
+
+            // The render thread can be reading the old faces so they go to the garbage
+            if (old_faces != CHUNK_EMPTY_FACES) {
+                world_add_faces_garbage(world, old_faces);
+            }
+            return;
+        }
+        mtx_unlock(&chunk->chunk_lock);
 
-                    // Check below block
-                    if (block_y == CHUNK_SIZE - 1) {
-                        Chunk *otherChunk = world_get_chunk(world, chunk->x, chunk->y + 1, chunk->z);
-                        BlockType blockType = otherChunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + 0 * CHUNK_SIZE + block_x];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    } else {
-                        BlockType blockType = chunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + (block_y + 1) * CHUNK_SIZE + block_x];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    }
+        // Get the border rows of the neighbour chunks once, each under the lock of its own chunk
+        uint16_t border_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE];
+        for (int i = 0; i < BLOCK_SIDE_SIZE; i++) {
+            Chunk* neighbour_chunk = world_get_chunk(
+                world,
+                chunk->x + CHUNK_BLOCK_SIDE_OFFSETS[i][0],
+                chunk->y + CHUNK_BLOCK_SIDE_OFFSETS[i][1],
+                chunk->z + CHUNK_BLOCK_SIDE_OFFSETS[i][2]
+            );
+            chunk_get_border_rows(neighbour_chunk, i, border_rows[i]);
+            chunk_release(neighbour_chunk);
+        }
 
-                    // Check front block
-                    if (block_z == 0) {
-                        Chunk *otherChunk = world_get_chunk(world, chunk->x, chunk->y, chunk->z - 1);
-                        BlockType blockType = otherChunk->data[(CHUNK_SIZE - 1) * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    } else {
-                        BlockType blockType = chunk->data[(block_z - 1) * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    }
+        mtx_lock(&chunk->chunk_lock);
 
-                    // Check back block
-                    if (block_z == CHUNK_SIZE - 1) {
-                        Chunk *otherChunk = world_get_chunk(world, chunk->x, chunk->y, chunk->z + 1);
-                        BlockType blockType = otherChunk->data[0 * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    } else {
-                        BlockType blockType = chunk->data[(block_z + 1) * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x];
-                        if (blockType == BLOCK_TYPE_AIR) {
-                            chunk->data[block_index] |= CHUNK_DATA_VISIBLE_BIT;
-                            continue;
-                        }
-                    }
+        // An other worker could have updated the chunk while we where getting the neighbour chunks
+        if (!chunk->is_changed && chunk->is_lighted && chunk->is_relighted) {
+            mtx_unlock(&chunk->chunk_lock);
+            return;
+        }
 
-                    // Not visible
-                    chunk->data[block_index] &= ~CHUNK_DATA_VISIBLE_BIT;
-                }
+        chunk->is_changed = false;
+        chunk->is_relighted = true;
+
+        // Decode the palette storage once for the bitsets and the mesh
+        uint16_t chunk_data[CHUNK_DATA_SIZE];
+        chunk_storage_decode(chunk->storage, chunk_data);
+
+        // Get the faces that touch air via the solid block bitsets
+        uint16_t face_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE];
+        chunk_get_face_rows(chunk_data, border_rows, face_rows);
+
+        // Store the face bitmask of every block in new faces and swap them in, the render thread reads
+        // the faces without the lock so it sees the old or the new faces but never half written faces
+        uint8_t* faces = slab_allocate(chunk_faces_slab);
+        for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
+            for (int block_y = 0; block_y < CHUNK_SIZE; block_y++) {
+                chunk_set_faces_row(faces, block_y, block_z, face_rows);
             }
         }
+        uint8_t* old_faces = chunk->faces;
+        __atomic_store_n(&chunk->faces, faces, __ATOMIC_RELEASE);
+
+        // Publish the lighted state only after the faces are set
+        __atomic_store_n(&chunk->is_lighted, true, __ATOMIC_RELEASE);
+
+        // Rebuild the chunk mesh with only the faces that touch air
+        chunk_build_mesh(chunk->mesh, chunk->x, chunk->y, chunk->z, chunk_data, face_rows);
 
         mtx_unlock(&chunk->chunk_lock);
+
+        if (old_faces != CHUNK_EMPTY_FACES) {
+            world_add_faces_garbage(world, old_faces);
+        }
     }
 }
 
@@ -303,11 +617,11 @@ bool chunk_is_visible(Chunk* chunk, Camera* camera) {
     }
 
     // Check for each block in the chunk if it is visible
+    uint8_t* faces = chunk_get_faces(chunk);
     for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
         for (int block_y = 0; block_y < CHUNK_SIZE; block_y++) {
             for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
-                BlockType block_type = chunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x];
-                if ((block_type & CHUNK_DATA_VISIBLE_BIT) != 0) {
+                if (faces[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x] != 0) {
 
                     float block_min_x = chunk->x * CHUNK_SIZE + block_x - 0.5;
                     float block_max_x = chunk->x * CHUNK_SIZE + block_x + 0.5;
@@ -346,100 +660,99 @@ bool chunk_is_visible(Chunk* chunk, Camera* camera) {
     return false;
 }
 
-// Compress chunk data with a simple run length encoding
-uint8_t* chunk_data_compress(uint8_t* chunk_data) {
-    uint8_t* compressed_data = malloc(CHUNK_DATA_SIZE + 2);
-
-    bool is_only_air = true;
+// Check if the bounding box of a chunk position touches the camera frustum, this needs no chunk data
+bool chunk_is_in_frustum(int chunk_x, int chunk_y, int chunk_z, Camera* camera) {
+    float chunk_min_x = chunk_x * CHUNK_SIZE - 0.5;
+    float chunk_max_x = chunk_x * CHUNK_SIZE + CHUNK_SIZE + 0.5;
+    float chunk_min_y = chunk_y * CHUNK_SIZE - 0.5;
+    float chunk_max_y = chunk_y * CHUNK_SIZE + CHUNK_SIZE + 0.5;
+    float chunk_min_z = chunk_z * CHUNK_SIZE - 0.5;
+    float chunk_max_z = chunk_z * CHUNK_SIZE + CHUNK_SIZE + 0.5;
 
-    int compressed_size = 2;
-    int position = 0;
-    while (position < CHUNK_DATA_SIZE) {
-        BlockType block_type = chunk_data[position++];
-        block_type &= ~CHUNK_DATA_VISIBLE_BIT;
-
-        if (block_type != BLOCK_TYPE_AIR) {
-            is_only_air = false;
-        }
-
-        int repeat_count = 0;
-        for (;;) {
-            BlockType next_block_type = chunk_data[position];
-            next_block_type &= ~CHUNK_DATA_VISIBLE_BIT;
-
-            if (
-                position < CHUNK_DATA_SIZE &&
-                block_type == next_block_type &&
-                repeat_count < UINT8_MAX
-            ) {
-                repeat_count++;
-                position++;
-            }
-            else {
-                if (repeat_count == 0) {
-                    compressed_data[compressed_size++] = block_type;
-                } else {
-                    compressed_data[compressed_size++] = block_type | CHUNK_COMPRESSED_DATA_REPEAT_BIT;
-                    compressed_data[compressed_size++] = repeat_count;
-                }
-                break;
-            }
-        }
-    }
+    Vector4 chunk_corners[BLOCK_CORNERS_COUNT] = {
+        { chunk_min_x, chunk_min_y, -chunk_min_z, 1 },
+        { chunk_max_x, chunk_min_y, -chunk_min_z, 1 },
+        { chunk_min_x, chunk_max_y, -chunk_min_z, 1 },
+        { chunk_max_x, chunk_max_y, -chunk_min_z, 1 },
+        { chunk_min_x, chunk_min_y, -chunk_max_z, 1 },
+        { chunk_max_x, chunk_min_y, -chunk_max_z, 1 },
+        { chunk_min_x, chunk_max_y, -chunk_max_z, 1 },
+        { chunk_max_x, chunk_max_y, -chunk_max_z, 1 }
+    };
 
-    if (is_only_air) {
-        compressed_size = 2;
+    // The chunk is outside the frustum when all corners are outside the same frustum plane
+    int outside_left = 0, outside_right = 0, outside_bottom = 0, outside_top = 0, outside_near = 0, outside_far = 0;
+    for (int i = 0; i < BLOCK_CORNERS_COUNT; i++) {
+        vector4_mul(&chunk_corners[i], &camera->view_matrix);
+        vector4_mul(&chunk_corners[i], &camera->projection_matrix);
+        if (chunk_corners[i].x < -chunk_corners[i].w) outside_left++;
+        if (chunk_corners[i].x > chunk_corners[i].w) outside_right++;
+        if (chunk_corners[i].y < -chunk_corners[i].w) outside_bottom++;
+        if (chunk_corners[i].y > chunk_corners[i].w) outside_top++;
+        if (chunk_corners[i].z < 0) outside_near++;
+        if (chunk_corners[i].z > chunk_corners[i].w) outside_far++;
     }
+    return outside_left != BLOCK_CORNERS_COUNT && outside_right != BLOCK_CORNERS_COUNT &&
+        outside_bottom != BLOCK_CORNERS_COUNT && outside_top != BLOCK_CORNERS_COUNT &&
+        outside_near != BLOCK_CORNERS_COUNT && outside_far != BLOCK_CORNERS_COUNT;
+}
 
-    compressed_data[0] = compressed_size & 0xff;
-    compressed_data[1] = (compressed_size >> 8) & 0xff;
-
-    compressed_data = realloc(compressed_data, compressed_size);
+// Take a reference so the chunk is not freed when it is evicted from the chunk cache
+void chunk_retain(Chunk* chunk) {
+    __atomic_add_fetch(&chunk->references, 1, __ATOMIC_RELAXED);
+}
 
-    // log_debug("Compressor: compressed chunk is %d bytes large", compressed_size);
+void chunk_release(Chunk* chunk) {
+    __atomic_sub_fetch(&chunk->references, 1, __ATOMIC_RELEASE);
+}
 
-    return compressed_data;
+// Uniform chunks store only one palette entry and no indices
+bool chunk_is_uniform(Chunk* chunk) {
+    return chunk_storage_is_uniform(chunk->storage);
 }
 
-// Decompress chunk data for a simple run length encoding
-uint8_t* chunk_data_decompress(uint8_t* compressed_data) {
-    int compressed_size = (compressed_data[1] << 8) | compressed_data[0];
+// The faces of a lighted chunk are set, the render thread reads them without holding the chunk lock
+bool chunk_is_lighted(Chunk* chunk) {
+    return __atomic_load_n(&chunk->is_lighted, __ATOMIC_ACQUIRE);
+}
 
-    // log_debug("Decompressor: compressed chunk is %d bytes large", compressed_size);
+// Get the faces without holding the chunk lock, they are never changed after they are swapped in and
+// replaced faces are only freed in the chunk garbage free of the render thread
+uint8_t* chunk_get_faces(Chunk* chunk) {
+    return __atomic_load_n(&chunk->faces, __ATOMIC_ACQUIRE);
+}
 
-    uint8_t* chunk_data = malloc(CHUNK_DATA_SIZE);
+// Only call this when holding the chunk lock or when no other thread uses the chunk
+bool chunk_is_empty(Chunk* chunk) {
+    return chunk_storage_is_uniform(chunk->storage) && chunk->storage->palette[0] == BLOCK_TYPE_AIR;
+}
 
-    if (compressed_size == 2) {
-        memset(chunk_data, BLOCK_TYPE_AIR, CHUNK_DATA_SIZE);
-    }
-    else {
-        int compressed_position = 2;
-        int position = 0;
-        while (compressed_position < compressed_size) {
-            if ((compressed_data[compressed_position] & CHUNK_COMPRESSED_DATA_REPEAT_BIT) != 0) {
-                BlockType block_type = compressed_data[compressed_position];
-                block_type &= ~CHUNK_COMPRESSED_DATA_REPEAT_BIT;
-                for (int i = 0; i <= compressed_data[compressed_position + 1]; i++) {
-                    chunk_data[position++] = block_type;
-                }
-                compressed_position += 2;
-            }
-            else {
-                chunk_data[position++] = compressed_data[compressed_position++];
-            }
-        }
+// Get the CPU and GPU memory that the chunk uses in bytes, the storage, faces and mesh change when holding
+// the chunk lock so this takes the chunk lock, don't hold it when calling this
+size_t chunk_get_memory_size(Chunk* chunk) {
+    mtx_lock(&chunk->chunk_lock);
+    size_t memory_size = sizeof(Chunk) + sizeof(ChunkMesh) + chunk_storage_get_memory_size(chunk->storage);
+    if (chunk->faces != CHUNK_EMPTY_FACES) {
+        memory_size += CHUNK_DATA_SIZE;
     }
-
-    return chunk_data;
+    memory_size += (size_t)(chunk->mesh->vertices_capacity + chunk->mesh->uploaded_vertices_count) * CHUNK_MESH_VERTEX_SIZE * sizeof(float);
+    mtx_unlock(&chunk->chunk_lock);
+    return memory_size;
 }
 
+// Free the chunk, only call this on the OpenGL thread because of the chunk mesh
 void chunk_free(Chunk* chunk) {
     mtx_lock(&chunk->chunk_lock);
 
-    free(chunk->data);
+    chunk_storage_free(chunk->storage);
+    if (chunk->faces != CHUNK_EMPTY_FACES) {
+        slab_deallocate(chunk_faces_slab, chunk->faces);
+    }
 
-    free(chunk);
+    chunk_mesh_free(chunk->mesh);
 
-    mtx_unlock(&chunk->chunk_lock); // Use after free?
+    mtx_unlock(&chunk->chunk_lock);
     mtx_destroy(&chunk->chunk_lock);
+
+    slab_deallocate(chunk_slab, chunk);
 }
@@ -0,0 +1,277 @@
+// PlaatCraft - Chunk Codec
+
+#include "chunk_codec.h"
+#include "geometry/block.h"
+#ifndef NO_SIMD
+    #include <emmintrin.h>
+#endif
+
+uint16_t chunk_codec_read_uint16(uint8_t* data) {
+    return data[0] | (data[1] << 8);
+}
+
+void chunk_codec_write_uint16(uint8_t* data, uint16_t value) {
+    data[0] = value & 0xff;
+    data[1] = value >> 8;
+}
+
+// The smallest power of two bits per block that can index the whole palette
+int chunk_codec_get_bits(int palette_size) {
+    int bits = 1;
+    while ((1 << bits) < palette_size) {
+        bits *= 2;
+    }
+    return bits;
+}
+
+// A run is the index shifted left by one with the low bit set when a run length follows,
+// as one byte when the palette is small enough and else as two bytes
+int chunk_codec_get_run_index_size(int palette_size) {
+    return palette_size <= 128 ? 1 : 2;
+}
+
+// The run length minus two follows runs longer then one block, as one byte below 128 and else
+// as two bytes with the high bit of the first byte set
+int chunk_codec_get_run_length_size(int run_length) {
+    if (run_length == 1) {
+        return 0;
+    }
+    return run_length - 2 < 128 ? 1 : 2;
+}
+
+// Encode the blocks as version 2 in a buffer of at least CHUNK_CODEC_MAX_SIZE bytes and return the size,
+// the indices are stored packed or as runs whatever is smaller
+int chunk_codec_encode(uint16_t* blocks, uint8_t* buffer) {
+    // Build the palette and the palette indices, most blocks are the same as the block before them
+    uint16_t palette[CHUNK_CODEC_BLOCKS_COUNT];
+    uint16_t indices[CHUNK_CODEC_BLOCKS_COUNT];
+    int palette_size = 0;
+    int runs_count = 0;
+    int run_lengths_size = 0;
+    int run_start = 0;
+    for (int i = 0; i < CHUNK_CODEC_BLOCKS_COUNT; i++) {
+        if (i > 0 && blocks[i] == blocks[i - 1]) {
+            indices[i] = indices[i - 1];
+            continue;
+        }
+
+        int index = 0;
+        while (index < palette_size && palette[index] != blocks[i]) {
+            index++;
+        }
+        if (index == palette_size) {
+            palette[palette_size++] = blocks[i];
+        }
+        indices[i] = index;
+
+        if (i > 0) {
+            runs_count++;
+            run_lengths_size += chunk_codec_get_run_length_size(i - run_start);
+            run_start = i;
+        }
+    }
+    runs_count++;
+    run_lengths_size += chunk_codec_get_run_length_size(CHUNK_CODEC_BLOCKS_COUNT - run_start);
+
+    int bits = chunk_codec_get_bits(palette_size);
+    int index_size = chunk_codec_get_run_index_size(palette_size);
+    int packed_size = CHUNK_CODEC_BLOCKS_COUNT * bits / 8;
+    int runs_size = runs_count * index_size + run_lengths_size;
+    ChunkCodecMode mode = palette_size == 1 ? CHUNK_CODEC_MODE_UNIFORM :
+        (runs_size < packed_size ? CHUNK_CODEC_MODE_RUNS : CHUNK_CODEC_MODE_PACKED);
+
+    // Write the header and the palette
+    int size = CHUNK_CODEC_HEADER_SIZE;
+    buffer[2] = CHUNK_CODEC_VERSION;
+    buffer[3] = mode;
+    chunk_codec_write_uint16(&buffer[4], palette_size);
+    for (int i = 0; i < palette_size; i++) {
+        chunk_codec_write_uint16(&buffer[size], palette[i]);
+        size += 2;
+    }
+
+    if (mode == CHUNK_CODEC_MODE_PACKED) {
+        // Pack the indices in 64 bits words, the bits are a power of two so no index crosses a word
+        int blocks_per_word = 64 / bits;
+        for (int i = 0; i < CHUNK_CODEC_BLOCKS_COUNT; i += blocks_per_word) {
+            uint64_t word = 0;
+            for (int j = 0; j < blocks_per_word; j++) {
+                word |= (uint64_t)indices[i + j] << (j * bits);
+            }
+            for (int j = 0; j < 8; j++) {
+                buffer[size++] = word >> (j * 8);
+            }
+        }
+    }
+
+    if (mode == CHUNK_CODEC_MODE_RUNS) {
+        int i = 0;
+        while (i < CHUNK_CODEC_BLOCKS_COUNT) {
+            int run_length = 1;
+            while (i + run_length < CHUNK_CODEC_BLOCKS_COUNT && indices[i + run_length] == indices[i]) {
+                run_length++;
+            }
+
+            int run_index = (indices[i] << 1) | (run_length > 1);
+            buffer[size++] = run_index & 0xff;
+            if (index_size == 2) {
+                buffer[size++] = run_index >> 8;
+            }
+            if (run_length > 1) {
+                if (run_length - 2 < 128) {
+                    buffer[size++] = run_length - 2;
+                } else {
+                    buffer[size++] = 0x80 | ((run_length - 2) >> 8);
+                    buffer[size++] = (run_length - 2) & 0xff;
+                }
+            }
+            i += run_length;
+        }
+    }
+
+    chunk_codec_write_uint16(&buffer[0], size | CHUNK_CODEC_VERSION_BIT);
+    return size;
+}
+
+// Fill a run of blocks with one block type, eight blocks at a time
+void chunk_codec_fill(uint16_t* blocks, uint16_t block_type, int count) {
+    int i = 0;
+    #ifndef NO_SIMD
+        __m128i block_types = _mm_set1_epi16(block_type);
+        for (; i + 8 <= count; i += 8) {
+            _mm_storeu_si128((__m128i*)&blocks[i], block_types);
+        }
+    #endif
+    for (; i < count; i++) {
+        blocks[i] = block_type;
+    }
+}
+
+// Decode the legacy run length encoding, the high bit of a block type marks a repeat and a
+// chunk of only the size header is only air
+bool chunk_codec_decode_legacy(uint8_t* data, int size, uint16_t* blocks) {
+    if (size == 2) {
+        chunk_codec_fill(blocks, 0, CHUNK_CODEC_BLOCKS_COUNT);
+        return true;
+    }
+
+    int position = 2;
+    int blocks_count = 0;
+    while (position < size) {
+        uint8_t block_type = data[position++];
+        int count = 1;
+        if ((block_type & CHUNK_CODEC_LEGACY_REPEAT_BIT) != 0) {
+            if (position == size) {
+                return false;
+            }
+            block_type &= ~CHUNK_CODEC_LEGACY_REPEAT_BIT;
+            count += data[position++];
+        }
+        if (block_type >= BLOCK_TYPE_SIZE || blocks_count + count > CHUNK_CODEC_BLOCKS_COUNT) {
+            return false;
+        }
+        chunk_codec_fill(&blocks[blocks_count], block_type, count);
+        blocks_count += count;
+    }
+    return blocks_count == CHUNK_CODEC_BLOCKS_COUNT;
+}
+
+// Decode an encoded chunk of a given size into the blocks, every read is bounds checked and every block type
+// must be known so a corrupt chunk or a chunk of a newer version returns false and is generated again
+bool chunk_codec_decode(uint8_t* data, int size, uint16_t* blocks) {
+    if (size < 2) {
+        return false;
+    }
+    int encoded_size = chunk_codec_read_uint16(data);
+    if ((encoded_size & CHUNK_CODEC_VERSION_BIT) == 0) {
+        return encoded_size >= 2 && encoded_size <= size && chunk_codec_decode_legacy(data, encoded_size, blocks);
+    }
+    encoded_size &= ~CHUNK_CODEC_VERSION_BIT;
+    if (encoded_size < CHUNK_CODEC_HEADER_SIZE || encoded_size > size || data[2] != CHUNK_CODEC_VERSION) {
+        return false;
+    }
+
+    ChunkCodecMode mode = data[3];
+    int palette_size = chunk_codec_read_uint16(&data[4]);
+    if (palette_size < 1 || palette_size > CHUNK_CODEC_BLOCKS_COUNT || CHUNK_CODEC_HEADER_SIZE + palette_size * 2 > encoded_size) {
+        return false;
+    }
+    uint16_t palette[CHUNK_CODEC_BLOCKS_COUNT];
+    for (int i = 0; i < palette_size; i++) {
+        palette[i] = chunk_codec_read_uint16(&data[CHUNK_CODEC_HEADER_SIZE + i * 2]);
+        if (palette[i] >= BLOCK_TYPE_SIZE) {
+            return false;
+        }
+    }
+    int position = CHUNK_CODEC_HEADER_SIZE + palette_size * 2;
+
+    if (mode == CHUNK_CODEC_MODE_UNIFORM) {
+        if (palette_size != 1 || position != encoded_size) {
+            return false;
+        }
+        chunk_codec_fill(blocks, palette[0], CHUNK_CODEC_BLOCKS_COUNT);
+        return true;
+    }
+
+    if (mode == CHUNK_CODEC_MODE_PACKED) {
+        int bits = chunk_codec_get_bits(palette_size);
+        if (position + CHUNK_CODEC_BLOCKS_COUNT * bits / 8 != encoded_size) {
+            return false;
+        }
+
+        int blocks_per_word = 64 / bits;
+        uint64_t mask = ((uint64_t)1 << bits) - 1;
+        for (int i = 0; i < CHUNK_CODEC_BLOCKS_COUNT; i += blocks_per_word) {
+            uint64_t word = 0;
+            for (int j = 0; j < 8; j++) {
+                word |= (uint64_t)data[position++] << (j * 8);
+            }
+            for (int j = 0; j < blocks_per_word; j++) {
+                int index = word & mask;
+                if (index >= palette_size) {
+                    return false;
+                }
+                blocks[i + j] = palette[index];
+                word >>= bits;
+            }
+        }
+        return true;
+    }
+
+    if (mode == CHUNK_CODEC_MODE_RUNS) {
+        int index_size = chunk_codec_get_run_index_size(palette_size);
+        int blocks_count = 0;
+        while (position < encoded_size) {
+            if (position + index_size > encoded_size) {
+                return false;
+            }
+            int run_index = index_size == 1 ? data[position] : chunk_codec_read_uint16(&data[position]);
+            position += index_size;
+
+            int run_length = 1;
+            if ((run_index & 1) != 0) {
+                if (position == encoded_size) {
+                    return false;
+                }
+                run_length = data[position++];
+                if ((run_length & 0x80) != 0) {
+                    if (position == encoded_size) {
+                        return false;
+                    }
+                    run_length = ((run_length & 0x7f) << 8) | data[position++];
+                }
+                run_length += 2;
+            }
+
+            int index = run_index >> 1;
+            if (index >= palette_size || blocks_count + run_length > CHUNK_CODEC_BLOCKS_COUNT) {
+                return false;
+            }
+            chunk_codec_fill(&blocks[blocks_count], palette[index], run_length);
+            blocks_count += run_length;
+        }
+        return blocks_count == CHUNK_CODEC_BLOCKS_COUNT;
+    }
+
+    return false;
+}
@@ -0,0 +1,123 @@
+// PlaatCraft - Chunk Index
+
+#include "chunk_index.h"
+#include <stdlib.h>
+#include "chunk.h"
+#include "log.h"
+
+// Create a chunk index, the capacity must be a power of two and at least twice the chunk count
+ChunkIndex* chunk_index_new(int capacity) {
+    if ((capacity & (capacity - 1)) != 0) {
+        log_error("Chunk index capacity %d is not a power of two", capacity);
+    }
+
+    ChunkIndex* chunk_index = malloc(sizeof(ChunkIndex));
+    chunk_index->entries = calloc(capacity, sizeof(ChunkIndexEntry));
+    chunk_index->capacity = capacity;
+    chunk_index->sequence = 0;
+    return chunk_index;
+}
+
+uint32_t chunk_index_hash(int chunk_x, int chunk_y, int chunk_z) {
+    uint32_t hash = (uint32_t)chunk_x * 0x8da6b343 ^ (uint32_t)chunk_y * 0xd8163841 ^ (uint32_t)chunk_z * 0xcb1ab31f;
+    return hash ^ (hash >> 16);
+}
+
+// Readers retry when a writer changed the index while they where probing (a sequence lock)
+Chunk* chunk_index_get(ChunkIndex* chunk_index, int chunk_x, int chunk_y, int chunk_z) {
+    int mask = chunk_index->capacity - 1;
+    for (;;) {
+        unsigned int sequence = __atomic_load_n(&chunk_index->sequence, __ATOMIC_ACQUIRE);
+        if ((sequence & 1) != 0) {
+            continue;
+        }
+
+        Chunk* chunk = NULL;
+        int index = chunk_index_hash(chunk_x, chunk_y, chunk_z) & mask;
+        for (int i = 0; i < chunk_index->capacity; i++) {
+            ChunkIndexEntry* entry = &chunk_index->entries[index];
+            if (entry->chunk == NULL) {
+                break;
+            }
+            if (entry->x == chunk_x && entry->y == chunk_y && entry->z == chunk_z) {
+                chunk = entry->chunk;
+                break;
+            }
+            index = (index + 1) & mask;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&chunk_index->sequence, __ATOMIC_RELAXED) == sequence) {
+            return chunk;
+        }
+    }
+}
+
+void chunk_index_begin_write(ChunkIndex* chunk_index) {
+    __atomic_store_n(&chunk_index->sequence, chunk_index->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void chunk_index_end_write(ChunkIndex* chunk_index) {
+    __atomic_store_n(&chunk_index->sequence, chunk_index->sequence + 1, __ATOMIC_RELEASE);
+}
+
+// Insert or replace a chunk, only call this when holding the writers lock
+void chunk_index_set(ChunkIndex* chunk_index, int chunk_x, int chunk_y, int chunk_z, Chunk* chunk) {
+    int mask = chunk_index->capacity - 1;
+    int index = chunk_index_hash(chunk_x, chunk_y, chunk_z) & mask;
+    for (;;) {
+        ChunkIndexEntry* entry = &chunk_index->entries[index];
+        if (entry->chunk == NULL || (entry->x == chunk_x && entry->y == chunk_y && entry->z == chunk_z)) {
+            chunk_index_begin_write(chunk_index);
+            entry->x = chunk_x;
+            entry->y = chunk_y;
+            entry->z = chunk_z;
+            entry->chunk = chunk;
+            chunk_index_end_write(chunk_index);
+            return;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+// Remove a chunk and shift the following entries back so no tombstones are needed,
+// only call this when holding the writers lock
+void chunk_index_remove(ChunkIndex* chunk_index, int chunk_x, int chunk_y, int chunk_z) {
+    int mask = chunk_index->capacity - 1;
+    int index = chunk_index_hash(chunk_x, chunk_y, chunk_z) & mask;
+    for (;;) {
+        ChunkIndexEntry* entry = &chunk_index->entries[index];
+        if (entry->chunk == NULL) {
+            return;
+        }
+        if (entry->x == chunk_x && entry->y == chunk_y && entry->z == chunk_z) {
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+
+    chunk_index_begin_write(chunk_index);
+    int empty_index = index;
+    for (;;) {
+        index = (index + 1) & mask;
+        ChunkIndexEntry* entry = &chunk_index->entries[index];
+        if (entry->chunk == NULL) {
+            break;
+        }
+
+        // Move the entry to the empty slot when that slot is between its home slot and its current slot
+        int home_index = chunk_index_hash(entry->x, entry->y, entry->z) & mask;
+        if (((index - home_index) & mask) >= ((index - empty_index) & mask)) {
+            chunk_index->entries[empty_index] = *entry;
+            empty_index = index;
+        }
+    }
+    chunk_index->entries[empty_index].chunk = NULL;
+    chunk_index_end_write(chunk_index);
+}
+
+void chunk_index_free(ChunkIndex* chunk_index) {
+    free(chunk_index->entries);
+    free(chunk_index);
+}
@@ -0,0 +1,159 @@
+// PlaatCraft - Chunk Storage
+
+#include "chunk_storage.h"
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+
+// The storages and there index words come from slabs, one for every number of bits per block
+Slab* chunk_storage_slab;
+
+Slab* chunk_storage_indices_slabs[CHUNK_STORAGE_BITS_COUNT];
+
+void chunk_storage_init_slabs(void) {
+    chunk_storage_slab = slab_new(sizeof(ChunkStorage));
+    for (int i = 0; i < CHUNK_STORAGE_BITS_COUNT; i++) {
+        chunk_storage_indices_slabs[i] = slab_new(CHUNK_STORAGE_SIZE * (1 << i) / 8);
+    }
+}
+
+// The index of the indices slab of a number of bits per block
+int chunk_storage_get_indices_slab_index(int bits) {
+    return __builtin_ctz(bits);
+}
+
+// Create a storage where every block has the same type, it needs no indices
+ChunkStorage* chunk_storage_new(BlockType block_type) {
+    ChunkStorage* chunk_storage = slab_allocate(chunk_storage_slab);
+    chunk_storage->palette = malloc(sizeof(uint16_t));
+    chunk_storage->palette[0] = block_type;
+    chunk_storage->palette_size = 1;
+    chunk_storage->bits = 0;
+    chunk_storage->indices = NULL;
+    return chunk_storage;
+}
+
+// Create a storage from a flat block array with the smallest palette that fits
+ChunkStorage* chunk_storage_new_from_blocks(uint16_t* blocks) {
+    ChunkStorage* chunk_storage = chunk_storage_new(blocks[0]);
+    for (int i = 1; i < CHUNK_STORAGE_SIZE; i++) {
+        if (blocks[i] != blocks[i - 1]) {
+            chunk_storage_set(chunk_storage, i, blocks[i]);
+        } else if (chunk_storage->bits != 0) {
+            // The same block type as the previous block so copy its index
+            int bit_index = i * chunk_storage->bits;
+            int previous_bit_index = bit_index - chunk_storage->bits;
+            uint64_t mask = ((uint64_t)1 << chunk_storage->bits) - 1;
+            uint64_t palette_index = (chunk_storage->indices[previous_bit_index >> 6] >> (previous_bit_index & 63)) & mask;
+            chunk_storage->indices[bit_index >> 6] |= palette_index << (bit_index & 63);
+        }
+    }
+    return chunk_storage;
+}
+
+int chunk_storage_get_palette_capacity(ChunkStorage* chunk_storage) {
+    return 1 << chunk_storage->bits;
+}
+
+BlockType chunk_storage_get(ChunkStorage* chunk_storage, int index) {
+    if (chunk_storage->bits == 0) {
+        return chunk_storage->palette[0];
+    }
+    int bit_index = index * chunk_storage->bits;
+    uint64_t mask = ((uint64_t)1 << chunk_storage->bits) - 1;
+    return chunk_storage->palette[(chunk_storage->indices[bit_index >> 6] >> (bit_index & 63)) & mask];
+}
+
+// Repack the indices with more bits per block, the bits stay a power of two so no index crosses a word
+void chunk_storage_grow(ChunkStorage* chunk_storage, int bits) {
+    if (bits > CHUNK_STORAGE_MAX_BITS) {
+        log_error("Chunk storage can't grow to %d bits per block", bits);
+    }
+
+    uint64_t* indices = slab_allocate(chunk_storage_indices_slabs[chunk_storage_get_indices_slab_index(bits)]);
+    memset(indices, 0, CHUNK_STORAGE_SIZE * bits / 8);
+    if (chunk_storage->bits != 0) {
+        uint64_t mask = ((uint64_t)1 << chunk_storage->bits) - 1;
+        for (int i = 0; i < CHUNK_STORAGE_SIZE; i++) {
+            int old_bit_index = i * chunk_storage->bits;
+            uint64_t palette_index = (chunk_storage->indices[old_bit_index >> 6] >> (old_bit_index & 63)) & mask;
+            int bit_index = i * bits;
+            indices[bit_index >> 6] |= palette_index << (bit_index & 63);
+        }
+    }
+
+    if (chunk_storage->indices != NULL) {
+        slab_deallocate(chunk_storage_indices_slabs[chunk_storage_get_indices_slab_index(chunk_storage->bits)], chunk_storage->indices);
+    }
+    chunk_storage->indices = indices;
+    chunk_storage->bits = bits;
+}
+
+// Get the palette index of a block type, add it to the palette when it is not in it
+int chunk_storage_get_palette_index(ChunkStorage* chunk_storage, BlockType block_type) {
+    for (int i = 0; i < chunk_storage->palette_size; i++) {
+        if (chunk_storage->palette[i] == block_type) {
+            return i;
+        }
+    }
+
+    if (chunk_storage->palette_size == chunk_storage_get_palette_capacity(chunk_storage)) {
+        chunk_storage_grow(chunk_storage, chunk_storage->bits == 0 ? 1 : chunk_storage->bits * 2);
+    }
+    chunk_storage->palette = realloc(chunk_storage->palette, (chunk_storage->palette_size + 1) * sizeof(uint16_t));
+    chunk_storage->palette[chunk_storage->palette_size] = block_type;
+    return chunk_storage->palette_size++;
+}
+
+// Set a block, only call this when no other thread reads the storage because the indices can be reallocated
+void chunk_storage_set(ChunkStorage* chunk_storage, int index, BlockType block_type) {
+    if (chunk_storage->bits == 0 && chunk_storage->palette[0] == block_type) {
+        return;
+    }
+
+    uint64_t palette_index = chunk_storage_get_palette_index(chunk_storage, block_type);
+    int bit_index = index * chunk_storage->bits;
+    uint64_t mask = ((uint64_t)1 << chunk_storage->bits) - 1;
+    uint64_t* word = &chunk_storage->indices[bit_index >> 6];
+    *word = (*word & ~(mask << (bit_index & 63))) | (palette_index << (bit_index & 63));
+}
+
+// Decode all blocks to a flat block array, one index word at a time
+void chunk_storage_decode(ChunkStorage* chunk_storage, uint16_t* blocks) {
+    if (chunk_storage->bits == 0) {
+        for (int i = 0; i < CHUNK_STORAGE_SIZE; i++) {
+            blocks[i] = chunk_storage->palette[0];
+        }
+        return;
+    }
+
+    int bits = chunk_storage->bits;
+    int words_count = CHUNK_STORAGE_SIZE * bits / 64;
+    int blocks_per_word = 64 / bits;
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    uint16_t* palette = chunk_storage->palette;
+    for (int i = 0; i < words_count; i++) {
+        uint64_t word = chunk_storage->indices[i];
+        for (int j = 0; j < blocks_per_word; j++) {
+            *blocks++ = palette[word & mask];
+            word >>= bits;
+        }
+    }
+}
+
+bool chunk_storage_is_uniform(ChunkStorage* chunk_storage) {
+    return chunk_storage->bits == 0;
+}
+
+size_t chunk_storage_get_memory_size(ChunkStorage* chunk_storage) {
+    return sizeof(ChunkStorage) + chunk_storage->palette_size * sizeof(uint16_t) +
+        (size_t)CHUNK_STORAGE_SIZE * chunk_storage->bits / 8;
+}
+
+void chunk_storage_free(ChunkStorage* chunk_storage) {
+    free(chunk_storage->palette);
+    if (chunk_storage->indices != NULL) {
+        slab_deallocate(chunk_storage_indices_slabs[chunk_storage_get_indices_slab_index(chunk_storage->bits)], chunk_storage->indices);
+    }
+    slab_deallocate(chunk_storage_slab, chunk_storage);
+}
@@ -0,0 +1,77 @@
+// PlaatCraft - Column Cache
+
+#include "column_cache.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+
+// Create a column cache, the capacity must be a power of two
+ColumnCache* column_cache_new(int capacity) {
+    if ((capacity & (capacity - 1)) != 0) {
+        log_error("Column cache capacity %d is not a power of two", capacity);
+    }
+
+    ColumnCache* column_cache = malloc(sizeof(ColumnCache));
+    column_cache->entries = malloc(capacity * sizeof(ColumnCacheEntry));
+    for (int i = 0; i < capacity; i++) {
+        column_cache->entries[i].is_used = false;
+    }
+    column_cache->capacity = capacity;
+    for (int i = 0; i < COLUMN_CACHE_LOCKS_COUNT; i++) {
+        mtx_init(&column_cache->locks[i], mtx_plain);
+    }
+    column_cache->hits_count = 0;
+    column_cache->misses_count = 0;
+    return column_cache;
+}
+
+int column_cache_hash(ColumnCache* column_cache, int chunk_x, int chunk_z) {
+    uint32_t hash = (uint32_t)chunk_x * 0x8da6b343 ^ (uint32_t)chunk_z * 0xcb1ab31f;
+    return (hash ^ (hash >> 16)) & (column_cache->capacity - 1);
+}
+
+// Copy the maps of a chunk column, returns false when the column is not in the cache
+bool column_cache_get(ColumnCache* column_cache, int chunk_x, int chunk_z, int heights[CHUNK_SIZE][CHUNK_SIZE], int drynesses[CHUNK_SIZE][CHUNK_SIZE]) {
+    int index = column_cache_hash(column_cache, chunk_x, chunk_z);
+    ColumnCacheEntry* entry = &column_cache->entries[index];
+    mtx_t* lock = &column_cache->locks[index % COLUMN_CACHE_LOCKS_COUNT];
+
+    mtx_lock(lock);
+    bool is_hit = entry->is_used && entry->chunk_x == chunk_x && entry->chunk_z == chunk_z;
+    if (is_hit) {
+        memcpy(heights, entry->heights, sizeof(entry->heights));
+        memcpy(drynesses, entry->drynesses, sizeof(entry->drynesses));
+    }
+    mtx_unlock(lock);
+
+    __atomic_add_fetch(is_hit ? &column_cache->hits_count : &column_cache->misses_count, 1, __ATOMIC_RELAXED);
+    return is_hit;
+}
+
+// Store the maps of a chunk column, this replaces the column that was in the same entry
+void column_cache_set(ColumnCache* column_cache, int chunk_x, int chunk_z, int heights[CHUNK_SIZE][CHUNK_SIZE], int drynesses[CHUNK_SIZE][CHUNK_SIZE]) {
+    int index = column_cache_hash(column_cache, chunk_x, chunk_z);
+    ColumnCacheEntry* entry = &column_cache->entries[index];
+    mtx_t* lock = &column_cache->locks[index % COLUMN_CACHE_LOCKS_COUNT];
+
+    mtx_lock(lock);
+    entry->chunk_x = chunk_x;
+    entry->chunk_z = chunk_z;
+    entry->is_used = true;
+    memcpy(entry->heights, heights, sizeof(entry->heights));
+    memcpy(entry->drynesses, drynesses, sizeof(entry->drynesses));
+    mtx_unlock(lock);
+}
+
+size_t column_cache_get_memory_size(ColumnCache* column_cache) {
+    return sizeof(ColumnCache) + column_cache->capacity * sizeof(ColumnCacheEntry);
+}
+
+void column_cache_free(ColumnCache* column_cache) {
+    for (int i = 0; i < COLUMN_CACHE_LOCKS_COUNT; i++) {
+        mtx_destroy(&column_cache->locks[i]);
+    }
+    free(column_cache->entries);
+    free(column_cache);
+}
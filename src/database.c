@@ -4,96 +4,56 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "chunk_codec.h"
 #include "config.h"
-#include "utils.h"
+#include "database_memory.h"
+#include "database_region.h"
+#include "database_sqlite.h"
 #include "log.h"
-
-Database* database_new(void) {
-    Database* database = malloc(sizeof(Database));
-
-    // Init database connection
-    if (sqlite3_open("assets/world.db", &database->database) != SQLITE_OK) {
-        log_error("Can't open the SQLite database:\n%s", sqlite3_errmsg(database->database));
-    }
-    mtx_init(&database->database_lock, mtx_plain);
-    database->database_changes = 0;
-
-    // Create settings table if not exists
-    char *error_message = NULL;
-    if (sqlite3_exec(database->database, "CREATE TABLE IF NOT EXISTS [settings] ("
-        "[key] VARCHAR(32) UNIQUE NOT NULL,"
-        "[value] VARCHAR(255) NOT NULL"
-    ")", NULL, NULL, &error_message) != SQLITE_OK) {
-        log_error("Can't create the settings table:\n%s", error_message);
-    }
-
-    // Init settings select statement
-    if (sqlite3_prepare_v2(database->database, "SELECT [value] FROM [settings] WHERE [key] = ?", -1, &database->settings_select_statement, NULL) != SQLITE_OK) {
-        log_error("Can't create settings select statement");
-    }
-
-    // Init settings insert statement
-    if (sqlite3_prepare_v2(database->database, "INSERT INTO [settings] ([key], [value]) VALUES (?, ?)", -1, &database->settings_insert_statement, NULL) != SQLITE_OK) {
-        log_error("Can't create settings insert statement");
-    }
-
-    // Init settings update statement
-    if (sqlite3_prepare_v2(database->database, "UPDATE [settings] SET [value] = ? WHERE [key] = ?", -1, &database->settings_update_statement, NULL) != SQLITE_OK) {
-        log_error("Can't create settings update statement");
-    }
-
-    // Create chunks table if not exists
-    if (sqlite3_exec(database->database, "CREATE TABLE IF NOT EXISTS [chunks] ("
-        "[x] INT NOT NULL,"
-        "[y] INT NOT NULL,"
-        "[z] INT NOT NULL,"
-        "[data] BLOB NOT NULL,"
-        "UNIQUE([x], [y], [z])"
-    ")", NULL, NULL, &error_message) != SQLITE_OK) {
-        log_error("Can't create the chunks table:\n%s", error_message);
-    }
-
-    // Init chunks select statement
-    if (sqlite3_prepare_v2(database->database, "SELECT [data] FROM [chunks] WHERE [x] = ? AND [y] = ? AND [z] = ?", -1, &database->chunks_select_statement, NULL) != SQLITE_OK) {
-        log_error("Can't create chunks select statement");
-    }
-
-    // Init chunks insert statement
-    if (sqlite3_prepare_v2(database->database, "INSERT INTO [chunks] ([x], [y], [z], [data]) VALUES (?, ?, ?, ?)", -1, &database->chunks_insert_statement, NULL) != SQLITE_OK) {
-        log_error("Can't create chunks insert statement");
+#include "random.h"
+
+// Get a storage backend by its name, an unknown name is fatal
+DatabaseBackendType* database_get_backend_type(char* name) {
+    DatabaseBackendType* backend_types[] = { &DATABASE_BACKEND_SQLITE, &DATABASE_BACKEND_REGION, &DATABASE_BACKEND_MEMORY };
+    for (size_t i = 0; i < sizeof(backend_types) / sizeof(DatabaseBackendType*); i++) {
+        if (!strcmp(backend_types[i]->name, name)) {
+            return backend_types[i];
+        }
     }
+    log_error("Unknown database backend %s", name);
+    return NULL;
+}
 
-    // Init chunks update statement
-    if (sqlite3_prepare_v2(database->database, "UPDATE [chunks] SET [data] = ? WHERE [x] = ? AND [y] = ? AND [z] = ?", -1, &database->chunks_update_statement, NULL) != SQLITE_OK) {
-        log_error("Can't create chunks update statement");
-    }
+Database* database_new(char* path, DatabaseBackendType* backend_type) {
+    Database* database = malloc(sizeof(Database));
 
-    // Begin database transaction
-    if (sqlite3_exec(database->database, "BEGIN", NULL, NULL, &error_message) != SQLITE_OK) {
-        log_error("Can't begin database transaction:\n%s", error_message);
-    }
+    // Open the storage backend
+    log_info("Opening the world database %s with the %s backend", path, backend_type->name);
+    database->backend_type = backend_type;
+    database->backend = backend_type->open(path);
+
+    // Start the writer thread of the write behind buffer
+    mtx_init(&database->writes_lock, mtx_plain);
+    cnd_init(&database->writes_condition);
+    database->writes_count = 0;
+    database->writes_capacity = 64;
+    database->writes = malloc(database->writes_capacity * sizeof(DatabaseChunkWrite));
+    database->writes_slots = calloc(database->writes_capacity * 2, sizeof(int));
+    database->flushing_writes_count = 0;
+    database->flushing_writes_capacity = 64;
+    database->flushing_writes = malloc(database->flushing_writes_capacity * sizeof(DatabaseChunkWrite));
+    database->flushing_writes_slots = calloc(database->flushing_writes_capacity * 2, sizeof(int));
+    database->writer_running = true;
+    database->flushes_count = 0;
+    database->flushed_writes_count = 0;
+    thrd_create(&database->writer_thread, database_writer_thread, database);
 
     return database;
 }
 
 char* database_settings_get_string(Database* database, char* key, char* default_value) {
-    mtx_lock(&database->database_lock);
-
-    char* value;
-
-    // Do a select setting query to find the setting
-    sqlite3_reset(database->settings_select_statement);
-    sqlite3_bind_text(database->settings_select_statement, 1, key, strlen(key), SQLITE_STATIC);
-    if (sqlite3_step(database->settings_select_statement) == SQLITE_ROW) {
-        const uint8_t* value_string = sqlite3_column_text(database->settings_select_statement, 0);
-        value = string_copy((char*)value_string);
-    } else {
-        value = default_value;
-    }
-
-    mtx_unlock(&database->database_lock);
-
-    return value;
+    char* value = database->backend_type->get_setting(database->backend, key);
+    return value != NULL ? value : default_value;
 }
 
 int database_settings_get_int(Database* database, char* key, int default_value) {
@@ -119,35 +79,7 @@ float database_settings_get_float(Database* database, char* key, float default_v
 }
 
 void database_settings_set_string(Database* database, char* key, char* value) {
-    mtx_lock(&database->database_lock);
-
-    sqlite3_reset(database->settings_select_statement);
-    sqlite3_bind_text(database->settings_select_statement, 1, key, strlen(key), SQLITE_STATIC);
-    int result = sqlite3_step(database->settings_select_statement);
-
-    // If the settings exists update it in the database
-    if (result == SQLITE_ROW) {
-        sqlite3_reset(database->settings_update_statement);
-        sqlite3_bind_text(database->settings_update_statement, 1, value, strlen(value), SQLITE_STATIC);
-        sqlite3_bind_text(database->settings_update_statement, 2, key, strlen(key), SQLITE_STATIC);
-        if (sqlite3_step(database->settings_update_statement) != SQLITE_DONE) {
-            log_error("Can't update setting %s in database", key);
-        }
-    }
-
-    // Else insert it into the database
-    else {
-        sqlite3_reset(database->settings_insert_statement);
-        sqlite3_bind_text(database->settings_insert_statement, 1, key, strlen(key), SQLITE_STATIC);
-        sqlite3_bind_text(database->settings_insert_statement, 2, value, strlen(value), SQLITE_STATIC);
-        if (sqlite3_step(database->settings_insert_statement) != SQLITE_DONE) {
-            log_error("Can't insert setting %s into database", key);
-        }
-    }
-
-    mtx_unlock(&database->database_lock);
-
-    database_check_commit(database);
+    database->backend_type->set_setting(database->backend, key, value);
 }
 
 void database_settings_set_int(Database* database, char* key, int value) {
@@ -162,116 +94,200 @@ void database_settings_set_float(Database* database, char* key, float value) {
     database_settings_set_string(database, key, value_string);
 }
 
-Chunk* database_chunks_get_chunk(Database* database, int chunk_x, int chunk_y, int chunk_z) {
-    mtx_lock(&database->database_lock);
+// Pack a chunk position in one 64 bits key, every coordinate gets 21 bits which is more then enough
+int64_t database_get_chunk_key(int chunk_x, int chunk_y, int chunk_z) {
+    return ((int64_t)(chunk_x & 0x1fffff) << 42) |
+        ((int64_t)(chunk_y & 0x1fffff) << 21) |
+        (int64_t)(chunk_z & 0x1fffff);
+}
 
-    Chunk* chunk;
+// Unpack a packed chunk key, the coordinates are sign extended from there 21 bits
+void database_get_chunk_position(int64_t key, int* chunk_x, int* chunk_y, int* chunk_z) {
+    *chunk_x = (int32_t)((uint32_t)(key >> 42) << 11) >> 11;
+    *chunk_y = (int32_t)((uint32_t)(key >> 21) << 11) >> 11;
+    *chunk_z = (int32_t)((uint32_t)key << 11) >> 11;
+}
 
-    // Do a select query to select the chunk from the database
-    sqlite3_reset(database->chunks_select_statement);
-    sqlite3_bind_int(database->chunks_select_statement, 1, chunk_x);
-    sqlite3_bind_int(database->chunks_select_statement, 2, chunk_y);
-    sqlite3_bind_int(database->chunks_select_statement, 3, chunk_z);
-    if (sqlite3_step(database->chunks_select_statement) == SQLITE_ROW) {
-        const uint8_t* compressed_data = sqlite3_column_blob(database->chunks_select_statement, 0);
-        uint8_t *chunk_data = chunk_data_decompress((uint8_t*)compressed_data);
-        chunk = chunk_new_from_data(chunk_x, chunk_y, chunk_z, chunk_data);
-    }
-    else {
-        chunk = NULL;
+// Find the slot of a chunk write or the empty slot where it belongs, slots of writes that are already flushed
+// are skipped. Only call this when holding the writes lock
+int* database_find_chunk_write_slot(DatabaseChunkWrite* writes, int writes_count, int writes_capacity, int* slots, int chunk_x, int chunk_y, int chunk_z) {
+    int mask = writes_capacity * 2 - 1;
+    int index = random_mix(database_get_chunk_key(chunk_x, chunk_y, chunk_z)) & mask;
+    while (slots[index] != 0) {
+        DatabaseChunkWrite* chunk_write = &writes[slots[index] - 1];
+        if (slots[index] <= writes_count && chunk_write->x == chunk_x && chunk_write->y == chunk_y && chunk_write->z == chunk_z) {
+            break;
+        }
+        index = (index + 1) & mask;
     }
-
-    mtx_unlock(&database->database_lock);
-
-    return chunk;
+    return &slots[index];
 }
 
-void database_chunks_set_chunk(Database* database, Chunk* chunk) {
-    mtx_lock(&database->database_lock);
+// Find a chunk write in a write list, only call this when holding the writes lock
+DatabaseChunkWrite* database_find_chunk_write(DatabaseChunkWrite* writes, int writes_count, int writes_capacity, int* slots, int chunk_x, int chunk_y, int chunk_z) {
+    int* slot = database_find_chunk_write_slot(writes, writes_count, writes_capacity, slots, chunk_x, chunk_y, chunk_z);
+    return *slot != 0 ? &writes[*slot - 1] : NULL;
+}
 
-    // Compress chunk data
-    uint8_t* compressed_data = chunk_data_compress(chunk->data);
-    int compressed_size = (compressed_data[1] << 8) | compressed_data[0];
+Chunk* database_chunks_get_chunk(Database* database, int chunk_x, int chunk_y, int chunk_z) {
+    // The buffered writes are newer then the database so look in them first, the writer
+    // thread only removes the flushing writes after they are written to the database
+    mtx_lock(&database->writes_lock);
+    DatabaseChunkWrite* chunk_write = database_find_chunk_write(database->writes, database->writes_count,
+        database->writes_capacity, database->writes_slots, chunk_x, chunk_y, chunk_z);
+    if (chunk_write == NULL) {
+        chunk_write = database_find_chunk_write(database->flushing_writes, database->flushing_writes_count,
+            database->flushing_writes_capacity, database->flushing_writes_slots, chunk_x, chunk_y, chunk_z);
+    }
+    if (chunk_write != NULL) {
+        uint16_t chunk_data[CHUNK_DATA_SIZE];
+        bool is_decoded = chunk_codec_decode(chunk_write->compressed_data, chunk_write->compressed_size, chunk_data);
+        mtx_unlock(&database->writes_lock);
+        if (is_decoded) {
+            return chunk_new_from_data(chunk_x, chunk_y, chunk_z, chunk_data);
+        }
 
-    // Do a select query to check if the chunk exists in the database
-    sqlite3_reset(database->chunks_select_statement);
-    sqlite3_bind_int(database->chunks_select_statement, 1, chunk->x);
-    sqlite3_bind_int(database->chunks_select_statement, 2, chunk->y);
-    sqlite3_bind_int(database->chunks_select_statement, 3, chunk->z);
-    int result = sqlite3_step(database->chunks_select_statement);
+        // Fall back to the older chunk in the backend or generate the chunk again
+        log_warning("Can't decode buffered chunk %d %d %d", chunk_x, chunk_y, chunk_z);
+    } else {
+        mtx_unlock(&database->writes_lock);
+    }
 
-    // If it exists update the chunk
-    if (result == SQLITE_ROW) {
-        sqlite3_reset(database->chunks_update_statement);
-        sqlite3_bind_blob(database->chunks_update_statement, 1, compressed_data, compressed_size, SQLITE_STATIC);
-        sqlite3_bind_int(database->chunks_update_statement, 2, chunk->x);
-        sqlite3_bind_int(database->chunks_update_statement, 3, chunk->y);
-        sqlite3_bind_int(database->chunks_update_statement, 4, chunk->z);
-        if (sqlite3_step(database->chunks_update_statement) != SQLITE_DONE) {
-            log_error("Can't update chunk in database");
-        }
+    uint16_t chunk_data[CHUNK_DATA_SIZE];
+    if (database->backend_type->get_chunk(database->backend, chunk_x, chunk_y, chunk_z, chunk_data)) {
+        return chunk_new_from_data(chunk_x, chunk_y, chunk_z, chunk_data);
     }
+    return NULL;
+}
 
-    // Else insert the chunk into the database
-    else {
-        sqlite3_reset(database->chunks_insert_statement);
-        sqlite3_bind_int(database->chunks_insert_statement, 1, chunk->x);
-        sqlite3_bind_int(database->chunks_insert_statement, 2, chunk->y);
-        sqlite3_bind_int(database->chunks_insert_statement, 3, chunk->z);
-        sqlite3_bind_blob(database->chunks_insert_statement, 4, compressed_data, compressed_size, SQLITE_STATIC);
-        if (sqlite3_step(database->chunks_insert_statement) != SQLITE_DONE) {
-            log_error("Can't insert chunk into database");
+// Compress the chunk and put it in the write behind buffer, only call this when holding the chunk lock
+// or when no other thread uses the chunk
+void database_chunks_set_chunk(Database* database, Chunk* chunk) {
+    // Decode and encode chunk data, the buffered write gets a copy of exactly the encoded size
+    uint16_t chunk_data[CHUNK_DATA_SIZE];
+    chunk_storage_decode(chunk->storage, chunk_data);
+    uint8_t encoded_data[CHUNK_CODEC_MAX_SIZE];
+    int compressed_size = chunk_codec_encode(chunk_data, encoded_data);
+    uint8_t* compressed_data = malloc(compressed_size);
+    memcpy(compressed_data, encoded_data, compressed_size);
+
+    // Replace the buffered write of the chunk or add a new one
+    mtx_lock(&database->writes_lock);
+    int* slot = database_find_chunk_write_slot(database->writes, database->writes_count,
+        database->writes_capacity, database->writes_slots, chunk->x, chunk->y, chunk->z);
+    DatabaseChunkWrite* chunk_write;
+    if (*slot != 0) {
+        chunk_write = &database->writes[*slot - 1];
+        free(chunk_write->compressed_data);
+    } else {
+        // Double the writes and there hash map when the writes are full
+        if (database->writes_count == database->writes_capacity) {
+            database->writes_capacity *= 2;
+            database->writes = realloc(database->writes, database->writes_capacity * sizeof(DatabaseChunkWrite));
+            free(database->writes_slots);
+            database->writes_slots = calloc(database->writes_capacity * 2, sizeof(int));
+            for (int i = 0; i < database->writes_count; i++) {
+                DatabaseChunkWrite* other_chunk_write = &database->writes[i];
+                *database_find_chunk_write_slot(database->writes, i, database->writes_capacity, database->writes_slots,
+                    other_chunk_write->x, other_chunk_write->y, other_chunk_write->z) = i + 1;
+            }
+            slot = database_find_chunk_write_slot(database->writes, database->writes_count,
+                database->writes_capacity, database->writes_slots, chunk->x, chunk->y, chunk->z);
         }
+        *slot = database->writes_count + 1;
+        chunk_write = &database->writes[database->writes_count++];
+        chunk_write->x = chunk->x;
+        chunk_write->y = chunk->y;
+        chunk_write->z = chunk->z;
     }
-
-    // Free compressed data
-    free(compressed_data);
-
-    mtx_unlock(&database->database_lock);
-
-    database_check_commit(database);
+    chunk_write->compressed_data = compressed_data;
+    chunk_write->compressed_size = compressed_size;
+    if (database->writes_count >= DATABASE_FLUSH_COUNT) {
+        cnd_signal(&database->writes_condition);
+    }
+    mtx_unlock(&database->writes_lock);
 }
 
-void database_commit(Database* database) {
-    mtx_lock(&database->database_lock);
+// Write all buffered chunks in one transaction, only call this on the writer thread or when it is stopped
+void database_chunks_flush(Database* database) {
+    // Swap the buffered writes with the empty flushing writes so new writes don't wait for SQLite,
+    // the hash map of the flushing writes is cleared before it is used for the new writes
+    mtx_lock(&database->writes_lock);
+    DatabaseChunkWrite* writes = database->writes;
+    int writes_capacity = database->writes_capacity;
+    int* writes_slots = database->writes_slots;
+    database->writes = database->flushing_writes;
+    database->writes_capacity = database->flushing_writes_capacity;
+    database->writes_slots = database->flushing_writes_slots;
+    memset(database->writes_slots, 0, database->writes_capacity * 2 * sizeof(int));
+    database->flushing_writes = writes;
+    database->flushing_writes_count = database->writes_count;
+    database->flushing_writes_capacity = writes_capacity;
+    database->flushing_writes_slots = writes_slots;
+    database->writes_count = 0;
+    mtx_unlock(&database->writes_lock);
+
+    if (database->flushing_writes_count == 0) {
+        return;
+    }
 
-    // Commit pending database transaction and start a new own
-    char *error_message = NULL;
-    if (sqlite3_exec(database->database, "COMMIT;BEGIN", NULL, NULL, &error_message) != SQLITE_OK) {
-        log_error("Can't commit database transaction:\n%s", error_message);
+    database->backend_type->put_chunks(database->backend, database->flushing_writes, database->flushing_writes_count);
+
+    // The chunks are in the backend now so loads can find them there
+    mtx_lock(&database->writes_lock);
+    for (int i = 0; i < database->flushing_writes_count; i++) {
+        free(database->flushing_writes[i].compressed_data);
     }
+    database->flushes_count++;
+    database->flushed_writes_count += database->flushing_writes_count;
+    database->flushing_writes_count = 0;
+    mtx_unlock(&database->writes_lock);
+}
 
-    mtx_unlock(&database->database_lock);
+// Iterate over the chunks in the backend, chunks in the write behind buffer are not flushed yet so they are not included
+void database_chunks_iterate(Database* database, DatabaseChunkCallback callback, void* argument) {
+    database->backend_type->iterate_chunks(database->backend, callback, argument);
 }
 
-void database_check_commit(Database* database) {
-    // Check if the changes counter is at the commit rate then reset and commit
-    if (database->database_changes == DATABASE_COMMIT_RATE) {
-        database->database_changes = 0;
-        database_commit(database);
-    } else {
-        database->database_changes++;
+// Flush the write behind buffer every flush interval or earlier when it is full
+int database_writer_thread(void* argument) {
+    Database* database = (Database*)argument;
+    mtx_lock(&database->writes_lock);
+    while (database->writer_running) {
+        if (database->writes_count < DATABASE_FLUSH_COUNT) {
+            struct timespec flush_time;
+            timespec_get(&flush_time, TIME_UTC);
+            flush_time.tv_nsec += DATABASE_FLUSH_INTERVAL % 1000 * 1000000;
+            flush_time.tv_sec += DATABASE_FLUSH_INTERVAL / 1000 + flush_time.tv_nsec / 1000000000;
+            flush_time.tv_nsec %= 1000000000;
+            cnd_timedwait(&database->writes_condition, &database->writes_lock, &flush_time);
+        }
+        mtx_unlock(&database->writes_lock);
+        database_chunks_flush(database);
+        mtx_lock(&database->writes_lock);
     }
+    mtx_unlock(&database->writes_lock);
+    return EXIT_SUCCESS;
 }
 
 void database_free(Database* database) {
-    // Commit pending transactions
-    database_commit(database);
-
-    // Free statements
-    sqlite3_finalize(database->settings_select_statement);
-    sqlite3_finalize(database->settings_insert_statement);
-    sqlite3_finalize(database->settings_update_statement);
-
-    sqlite3_finalize(database->chunks_select_statement);
-    sqlite3_finalize(database->chunks_insert_statement);
-    sqlite3_finalize(database->chunks_update_statement);
-
-    // Close database connection
-    sqlite3_close(database->database);
-
-    // Free database mutex lock
-    mtx_destroy(&database->database_lock);
+    // Stop the writer thread and flush the last buffered chunks
+    mtx_lock(&database->writes_lock);
+    database->writer_running = false;
+    cnd_signal(&database->writes_condition);
+    mtx_unlock(&database->writes_lock);
+    thrd_join(database->writer_thread, NULL);
+    database_chunks_flush(database);
+    free(database->writes);
+    free(database->writes_slots);
+    free(database->flushing_writes);
+    free(database->flushing_writes_slots);
+    cnd_destroy(&database->writes_condition);
+    mtx_destroy(&database->writes_lock);
+
+    // Make the backend durable and close it
+    database->backend_type->flush(database->backend);
+    database->backend_type->close(database->backend);
 
     // Free database object
     free(database);
@@ -0,0 +1,182 @@
+// PlaatCraft - Database Memory
+
+#include "database_memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include "chunk_codec.h"
+#include "database.h"
+#include "random.h"
+#include "utils.h"
+
+DatabaseBackendType DATABASE_BACKEND_MEMORY = {
+    "memory",
+    "",
+    database_memory_open,
+    database_memory_get_setting,
+    database_memory_set_setting,
+    database_memory_get_chunk,
+    database_memory_put_chunk,
+    database_memory_put_chunks,
+    database_memory_iterate_chunks,
+    database_memory_flush,
+    database_memory_close
+};
+
+// The path is not used, the world is gone when the backend is closed
+void* database_memory_open(char* path) {
+    (void)path;
+    DatabaseMemory* database = malloc(sizeof(DatabaseMemory));
+    mtx_init(&database->lock, mtx_plain);
+    database->setting_keys = NULL;
+    database->setting_values = NULL;
+    database->settings_count = 0;
+    database->settings_capacity = 0;
+    database->chunks_count = 0;
+    database->chunks_capacity = 1024;
+    database->chunks = malloc(database->chunks_capacity * sizeof(DatabaseMemoryChunk));
+    for (int i = 0; i < database->chunks_capacity; i++) {
+        database->chunks[i].key = DATABASE_MEMORY_EMPTY_KEY;
+    }
+    return database;
+}
+
+char* database_memory_get_setting(void* backend, char* key) {
+    DatabaseMemory* database = backend;
+    mtx_lock(&database->lock);
+    char* value = NULL;
+    for (int i = 0; i < database->settings_count; i++) {
+        if (!strcmp(database->setting_keys[i], key)) {
+            value = string_copy(database->setting_values[i]);
+            break;
+        }
+    }
+    mtx_unlock(&database->lock);
+    return value;
+}
+
+void database_memory_set_setting(void* backend, char* key, char* value) {
+    DatabaseMemory* database = backend;
+    mtx_lock(&database->lock);
+    for (int i = 0; i < database->settings_count; i++) {
+        if (!strcmp(database->setting_keys[i], key)) {
+            free(database->setting_values[i]);
+            database->setting_values[i] = string_copy(value);
+            mtx_unlock(&database->lock);
+            return;
+        }
+    }
+
+    if (database->settings_count == database->settings_capacity) {
+        database->settings_capacity = database->settings_capacity == 0 ? 16 : database->settings_capacity * 2;
+        database->setting_keys = realloc(database->setting_keys, database->settings_capacity * sizeof(char*));
+        database->setting_values = realloc(database->setting_values, database->settings_capacity * sizeof(char*));
+    }
+    database->setting_keys[database->settings_count] = string_copy(key);
+    database->setting_values[database->settings_count] = string_copy(value);
+    database->settings_count++;
+    mtx_unlock(&database->lock);
+}
+
+// Find the slot of a chunk key or the empty slot where it belongs, only call this when holding the lock
+DatabaseMemoryChunk* database_memory_find_chunk(DatabaseMemory* database, int64_t key) {
+    int index = random_mix(key) & (database->chunks_capacity - 1);
+    while (database->chunks[index].key != DATABASE_MEMORY_EMPTY_KEY && database->chunks[index].key != key) {
+        index = (index + 1) & (database->chunks_capacity - 1);
+    }
+    return &database->chunks[index];
+}
+
+bool database_memory_get_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data) {
+    DatabaseMemory* database = backend;
+    mtx_lock(&database->lock);
+    DatabaseMemoryChunk* chunk = database_memory_find_chunk(database, database_get_chunk_key(chunk_x, chunk_y, chunk_z));
+    bool is_found = chunk->key != DATABASE_MEMORY_EMPTY_KEY &&
+        chunk_codec_decode(chunk->compressed_data, chunk->compressed_size, chunk_data);
+    mtx_unlock(&database->lock);
+    return is_found;
+}
+
+// Store a copy of the compressed data, only call this when holding the lock
+void database_memory_store_chunk(DatabaseMemory* database, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size) {
+    // Double the hash map when it is half full so the probe sequences stay short
+    if (database->chunks_count * 2 >= database->chunks_capacity) {
+        DatabaseMemoryChunk* old_chunks = database->chunks;
+        int old_chunks_capacity = database->chunks_capacity;
+        database->chunks_capacity *= 2;
+        database->chunks = malloc(database->chunks_capacity * sizeof(DatabaseMemoryChunk));
+        for (int i = 0; i < database->chunks_capacity; i++) {
+            database->chunks[i].key = DATABASE_MEMORY_EMPTY_KEY;
+        }
+        for (int i = 0; i < old_chunks_capacity; i++) {
+            if (old_chunks[i].key != DATABASE_MEMORY_EMPTY_KEY) {
+                *database_memory_find_chunk(database, old_chunks[i].key) = old_chunks[i];
+            }
+        }
+        free(old_chunks);
+    }
+
+    int64_t key = database_get_chunk_key(chunk_x, chunk_y, chunk_z);
+    DatabaseMemoryChunk* chunk = database_memory_find_chunk(database, key);
+    if (chunk->key != DATABASE_MEMORY_EMPTY_KEY) {
+        free(chunk->compressed_data);
+    } else {
+        chunk->key = key;
+        database->chunks_count++;
+    }
+    chunk->compressed_data = malloc(compressed_size);
+    memcpy(chunk->compressed_data, compressed_data, compressed_size);
+    chunk->compressed_size = compressed_size;
+}
+
+void database_memory_put_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size) {
+    DatabaseMemory* database = backend;
+    mtx_lock(&database->lock);
+    database_memory_store_chunk(database, chunk_x, chunk_y, chunk_z, compressed_data, compressed_size);
+    mtx_unlock(&database->lock);
+}
+
+void database_memory_put_chunks(void* backend, DatabaseChunkWrite* writes, int writes_count) {
+    DatabaseMemory* database = backend;
+    mtx_lock(&database->lock);
+    for (int i = 0; i < writes_count; i++) {
+        database_memory_store_chunk(database, writes[i].x, writes[i].y, writes[i].z, writes[i].compressed_data, writes[i].compressed_size);
+    }
+    mtx_unlock(&database->lock);
+}
+
+void database_memory_iterate_chunks(void* backend, DatabaseChunkCallback callback, void* argument) {
+    DatabaseMemory* database = backend;
+    mtx_lock(&database->lock);
+    for (int i = 0; i < database->chunks_capacity; i++) {
+        DatabaseMemoryChunk* chunk = &database->chunks[i];
+        if (chunk->key != DATABASE_MEMORY_EMPTY_KEY) {
+            int chunk_x, chunk_y, chunk_z;
+            database_get_chunk_position(chunk->key, &chunk_x, &chunk_y, &chunk_z);
+            callback(argument, chunk_x, chunk_y, chunk_z, chunk->compressed_data, chunk->compressed_size);
+        }
+    }
+    mtx_unlock(&database->lock);
+}
+
+// There is nothing to make durable
+void database_memory_flush(void* backend) {
+    (void)backend;
+}
+
+void database_memory_close(void* backend) {
+    DatabaseMemory* database = backend;
+    for (int i = 0; i < database->settings_count; i++) {
+        free(database->setting_keys[i]);
+        free(database->setting_values[i]);
+    }
+    free(database->setting_keys);
+    free(database->setting_values);
+    for (int i = 0; i < database->chunks_capacity; i++) {
+        if (database->chunks[i].key != DATABASE_MEMORY_EMPTY_KEY) {
+            free(database->chunks[i].compressed_data);
+        }
+    }
+    free(database->chunks);
+    mtx_destroy(&database->lock);
+    free(database);
+}
@@ -0,0 +1,465 @@
+// PlaatCraft - Database Region
+
+#include "database_region.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "chunk_codec.h"
+#include "database.h"
+#include "log.h"
+#include "utils.h"
+#ifdef __WIN32__
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+DatabaseBackendType DATABASE_BACKEND_REGION = {
+    "region",
+    "assets/world",
+    database_region_open,
+    database_region_get_setting,
+    database_region_set_setting,
+    database_region_get_chunk,
+    database_region_put_chunk,
+    database_region_put_chunks,
+    database_region_iterate_chunks,
+    database_region_flush,
+    database_region_close
+};
+
+// Read at an offset of a file, on Windows the file position moves so only call this when holding the lock
+void database_region_read_at(int file, void* buffer, uint32_t size, uint32_t offset) {
+    #ifdef __WIN32__
+        if (_lseeki64(file, offset, SEEK_SET) != offset || read(file, buffer, size) != (int)size) {
+            log_error("Can't read from a region file");
+        }
+    #else
+        if (pread(file, buffer, size, offset) != (ssize_t)size) {
+            log_error("Can't read from a region file");
+        }
+    #endif
+}
+
+// Write at an offset of a file, only call this when holding the lock
+void database_region_write_at(int file, void* buffer, uint32_t size, uint32_t offset) {
+    #ifdef __WIN32__
+        if (_lseeki64(file, offset, SEEK_SET) != offset || write(file, buffer, size) != (int)size) {
+            log_error("Can't write to a region file");
+        }
+    #else
+        if (pwrite(file, buffer, size, offset) != (ssize_t)size) {
+            log_error("Can't write to a region file");
+        }
+    #endif
+}
+
+uint32_t database_region_read_uint32(uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+void database_region_write_uint32(uint8_t* data, uint32_t value) {
+    data[0] = value & 0xff;
+    data[1] = (value >> 8) & 0xff;
+    data[2] = (value >> 16) & 0xff;
+    data[3] = value >> 24;
+}
+
+void* database_region_open(char* path) {
+    DatabaseRegionFiles* database = malloc(sizeof(DatabaseRegionFiles));
+    database->path = string_copy(path);
+    mtx_init(&database->lock, mtx_plain);
+    database->readers_count = 0;
+    database->regions = NULL;
+    database->regions_count = 0;
+    database->regions_capacity = 0;
+
+    // Create the world directory when it does not exists
+    #ifdef __WIN32__
+        mkdir(path);
+    #else
+        mkdir(path, 0755);
+    #endif
+
+    // Read the settings file, every line is a key and a value separated by an equals sign
+    database->settings = database_memory_open(NULL);
+    char settings_path[512];
+    sprintf(settings_path, "%s/settings.txt", path);
+    FILE* settings_file = fopen(settings_path, "r");
+    if (settings_file != NULL) {
+        char line[512];
+        while (fgets(line, sizeof(line), settings_file) != NULL) {
+            char* separator = strchr(line, '=');
+            if (separator != NULL) {
+                char* value = separator + 1;
+                *separator = '\0';
+                value[strcspn(value, "\r\n")] = '\0';
+                database_memory_set_setting(database->settings, line, value);
+            }
+        }
+        fclose(settings_file);
+    }
+    return database;
+}
+
+char* database_region_get_setting(void* backend, char* key) {
+    DatabaseRegionFiles* database = backend;
+    return database_memory_get_setting(database->settings, key);
+}
+
+void database_region_set_setting(void* backend, char* key, char* value) {
+    DatabaseRegionFiles* database = backend;
+    database_memory_set_setting(database->settings, key, value);
+}
+
+int database_region_compare_extents(const void* a, const void* b) {
+    uint32_t offset_a = ((DatabaseRegionEntry*)a)->offset;
+    uint32_t offset_b = ((DatabaseRegionEntry*)b)->offset;
+    return offset_a < offset_b ? -1 : offset_a > offset_b;
+}
+
+// Make room for one more extent in an extents list
+void database_region_grow_extents(DatabaseRegionEntry** extents, int extents_count, int* extents_capacity) {
+    if (extents_count == *extents_capacity) {
+        *extents_capacity = *extents_capacity == 0 ? 16 : *extents_capacity * 2;
+        *extents = realloc(*extents, *extents_capacity * sizeof(DatabaseRegionEntry));
+    }
+}
+
+// Rebuild the free extents from the gaps between the chunks of an opened region file so the space
+// of chunks that where rewritten before is used again, the end is moved back to the last chunk
+void database_region_find_free_extents(DatabaseRegion* region) {
+    DatabaseRegionEntry* used_extents = malloc(DATABASE_REGION_CHUNKS_COUNT * sizeof(DatabaseRegionEntry));
+    int used_extents_count = 0;
+    for (int i = 0; i < DATABASE_REGION_CHUNKS_COUNT; i++) {
+        if (region->entries[i].size != 0) {
+            used_extents[used_extents_count++] = region->entries[i];
+        }
+    }
+    qsort(used_extents, used_extents_count, sizeof(DatabaseRegionEntry), database_region_compare_extents);
+
+    uint32_t position = DATABASE_REGION_CHUNKS_COUNT * DATABASE_REGION_ENTRY_SIZE;
+    for (int i = 0; i < used_extents_count; i++) {
+        if (used_extents[i].offset > position) {
+            database_region_grow_extents(&region->free_extents, region->free_extents_count, &region->free_extents_capacity);
+            region->free_extents[region->free_extents_count].offset = position;
+            region->free_extents[region->free_extents_count].size = used_extents[i].offset - position;
+            region->free_extents_count++;
+        }
+        if (used_extents[i].offset + used_extents[i].size > position) {
+            position = used_extents[i].offset + used_extents[i].size;
+        }
+    }
+    region->end = position;
+    free(used_extents);
+}
+
+// Add an extent to the sorted free extents and merge it with the extents it touches, free space at the
+// end of the file moves the end back. Only call this when holding the lock
+void database_region_add_free_extent(DatabaseRegion* region, uint32_t offset, uint32_t size) {
+    DatabaseRegionEntry* extents = region->free_extents;
+    int index = 0;
+    while (index < region->free_extents_count && extents[index].offset < offset) {
+        index++;
+    }
+
+    if (index > 0 && extents[index - 1].offset + extents[index - 1].size == offset) {
+        extents[index - 1].size += size;
+        if (index < region->free_extents_count && extents[index - 1].offset + extents[index - 1].size == extents[index].offset) {
+            extents[index - 1].size += extents[index].size;
+            memmove(&extents[index], &extents[index + 1], (region->free_extents_count - index - 1) * sizeof(DatabaseRegionEntry));
+            region->free_extents_count--;
+        }
+    } else if (index < region->free_extents_count && offset + size == extents[index].offset) {
+        extents[index].offset = offset;
+        extents[index].size += size;
+    } else {
+        database_region_grow_extents(&region->free_extents, region->free_extents_count, &region->free_extents_capacity);
+        extents = region->free_extents;
+        memmove(&extents[index + 1], &extents[index], (region->free_extents_count - index) * sizeof(DatabaseRegionEntry));
+        extents[index].offset = offset;
+        extents[index].size = size;
+        region->free_extents_count++;
+    }
+
+    DatabaseRegionEntry* last_extent = &extents[region->free_extents_count - 1];
+    if (last_extent->offset + last_extent->size == region->end) {
+        region->end = last_extent->offset;
+        region->free_extents_count--;
+    }
+}
+
+// Get the offset for a chunk of a size from the first free extent that fits or the end of the file,
+// only call this when holding the lock
+uint32_t database_region_allocate(DatabaseRegion* region, uint32_t size) {
+    for (int i = 0; i < region->free_extents_count; i++) {
+        DatabaseRegionEntry* extent = &region->free_extents[i];
+        if (extent->size >= size) {
+            uint32_t offset = extent->offset;
+            extent->offset += size;
+            extent->size -= size;
+            if (extent->size == 0) {
+                memmove(extent, extent + 1, (region->free_extents_count - i - 1) * sizeof(DatabaseRegionEntry));
+                region->free_extents_count--;
+            }
+            return offset;
+        }
+    }
+
+    uint32_t offset = region->end;
+    region->end += size;
+    return offset;
+}
+
+// Open the file of a region, a missing file is only created when is create is set so exploring
+// creates no empty region files. Only call this when holding the lock
+void database_region_open_file(DatabaseRegionFiles* database, DatabaseRegion* region, bool is_create) {
+    char region_path[512];
+    sprintf(region_path, "%s/r.%d.%d.%d.region", database->path, region->x, region->y, region->z);
+    #ifdef __WIN32__
+        region->file = open(region_path, O_RDWR | O_BINARY | (is_create ? O_CREAT : 0), 0644);
+    #else
+        region->file = open(region_path, O_RDWR | (is_create ? O_CREAT : 0), 0644);
+    #endif
+    if (region->file == -1) {
+        if (is_create) {
+            log_error("Can't open region file %s", region_path);
+        }
+        return;
+    }
+
+    // A new region file gets an empty offset table
+    uint32_t entries_size = DATABASE_REGION_CHUNKS_COUNT * DATABASE_REGION_ENTRY_SIZE;
+    uint8_t* entries_data = calloc(entries_size, 1);
+    region->entries = calloc(DATABASE_REGION_CHUNKS_COUNT, sizeof(DatabaseRegionEntry));
+    region->end = lseek(region->file, 0, SEEK_END);
+    if (region->end == 0) {
+        database_region_write_at(region->file, entries_data, entries_size, 0);
+        region->end = entries_size;
+    } else {
+        database_region_read_at(region->file, entries_data, entries_size, 0);
+        for (int i = 0; i < DATABASE_REGION_CHUNKS_COUNT; i++) {
+            region->entries[i].offset = database_region_read_uint32(&entries_data[i * DATABASE_REGION_ENTRY_SIZE]);
+            region->entries[i].size = database_region_read_uint32(&entries_data[i * DATABASE_REGION_ENTRY_SIZE + 4]);
+        }
+        database_region_find_free_extents(region);
+    }
+    free(entries_data);
+}
+
+// Get an opened region or open its file, only call this when holding the lock
+DatabaseRegion* database_region_get_region(DatabaseRegionFiles* database, int region_x, int region_y, int region_z) {
+    for (int i = 0; i < database->regions_count; i++) {
+        DatabaseRegion* region = database->regions[i];
+        if (region->x == region_x && region->y == region_y && region->z == region_z) {
+            return region;
+        }
+    }
+
+    DatabaseRegion* region = malloc(sizeof(DatabaseRegion));
+    region->x = region_x;
+    region->y = region_y;
+    region->z = region_z;
+    region->end = 0;
+    region->is_changed = false;
+    region->entries = NULL;
+    region->free_extents = NULL;
+    region->free_extents_count = 0;
+    region->free_extents_capacity = 0;
+    region->pending_extents = NULL;
+    region->pending_extents_count = 0;
+    region->pending_extents_capacity = 0;
+    database_region_open_file(database, region, false);
+
+    if (database->regions_count == database->regions_capacity) {
+        database->regions_capacity = database->regions_capacity == 0 ? 16 : database->regions_capacity * 2;
+        database->regions = realloc(database->regions, database->regions_capacity * sizeof(DatabaseRegion*));
+    }
+    database->regions[database->regions_count++] = region;
+    return region;
+}
+
+// The index of a chunk in the offset table of its region
+int database_region_get_entry_index(int chunk_x, int chunk_y, int chunk_z) {
+    int region_mask = DATABASE_REGION_SIZE - 1;
+    return ((chunk_z & region_mask) * DATABASE_REGION_SIZE + (chunk_y & region_mask)) * DATABASE_REGION_SIZE + (chunk_x & region_mask);
+}
+
+bool database_region_get_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data) {
+    DatabaseRegionFiles* database = backend;
+    mtx_lock(&database->lock);
+    DatabaseRegion* region = database_region_get_region(database, chunk_x >> DATABASE_REGION_SIZE_SHIFT, chunk_y >> DATABASE_REGION_SIZE_SHIFT, chunk_z >> DATABASE_REGION_SIZE_SHIFT);
+    if (region->entries == NULL || region->entries[database_region_get_entry_index(chunk_x, chunk_y, chunk_z)].size == 0) {
+        mtx_unlock(&database->lock);
+        return false;
+    }
+    DatabaseRegionEntry entry = region->entries[database_region_get_entry_index(chunk_x, chunk_y, chunk_z)];
+
+    // The extent of the chunk is not used again while the read is busy so on other platforms
+    // then Windows read it without the lock
+    __atomic_add_fetch(&database->readers_count, 1, __ATOMIC_RELAXED);
+    #ifndef __WIN32__
+        mtx_unlock(&database->lock);
+    #endif
+    uint8_t* compressed_data = malloc(entry.size);
+    database_region_read_at(region->file, compressed_data, entry.size, entry.offset);
+    #ifdef __WIN32__
+        mtx_unlock(&database->lock);
+    #endif
+    __atomic_sub_fetch(&database->readers_count, 1, __ATOMIC_RELEASE);
+
+    bool is_decoded = chunk_codec_decode(compressed_data, entry.size, chunk_data);
+    free(compressed_data);
+    if (!is_decoded) {
+        log_warning("Can't decode chunk %d %d %d, it will be generated again", chunk_x, chunk_y, chunk_z);
+    }
+    return is_decoded;
+}
+
+// Write the chunk to a free extent of its region file and point its entry to it, the old extent
+// of the chunk is pending until the next flush. Only call this when holding the lock
+void database_region_store_chunk(DatabaseRegionFiles* database, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size) {
+    DatabaseRegion* region = database_region_get_region(database, chunk_x >> DATABASE_REGION_SIZE_SHIFT, chunk_y >> DATABASE_REGION_SIZE_SHIFT, chunk_z >> DATABASE_REGION_SIZE_SHIFT);
+    if (region->file == -1) {
+        database_region_open_file(database, region, true);
+    }
+    uint32_t offset = database_region_allocate(region, compressed_size);
+    database_region_write_at(region->file, compressed_data, compressed_size, offset);
+
+    int entry_index = database_region_get_entry_index(chunk_x, chunk_y, chunk_z);
+    DatabaseRegionEntry* entry = &region->entries[entry_index];
+    if (entry->size != 0) {
+        database_region_grow_extents(&region->pending_extents, region->pending_extents_count, &region->pending_extents_capacity);
+        region->pending_extents[region->pending_extents_count++] = *entry;
+    }
+    entry->offset = offset;
+    entry->size = compressed_size;
+
+    uint8_t entry_data[DATABASE_REGION_ENTRY_SIZE];
+    database_region_write_uint32(&entry_data[0], entry->offset);
+    database_region_write_uint32(&entry_data[4], entry->size);
+    database_region_write_at(region->file, entry_data, DATABASE_REGION_ENTRY_SIZE, entry_index * DATABASE_REGION_ENTRY_SIZE);
+    region->is_changed = true;
+}
+
+void database_region_put_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size) {
+    DatabaseRegionFiles* database = backend;
+    mtx_lock(&database->lock);
+    database_region_store_chunk(database, chunk_x, chunk_y, chunk_z, compressed_data, compressed_size);
+    mtx_unlock(&database->lock);
+}
+
+void database_region_put_chunks(void* backend, DatabaseChunkWrite* writes, int writes_count) {
+    DatabaseRegionFiles* database = backend;
+    mtx_lock(&database->lock);
+    for (int i = 0; i < writes_count; i++) {
+        database_region_store_chunk(database, writes[i].x, writes[i].y, writes[i].z, writes[i].compressed_data, writes[i].compressed_size);
+    }
+    mtx_unlock(&database->lock);
+}
+
+// Iterate over all region files in the world directory and all chunks in them
+void database_region_iterate_chunks(void* backend, DatabaseChunkCallback callback, void* argument) {
+    DatabaseRegionFiles* database = backend;
+    mtx_lock(&database->lock);
+    DIR* directory = opendir(database->path);
+    if (directory == NULL) {
+        mtx_unlock(&database->lock);
+        return;
+    }
+
+    struct dirent* directory_entry;
+    while ((directory_entry = readdir(directory)) != NULL) {
+        int region_x, region_y, region_z;
+        char extension[8];
+        if (sscanf(directory_entry->d_name, "r.%d.%d.%d.%7s", &region_x, &region_y, &region_z, extension) != 4 || strcmp(extension, "region")) {
+            continue;
+        }
+
+        // Region files that can't be opened have no offset table
+        DatabaseRegion* region = database_region_get_region(database, region_x, region_y, region_z);
+        if (region->file == -1) {
+            continue;
+        }
+        for (int i = 0; i < DATABASE_REGION_CHUNKS_COUNT; i++) {
+            DatabaseRegionEntry* entry = &region->entries[i];
+            if (entry->size != 0) {
+                uint8_t* compressed_data = malloc(entry->size);
+                database_region_read_at(region->file, compressed_data, entry->size, entry->offset);
+                callback(argument,
+                    region_x * DATABASE_REGION_SIZE + i % DATABASE_REGION_SIZE,
+                    region_y * DATABASE_REGION_SIZE + i / DATABASE_REGION_SIZE % DATABASE_REGION_SIZE,
+                    region_z * DATABASE_REGION_SIZE + i / (DATABASE_REGION_SIZE * DATABASE_REGION_SIZE),
+                    compressed_data, entry->size);
+                free(compressed_data);
+            }
+        }
+    }
+    closedir(directory);
+    mtx_unlock(&database->lock);
+}
+
+// Sync the changed region files and write the settings file. The synced entries don't point to the
+// pending extents anymore so they are free when no reader that got an old entry is still busy
+void database_region_flush(void* backend) {
+    DatabaseRegionFiles* database = backend;
+    mtx_lock(&database->lock);
+    bool is_reading = __atomic_load_n(&database->readers_count, __ATOMIC_ACQUIRE) > 0;
+    for (int i = 0; i < database->regions_count; i++) {
+        DatabaseRegion* region = database->regions[i];
+        if (region->is_changed) {
+            #ifdef __WIN32__
+                _commit(region->file);
+            #else
+                fsync(region->file);
+            #endif
+            region->is_changed = false;
+        }
+        if (!is_reading) {
+            for (int j = 0; j < region->pending_extents_count; j++) {
+                database_region_add_free_extent(region, region->pending_extents[j].offset, region->pending_extents[j].size);
+            }
+            region->pending_extents_count = 0;
+        }
+    }
+
+    char settings_path[512];
+    sprintf(settings_path, "%s/settings.txt", database->path);
+    // A read only or full disk keeps the old settings file, the chunks are already synced
+    FILE* settings_file = fopen(settings_path, "w");
+    if (settings_file == NULL) {
+        log_warning("Can't write settings file %s", settings_path);
+        mtx_unlock(&database->lock);
+        return;
+    }
+    DatabaseMemory* settings = database->settings;
+    mtx_lock(&settings->lock);
+    for (int i = 0; i < settings->settings_count; i++) {
+        fprintf(settings_file, "%s=%s\n", settings->setting_keys[i], settings->setting_values[i]);
+    }
+    mtx_unlock(&settings->lock);
+    fclose(settings_file);
+    mtx_unlock(&database->lock);
+}
+
+void database_region_close(void* backend) {
+    DatabaseRegionFiles* database = backend;
+    database_region_flush(database);
+    for (int i = 0; i < database->regions_count; i++) {
+        if (database->regions[i]->file != -1) {
+            close(database->regions[i]->file);
+            free(database->regions[i]->entries);
+        }
+        free(database->regions[i]->free_extents);
+        free(database->regions[i]->pending_extents);
+        free(database->regions[i]);
+    }
+    free(database->regions);
+    database_memory_close(database->settings);
+    mtx_destroy(&database->lock);
+    free(database->path);
+    free(database);
+}
@@ -0,0 +1,363 @@
+// PlaatCraft - Database SQLite
+
+#include "database_sqlite.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chunk_codec.h"
+#include "database.h"
+#include "utils.h"
+#include "log.h"
+
+DatabaseBackendType DATABASE_BACKEND_SQLITE = {
+    "sqlite",
+    "assets/world.db",
+    database_sqlite_open,
+    database_sqlite_get_setting,
+    database_sqlite_set_setting,
+    database_sqlite_get_chunk,
+    database_sqlite_put_chunk,
+    database_sqlite_put_chunks,
+    database_sqlite_iterate_chunks,
+    database_sqlite_flush,
+    database_sqlite_close
+};
+
+// Get the schema version of the database, worlds from before schema versions are version 1
+int database_sqlite_get_schema_version(DatabaseSqlite* database) {
+    sqlite3_stmt* statement;
+    sqlite3_prepare_v2(database->database, "PRAGMA user_version", -1, &statement, NULL);
+    int schema_version = sqlite3_step(statement) == SQLITE_ROW ? sqlite3_column_int(statement, 0) : 0;
+    sqlite3_finalize(statement);
+    if (schema_version != 0) {
+        return schema_version;
+    }
+
+    sqlite3_prepare_v2(database->database, "SELECT 1 FROM [sqlite_master] WHERE [type] = 'table' AND [name] = 'chunks'", -1, &statement, NULL);
+    bool is_chunks_table = sqlite3_step(statement) == SQLITE_ROW;
+    sqlite3_finalize(statement);
+    return is_chunks_table ? 1 : 0;
+}
+
+// Create the chunks table or migrate the chunks of a version 1 world, version 1 has an x, y and z column
+// with a composite unique index, version 2 keys the chunks on the packed position as the rowid
+void database_sqlite_migrate_chunks(DatabaseSqlite* database) {
+    int schema_version = database_sqlite_get_schema_version(database);
+    if (schema_version > DATABASE_SCHEMA_VERSION) {
+        log_error("The world database has schema version %d, this version of PlaatCraft only knows version %d", schema_version, DATABASE_SCHEMA_VERSION);
+    }
+    if (schema_version == DATABASE_SCHEMA_VERSION) {
+        return;
+    }
+
+    char *error_message = NULL;
+    if (sqlite3_exec(database->database, "BEGIN;"
+        "CREATE TABLE [chunks_v2] ("
+            "[key] INTEGER PRIMARY KEY,"
+            "[data] BLOB NOT NULL"
+        ")", NULL, NULL, &error_message) != SQLITE_OK) {
+        log_error("Can't create the chunks table:\n%s", error_message);
+    }
+
+    if (schema_version == 1) {
+        log_info("Migrating the world database to schema version %d", DATABASE_SCHEMA_VERSION);
+        if (sqlite3_exec(database->database, "INSERT INTO [chunks_v2] ([key], [data]) SELECT "
+            "(([x] & 2097151) << 42) | (([y] & 2097151) << 21) | ([z] & 2097151), [data] FROM [chunks];"
+            "DROP TABLE [chunks]", NULL, NULL, &error_message) != SQLITE_OK) {
+            log_error("Can't migrate the chunks table:\n%s", error_message);
+        }
+    }
+
+    char query[128];
+    sprintf(query, "ALTER TABLE [chunks_v2] RENAME TO [chunks];PRAGMA user_version = %d;COMMIT", DATABASE_SCHEMA_VERSION);
+    if (sqlite3_exec(database->database, query, NULL, NULL, &error_message) != SQLITE_OK) {
+        log_error("Can't migrate the chunks table:\n%s", error_message);
+    }
+}
+
+// Set the pragmas that every connection shares, a page cache and memory mapped reads
+void database_sqlite_set_connection_pragmas(sqlite3* database) {
+    char query[128];
+    sprintf(query, "PRAGMA cache_size = -%d;PRAGMA mmap_size = %d", DATABASE_CACHE_SIZE, DATABASE_MMAP_SIZE);
+    char *error_message = NULL;
+    if (sqlite3_exec(database, query, NULL, NULL, &error_message) != SQLITE_OK) {
+        log_error("Can't set the database pragmas:\n%s", error_message);
+    }
+}
+
+void* database_sqlite_open(char* path) {
+    DatabaseSqlite* database = malloc(sizeof(DatabaseSqlite));
+
+    // Init writer database connection, in WAL mode a commit only syncs at checkpoints
+    if (sqlite3_open(path, &database->database) != SQLITE_OK) {
+        log_error("Can't open the SQLite database:\n%s", sqlite3_errmsg(database->database));
+    }
+    mtx_init(&database->database_lock, mtx_plain);
+    database->database_changes = 0;
+
+    char *error_message = NULL;
+    if (sqlite3_exec(database->database, "PRAGMA journal_mode = WAL;PRAGMA synchronous = NORMAL", NULL, NULL, &error_message) != SQLITE_OK) {
+        log_error("Can't set the database journal mode:\n%s", error_message);
+    }
+    database_sqlite_set_connection_pragmas(database->database);
+
+    // Create settings table if not exists
+    if (sqlite3_exec(database->database, "CREATE TABLE IF NOT EXISTS [settings] ("
+        "[key] VARCHAR(32) UNIQUE NOT NULL,"
+        "[value] VARCHAR(255) NOT NULL"
+    ")", NULL, NULL, &error_message) != SQLITE_OK) {
+        log_error("Can't create the settings table:\n%s", error_message);
+    }
+
+    // Init settings select statement
+    if (sqlite3_prepare_v2(database->database, "SELECT [value] FROM [settings] WHERE [key] = ?", -1, &database->settings_select_statement, NULL) != SQLITE_OK) {
+        log_error("Can't create settings select statement");
+    }
+
+    // Init settings insert statement
+    if (sqlite3_prepare_v2(database->database, "INSERT INTO [settings] ([key], [value]) VALUES (?, ?)", -1, &database->settings_insert_statement, NULL) != SQLITE_OK) {
+        log_error("Can't create settings insert statement");
+    }
+
+    // Init settings update statement
+    if (sqlite3_prepare_v2(database->database, "UPDATE [settings] SET [value] = ? WHERE [key] = ?", -1, &database->settings_update_statement, NULL) != SQLITE_OK) {
+        log_error("Can't create settings update statement");
+    }
+
+    // Create chunks table or migrate it to the newest schema version
+    database_sqlite_migrate_chunks(database);
+
+    // Init the read only connections for the chunk loads
+    for (int i = 0; i < DATABASE_READERS_COUNT; i++) {
+        DatabaseSqliteReader* reader = &database->readers[i];
+        if (sqlite3_open_v2(path, &reader->database, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+            log_error("Can't open the SQLite database:\n%s", sqlite3_errmsg(reader->database));
+        }
+        database_sqlite_set_connection_pragmas(reader->database);
+        mtx_init(&reader->lock, mtx_plain);
+
+        // Init chunks select statement
+        if (sqlite3_prepare_v2(reader->database, "SELECT [data] FROM [chunks] WHERE [key] = ?", -1, &reader->chunks_select_statement, NULL) != SQLITE_OK) {
+            log_error("Can't create chunks select statement");
+        }
+    }
+    database->readers_index = 0;
+
+    // Init chunks upsert statement
+    if (sqlite3_prepare_v2(database->database, "INSERT INTO [chunks] ([key], [data]) VALUES (?, ?) "
+        "ON CONFLICT ([key]) DO UPDATE SET [data] = [excluded].[data]", -1, &database->chunks_upsert_statement, NULL) != SQLITE_OK) {
+        log_error("Can't create chunks upsert statement");
+    }
+
+    // Init chunks select all statement
+    if (sqlite3_prepare_v2(database->database, "SELECT [key], [data] FROM [chunks]", -1, &database->chunks_select_all_statement, NULL) != SQLITE_OK) {
+        log_error("Can't create chunks select all statement");
+    }
+
+    // Begin database transaction
+    if (sqlite3_exec(database->database, "BEGIN", NULL, NULL, &error_message) != SQLITE_OK) {
+        log_error("Can't begin database transaction:\n%s", error_message);
+    }
+
+    return database;
+}
+
+char* database_sqlite_get_setting(void* backend, char* key) {
+    DatabaseSqlite* database = backend;
+    mtx_lock(&database->database_lock);
+
+    char* value;
+
+    // Do a select setting query to find the setting
+    sqlite3_reset(database->settings_select_statement);
+    sqlite3_bind_text(database->settings_select_statement, 1, key, strlen(key), SQLITE_STATIC);
+    if (sqlite3_step(database->settings_select_statement) == SQLITE_ROW) {
+        const uint8_t* value_string = sqlite3_column_text(database->settings_select_statement, 0);
+        value = string_copy((char*)value_string);
+    } else {
+        value = NULL;
+    }
+
+    mtx_unlock(&database->database_lock);
+
+    return value;
+}
+
+void database_sqlite_set_setting(void* backend, char* key, char* value) {
+    DatabaseSqlite* database = backend;
+    mtx_lock(&database->database_lock);
+
+    sqlite3_reset(database->settings_select_statement);
+    sqlite3_bind_text(database->settings_select_statement, 1, key, strlen(key), SQLITE_STATIC);
+    int result = sqlite3_step(database->settings_select_statement);
+
+    // If the settings exists update it in the database
+    if (result == SQLITE_ROW) {
+        sqlite3_reset(database->settings_update_statement);
+        sqlite3_bind_text(database->settings_update_statement, 1, value, strlen(value), SQLITE_STATIC);
+        sqlite3_bind_text(database->settings_update_statement, 2, key, strlen(key), SQLITE_STATIC);
+        if (sqlite3_step(database->settings_update_statement) != SQLITE_DONE) {
+            log_error("Can't update setting %s in database", key);
+        }
+    }
+
+    // Else insert it into the database
+    else {
+        sqlite3_reset(database->settings_insert_statement);
+        sqlite3_bind_text(database->settings_insert_statement, 1, key, strlen(key), SQLITE_STATIC);
+        sqlite3_bind_text(database->settings_insert_statement, 2, value, strlen(value), SQLITE_STATIC);
+        if (sqlite3_step(database->settings_insert_statement) != SQLITE_DONE) {
+            log_error("Can't insert setting %s into database", key);
+        }
+    }
+
+    mtx_unlock(&database->database_lock);
+
+    database_sqlite_check_commit(database);
+}
+
+// Lock a free reader connection, when all readers are busy wait for the next one in turn
+DatabaseSqliteReader* database_sqlite_lock_reader(DatabaseSqlite* database) {
+    unsigned int readers_index = __atomic_fetch_add(&database->readers_index, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < DATABASE_READERS_COUNT; i++) {
+        DatabaseSqliteReader* reader = &database->readers[(readers_index + i) % DATABASE_READERS_COUNT];
+        if (mtx_trylock(&reader->lock) == thrd_success) {
+            return reader;
+        }
+    }
+    DatabaseSqliteReader* reader = &database->readers[readers_index % DATABASE_READERS_COUNT];
+    mtx_lock(&reader->lock);
+    return reader;
+}
+
+bool database_sqlite_get_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data) {
+    DatabaseSqliteReader* reader = database_sqlite_lock_reader(backend);
+
+    // Do a select query to select the chunk from the database, the statement is reset
+    // right after it so the read transaction ends and does not hold back checkpoints
+    bool is_found = false;
+    sqlite3_bind_int64(reader->chunks_select_statement, 1, database_get_chunk_key(chunk_x, chunk_y, chunk_z));
+    if (sqlite3_step(reader->chunks_select_statement) == SQLITE_ROW) {
+        const uint8_t* compressed_data = sqlite3_column_blob(reader->chunks_select_statement, 0);
+        is_found = chunk_codec_decode((uint8_t*)compressed_data, sqlite3_column_bytes(reader->chunks_select_statement, 0), chunk_data);
+        if (!is_found) {
+            log_warning("Can't decode chunk %d %d %d, it will be generated again", chunk_x, chunk_y, chunk_z);
+        }
+    }
+    sqlite3_reset(reader->chunks_select_statement);
+
+    mtx_unlock(&reader->lock);
+
+    return is_found;
+}
+
+// Upsert one chunk, only call this when holding the database lock
+void database_sqlite_upsert_chunk(DatabaseSqlite* database, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size) {
+    sqlite3_reset(database->chunks_upsert_statement);
+    sqlite3_bind_int64(database->chunks_upsert_statement, 1, database_get_chunk_key(chunk_x, chunk_y, chunk_z));
+    sqlite3_bind_blob(database->chunks_upsert_statement, 2, compressed_data, compressed_size, SQLITE_STATIC);
+    if (sqlite3_step(database->chunks_upsert_statement) != SQLITE_DONE) {
+        log_error("Can't upsert chunk into database");
+    }
+}
+
+void database_sqlite_put_chunk(void* backend, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size) {
+    DatabaseSqlite* database = backend;
+    mtx_lock(&database->database_lock);
+    database_sqlite_upsert_chunk(database, chunk_x, chunk_y, chunk_z, compressed_data, compressed_size);
+    mtx_unlock(&database->database_lock);
+
+    database_sqlite_check_commit(database);
+}
+
+// Upsert all chunks in one transaction, the readers see them after the commit
+void database_sqlite_put_chunks(void* backend, DatabaseChunkWrite* writes, int writes_count) {
+    DatabaseSqlite* database = backend;
+    mtx_lock(&database->database_lock);
+    for (int i = 0; i < writes_count; i++) {
+        database_sqlite_upsert_chunk(database, writes[i].x, writes[i].y, writes[i].z, writes[i].compressed_data, writes[i].compressed_size);
+    }
+    mtx_unlock(&database->database_lock);
+
+    database_sqlite_commit(database);
+}
+
+void database_sqlite_iterate_chunks(void* backend, DatabaseChunkCallback callback, void* argument) {
+    DatabaseSqlite* database = backend;
+    mtx_lock(&database->database_lock);
+    sqlite3_reset(database->chunks_select_all_statement);
+    while (sqlite3_step(database->chunks_select_all_statement) == SQLITE_ROW) {
+        int chunk_x, chunk_y, chunk_z;
+        database_get_chunk_position(sqlite3_column_int64(database->chunks_select_all_statement, 0), &chunk_x, &chunk_y, &chunk_z);
+        callback(argument, chunk_x, chunk_y, chunk_z,
+            (uint8_t*)sqlite3_column_blob(database->chunks_select_all_statement, 1),
+            sqlite3_column_bytes(database->chunks_select_all_statement, 1));
+    }
+    sqlite3_reset(database->chunks_select_all_statement);
+    mtx_unlock(&database->database_lock);
+}
+
+void database_sqlite_commit(DatabaseSqlite* database) {
+    mtx_lock(&database->database_lock);
+
+    // Commit pending database transaction and start a new own
+    database->database_changes = 0;
+    char *error_message = NULL;
+    if (sqlite3_exec(database->database, "COMMIT;BEGIN", NULL, NULL, &error_message) != SQLITE_OK) {
+        log_error("Can't commit database transaction:\n%s", error_message);
+    }
+
+    mtx_unlock(&database->database_lock);
+}
+
+void database_sqlite_check_commit(DatabaseSqlite* database) {
+    // Check if the changes counter is at the commit rate then reset and commit
+    mtx_lock(&database->database_lock);
+    bool is_commit = false;
+    if (database->database_changes >= DATABASE_COMMIT_RATE) {
+        database->database_changes = 0;
+        is_commit = true;
+    } else {
+        database->database_changes++;
+    }
+    mtx_unlock(&database->database_lock);
+
+    if (is_commit) {
+        database_sqlite_commit(database);
+    }
+}
+
+void database_sqlite_flush(void* backend) {
+    database_sqlite_commit(backend);
+}
+
+void database_sqlite_close(void* backend) {
+    DatabaseSqlite* database = backend;
+
+    // Commit pending transactions
+    database_sqlite_commit(database);
+
+    // Free statements
+    sqlite3_finalize(database->settings_select_statement);
+    sqlite3_finalize(database->settings_insert_statement);
+    sqlite3_finalize(database->settings_update_statement);
+
+    sqlite3_finalize(database->chunks_upsert_statement);
+    sqlite3_finalize(database->chunks_select_all_statement);
+
+    // Close the reader connections
+    for (int i = 0; i < DATABASE_READERS_COUNT; i++) {
+        sqlite3_finalize(database->readers[i].chunks_select_statement);
+        sqlite3_close(database->readers[i].database);
+        mtx_destroy(&database->readers[i].lock);
+    }
+
+    // Close database connection
+    sqlite3_close(database->database);
+
+    // Free database mutex lock
+    mtx_destroy(&database->database_lock);
+
+    // Free database object
+    free(database);
+}
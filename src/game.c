@@ -229,6 +229,7 @@ Game* game_new(char* title, int width, int height) {
 
     // Load shaders
     game->block_shader = block_shader_new();
+    game->chunk_shader = chunk_shader_new();
     game->flat_shader = flat_shader_new();
 
     // Load textures
@@ -284,7 +285,7 @@ void game_render(Game* game, float delta) {
 
     // Render world
     glEnable(GL_DEPTH_TEST);
-    int rendered_chunks = world_render(game->world, game->camera, game->block_shader, game->blocks_texture_atlas);
+    int rendered_chunks = world_render(game->world, game->camera, game->chunk_shader, game->blocks_texture_atlas);
 
     // Render select block outline
     Matrix4 model_matrix;
@@ -345,7 +346,7 @@ void game_render(Game* game, float delta) {
         Color text_color = { 17, 17, 17, 255 };
         if (game->is_debugged) {
             // Generate debug label
-            #define DEBUG_LINES_COUNT 4
+            #define DEBUG_LINES_COUNT 8
             char debug_lines[DEBUG_LINES_COUNT][128];
 
             sprintf(
@@ -381,9 +382,53 @@ void game_render(Game* game, float delta) {
                 delta
             );
 
+            sprintf(
+                debug_lines[3],
+                "Workers: %d - Cached chunks: %d - Queued requests: %d - Cancelled requests: %d - Wasted generations: %d",
+                game->world->workers_count,
+                game->world->chunk_cache_size,
+                __atomic_load_n(&game->world->pending_requests_count, __ATOMIC_RELAXED),
+                __atomic_load_n(&game->world->cancelled_requests_count, __ATOMIC_RELAXED),
+                __atomic_load_n(&game->world->wasted_generations_count, __ATOMIC_RELAXED)
+            );
+
+            int column_cache_hits = __atomic_load_n(&game->world->column_cache->hits_count, __ATOMIC_RELAXED);
+            int column_cache_misses = __atomic_load_n(&game->world->column_cache->misses_count, __ATOMIC_RELAXED);
+            sprintf(
+                debug_lines[4],
+                "Column cache: %d hits - %d misses - %.01f%% hit rate - %d KB",
+                column_cache_hits, column_cache_misses,
+                column_cache_hits + column_cache_misses > 0 ? column_cache_hits * 100.0 / (column_cache_hits + column_cache_misses) : 0.0,
+                (int)(column_cache_get_memory_size(game->world->column_cache) / 1024)
+            );
+
+            size_t slabs_memory_size = slab_get_memory_size(chunk_slab) + slab_get_memory_size(chunk_faces_slab) + slab_get_memory_size(chunk_storage_slab);
+            int storage_indices_used_count = 0;
+            for (int i = 0; i < CHUNK_STORAGE_BITS_COUNT; i++) {
+                slabs_memory_size += slab_get_memory_size(chunk_storage_indices_slabs[i]);
+                storage_indices_used_count += __atomic_load_n(&chunk_storage_indices_slabs[i]->used_count, __ATOMIC_RELAXED);
+            }
+            sprintf(
+                debug_lines[5],
+                "Slabs: %d chunks - %d faces - %d storages - %d storage indices - %d KB",
+                __atomic_load_n(&chunk_slab->used_count, __ATOMIC_RELAXED),
+                __atomic_load_n(&chunk_faces_slab->used_count, __ATOMIC_RELAXED),
+                __atomic_load_n(&chunk_storage_slab->used_count, __ATOMIC_RELAXED),
+                storage_indices_used_count,
+                (int)(slabs_memory_size / 1024)
+            );
+
+            sprintf(
+                debug_lines[6],
+                "Database: %d buffered writes - %d flushes - %d flushed writes",
+                __atomic_load_n(&game->world->database->writes_count, __ATOMIC_RELAXED),
+                __atomic_load_n(&game->world->database->flushes_count, __ATOMIC_RELAXED),
+                __atomic_load_n(&game->world->database->flushed_writes_count, __ATOMIC_RELAXED)
+            );
+
             if (game->selected_block != NULL) {
                 sprintf(
-                    debug_lines[3],
+                    debug_lines[7],
                     "Selected block: %d %d %d chunk, %d %d %d block, %s face",
                     game->selected_block->chunk_x,
                     game->selected_block->chunk_y,
@@ -395,7 +440,7 @@ void game_render(Game* game, float delta) {
                 );
             } else {
                 sprintf(
-                    debug_lines[3],
+                    debug_lines[7],
                     "Selected block: none"
                 );
             }
@@ -643,6 +688,7 @@ void game_free(Game* game) {
     // Free shaders
     flat_shader_free(game->flat_shader);
     block_shader_free(game->block_shader);
+    chunk_shader_free(game->chunk_shader);
 
     // Free fonts
     font_free(game->text_font);
@@ -0,0 +1,113 @@
+// PlaatCraft - Chunk Mesh Geometry
+
+#include "geometry/chunk_mesh.h"
+#include <stdlib.h>
+
+// The offset of the face vertices in the block vertices for each block side
+int CHUNK_MESH_BLOCK_SIDE_FACES[BLOCK_SIDE_SIZE] = {
+    2, // Left
+    3, // Right
+    0, // Above
+    1, // Below
+    5, // Front
+    4  // Back
+};
+
+ChunkMesh* chunk_mesh_new(void) {
+    ChunkMesh* chunk_mesh = malloc(sizeof(ChunkMesh));
+    chunk_mesh->vertices = NULL;
+    chunk_mesh->vertices_count = 0;
+    chunk_mesh->vertices_capacity = 0;
+    chunk_mesh->is_changed = false;
+
+    chunk_mesh->vertex_array = 0;
+    chunk_mesh->vertex_buffer = 0;
+    chunk_mesh->uploaded_vertices_count = 0;
+    return chunk_mesh;
+}
+
+void chunk_mesh_clear(ChunkMesh* chunk_mesh) {
+    chunk_mesh->vertices_count = 0;
+    chunk_mesh->is_changed = true;
+}
+
+// Add a block face in world block coordinates, the vertices are baked like the old block model matrix
+void chunk_mesh_add_face(ChunkMesh* chunk_mesh, int x, int y, int z, BlockSide block_side, BlockType block_type) {
+    if (chunk_mesh->vertices_count + CHUNK_MESH_FACE_VERTICES_COUNT > chunk_mesh->vertices_capacity) {
+        chunk_mesh->vertices_capacity = chunk_mesh->vertices_capacity == 0 ? 64 * CHUNK_MESH_FACE_VERTICES_COUNT : chunk_mesh->vertices_capacity * 2;
+        chunk_mesh->vertices = realloc(chunk_mesh->vertices, chunk_mesh->vertices_capacity * CHUNK_MESH_VERTEX_SIZE * sizeof(float));
+    }
+
+    float* face_vertices = &BLOCK_VERTICES[CHUNK_MESH_BLOCK_SIDE_FACES[block_side] * CHUNK_MESH_FACE_VERTICES_COUNT * 6];
+    float* vertices = &chunk_mesh->vertices[chunk_mesh->vertices_count * CHUNK_MESH_VERTEX_SIZE];
+    for (int i = 0; i < CHUNK_MESH_FACE_VERTICES_COUNT; i++) {
+        float* face_vertex = &face_vertices[i * 6];
+        int texture_face = face_vertex[5];
+
+        // Rotate 90 degrees around the x axis and translate to the block position
+        vertices[0] = x + face_vertex[0];
+        vertices[1] = y - face_vertex[2];
+        vertices[2] = -z + face_vertex[1];
+        vertices[3] = face_vertex[3];
+        vertices[4] = face_vertex[4];
+        vertices[5] = texture_face;
+        vertices[6] = BLOCK_TYPE_TEXTURE_FACES[block_type][texture_face - 1];
+        vertices += CHUNK_MESH_VERTEX_SIZE;
+    }
+    chunk_mesh->vertices_count += CHUNK_MESH_FACE_VERTICES_COUNT;
+}
+
+// Upload the builded vertices to the GPU, only call this on the OpenGL thread
+void chunk_mesh_upload(ChunkMesh* chunk_mesh) {
+    if (chunk_mesh->vertex_array == 0) {
+        glGenVertexArrays(1, &chunk_mesh->vertex_array);
+        chunk_mesh_enable(chunk_mesh);
+
+        glGenBuffers(1, &chunk_mesh->vertex_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk_mesh->vertex_buffer);
+
+        // The attribute locations match the layout locations in assets/shaders/chunk.vert
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, CHUNK_MESH_VERTEX_SIZE * sizeof(float), 0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, CHUNK_MESH_VERTEX_SIZE * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, CHUNK_MESH_VERTEX_SIZE * sizeof(float), (void*)(5 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, CHUNK_MESH_VERTEX_SIZE * sizeof(float), (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(3);
+    } else {
+        chunk_mesh_enable(chunk_mesh);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk_mesh->vertex_buffer);
+    }
+
+    glBufferData(GL_ARRAY_BUFFER, chunk_mesh->vertices_count * CHUNK_MESH_VERTEX_SIZE * sizeof(float), chunk_mesh->vertices, GL_STATIC_DRAW);
+    chunk_mesh->uploaded_vertices_count = chunk_mesh->vertices_count;
+
+    chunk_mesh_disable(chunk_mesh);
+
+    // Free the CPU side vertices they are on the GPU now
+    free(chunk_mesh->vertices);
+    chunk_mesh->vertices = NULL;
+    chunk_mesh->vertices_count = 0;
+    chunk_mesh->vertices_capacity = 0;
+    chunk_mesh->is_changed = false;
+}
+
+void chunk_mesh_enable(ChunkMesh* chunk_mesh) {
+    glBindVertexArray(chunk_mesh->vertex_array);
+}
+
+void chunk_mesh_disable(ChunkMesh* chunk_mesh) {
+    (void)chunk_mesh;
+    glBindVertexArray(0);
+}
+
+// Free the chunk mesh, only call this on the OpenGL thread
+void chunk_mesh_free(ChunkMesh* chunk_mesh) {
+    if (chunk_mesh->vertex_array != 0) {
+        glDeleteVertexArrays(1, &chunk_mesh->vertex_array);
+        glDeleteBuffers(1, &chunk_mesh->vertex_buffer);
+    }
+    free(chunk_mesh->vertices);
+    free(chunk_mesh);
+}
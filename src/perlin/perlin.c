@@ -2,11 +2,11 @@
 // Adapted from: https://mrl.cs.nyu.edu/~perlin/noise/
 
 #include "perlin/perlin.h"
+#include <stdlib.h>
 #include <math.h>
-
-int64_t perlin_seed;
-
-int perlin_p[512];
+#ifndef NO_SIMD
+    #include <immintrin.h>
+#endif
 
 int perlin_permutation[256] = {
     151,160,137,91,90,15,
@@ -24,12 +24,36 @@ int perlin_permutation[256] = {
     138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180
 };
 
-void perlin_init(int64_t seed) {
-    perlin_seed = seed;
+// When the permutation is seeded it is shuffled with a splitmix64 stream of the seed,
+// otherwise the seed only shifts the coordinates like the first worlds did
+PerlinNoise* perlin_new(int64_t seed, bool is_permutation_seeded) {
+    PerlinNoise* perlin = malloc(sizeof(PerlinNoise));
+    perlin->seed = seed;
+
+    int permutation[256];
+    for (int i = 0; i < 256; i++) {
+        permutation[i] = perlin_permutation[i];
+    }
+
+    if (is_permutation_seeded) {
+        uint64_t state = (uint64_t)seed;
+        for (int i = 255; i > 0; i--) {
+            uint64_t random = (state += 0x9E3779B97F4A7C15);
+            random = (random ^ (random >> 30)) * 0xBF58476D1CE4E5B9;
+            random = (random ^ (random >> 27)) * 0x94D049BB133111EB;
+            random ^= random >> 31;
+
+            int j = random % (i + 1);
+            int swap = permutation[i];
+            permutation[i] = permutation[j];
+            permutation[j] = swap;
+        }
+    }
 
     for (int i = 0; i < 256 ; i++) {
-        perlin_p[256 + i] = perlin_p[i] = perlin_permutation[i];
+        perlin->p[256 + i] = perlin->p[i] = permutation[i];
     }
+    return perlin;
 }
 
 double perlin_fade(double t) {
@@ -47,11 +71,13 @@ double perlin_grad(int hash, double x, double y, double z) {
     return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 }
 
-double perlin_noise(double x, double y, double z) {
+double perlin_noise(PerlinNoise* perlin, double x, double y, double z) {
+    int* perlin_p = perlin->p;
+
     // Add seed to position
-    x += perlin_seed;
-    y += perlin_seed;
-    z -= perlin_seed;
+    x += perlin->seed;
+    y += perlin->seed;
+    z -= perlin->seed;
 
     // Do perlin stuff
     int X = (int)floor(x) & 255,                  // FIND UNIT CUBE THAT
@@ -78,3 +104,198 @@ double perlin_noise(double x, double y, double z) {
                              perlin_lerp(u, perlin_grad(perlin_p[AB+1], x  , y-1, z-1 ),
                                      perlin_grad(perlin_p[BB+1], x-1, y-1, z-1 ))));
 }
+
+// The x, y and z factors of the 16 perlin_grad directions for the SIMD paths
+double perlin_gradients[16 * 3] = {
+    1, 1, 0,   -1, 1, 0,   1, -1, 0,   -1, -1, 0,
+    1, 0, 1,   -1, 0, 1,   1, 0, -1,   -1, 0, -1,
+    0, 1, 1,   0, -1, 1,   0, 1, -1,   0, -1, -1,
+    1, 1, 0,   0, -1, 1,   -1, 1, 0,   0, -1, -1
+};
+
+// Evaluate the noise of a batch of points, the SIMD paths do the same double operations in the same order
+// as perlin_noise so the generated worlds stay exactly the same. Only the zero noise of a point on the lattice
+// can be positive where perlin_noise gives negative zero because the gradients also add the zero directions
+void perlin_noise_batch(PerlinNoise* perlin, double* x, double* y, double* z, double* noises, int count) {
+    #ifndef NO_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+            perlin_noise_batch_avx2(perlin, x, y, z, noises, count);
+        } else {
+            perlin_noise_batch_sse2(perlin, x, y, z, noises, count);
+        }
+    #else
+        for (int i = 0; i < count; i++) {
+            noises[i] = perlin_noise(perlin, x[i], y[i], z[i]);
+        }
+    #endif
+}
+
+#ifndef NO_SIMD
+    __m128d perlin_fade_sse2(__m128d t) {
+        __m128d t3 = _mm_mul_pd(_mm_mul_pd(t, t), t);
+        return _mm_mul_pd(t3, _mm_add_pd(_mm_mul_pd(t, _mm_sub_pd(_mm_mul_pd(t, _mm_set1_pd(6)), _mm_set1_pd(15))), _mm_set1_pd(10)));
+    }
+
+    __m128d perlin_lerp_sse2(__m128d t, __m128d a, __m128d b) {
+        return _mm_add_pd(a, _mm_mul_pd(t, _mm_sub_pd(b, a)));
+    }
+
+    // SSE2 has no floor so truncate and correct the negative numbers, the positions fit in 32 bits
+    __m128d perlin_floor_sse2(__m128d a) {
+        __m128d truncated = _mm_cvtepi32_pd(_mm_cvttpd_epi32(a));
+        return _mm_sub_pd(truncated, _mm_and_pd(_mm_cmpgt_pd(truncated, a), _mm_set1_pd(1)));
+    }
+
+    // Two points at once, the hashing is done per point
+    void perlin_noise_batch_sse2(PerlinNoise* perlin, double* x, double* y, double* z, double* noises, int count) {
+        int* perlin_p = perlin->p;
+        __m128d seed = _mm_set1_pd((double)perlin->seed);
+        __m128d one = _mm_set1_pd(1);
+
+        int i = 0;
+        for (; i + 2 <= count; i += 2) {
+            __m128d px = _mm_add_pd(_mm_loadu_pd(&x[i]), seed);
+            __m128d py = _mm_add_pd(_mm_loadu_pd(&y[i]), seed);
+            __m128d pz = _mm_sub_pd(_mm_loadu_pd(&z[i]), seed);
+
+            __m128d floor_x = perlin_floor_sse2(px);
+            __m128d floor_y = perlin_floor_sse2(py);
+            __m128d floor_z = perlin_floor_sse2(pz);
+            int cube[3][4];
+            _mm_storeu_si128((__m128i*)cube[0], _mm_cvttpd_epi32(floor_x));
+            _mm_storeu_si128((__m128i*)cube[1], _mm_cvttpd_epi32(floor_y));
+            _mm_storeu_si128((__m128i*)cube[2], _mm_cvttpd_epi32(floor_z));
+
+            px = _mm_sub_pd(px, floor_x);
+            py = _mm_sub_pd(py, floor_y);
+            pz = _mm_sub_pd(pz, floor_z);
+            __m128d u = perlin_fade_sse2(px);
+            __m128d v = perlin_fade_sse2(py);
+            __m128d w = perlin_fade_sse2(pz);
+
+            // Hash the 8 cube corners of both points
+            double* gradients[8][2];
+            for (int j = 0; j < 2; j++) {
+                int X = cube[0][j] & 255, Y = cube[1][j] & 255, Z = cube[2][j] & 255;
+                int A = perlin_p[X]+Y, AA = perlin_p[A]+Z, AB = perlin_p[A+1]+Z,
+                    B = perlin_p[X+1]+Y, BA = perlin_p[B]+Z, BB = perlin_p[B+1]+Z;
+                gradients[0][j] = &perlin_gradients[(perlin_p[AA] & 15) * 3];
+                gradients[1][j] = &perlin_gradients[(perlin_p[BA] & 15) * 3];
+                gradients[2][j] = &perlin_gradients[(perlin_p[AB] & 15) * 3];
+                gradients[3][j] = &perlin_gradients[(perlin_p[BB] & 15) * 3];
+                gradients[4][j] = &perlin_gradients[(perlin_p[AA+1] & 15) * 3];
+                gradients[5][j] = &perlin_gradients[(perlin_p[BA+1] & 15) * 3];
+                gradients[6][j] = &perlin_gradients[(perlin_p[AB+1] & 15) * 3];
+                gradients[7][j] = &perlin_gradients[(perlin_p[BB+1] & 15) * 3];
+            }
+
+            // The gradient of each corner is the dot product with its direction factors
+            __m128d grads[8];
+            for (int corner = 0; corner < 8; corner++) {
+                double** g = gradients[corner];
+                __m128d cx = (corner & 1) != 0 ? _mm_sub_pd(px, one) : px;
+                __m128d cy = (corner & 2) != 0 ? _mm_sub_pd(py, one) : py;
+                __m128d cz = (corner & 4) != 0 ? _mm_sub_pd(pz, one) : pz;
+                grads[corner] = _mm_add_pd(
+                    _mm_add_pd(
+                        _mm_mul_pd(_mm_set_pd(g[1][0], g[0][0]), cx),
+                        _mm_mul_pd(_mm_set_pd(g[1][1], g[0][1]), cy)
+                    ),
+                    _mm_mul_pd(_mm_set_pd(g[1][2], g[0][2]), cz)
+                );
+            }
+
+            _mm_storeu_pd(&noises[i], perlin_lerp_sse2(w,
+                perlin_lerp_sse2(v, perlin_lerp_sse2(u, grads[0], grads[1]), perlin_lerp_sse2(u, grads[2], grads[3])),
+                perlin_lerp_sse2(v, perlin_lerp_sse2(u, grads[4], grads[5]), perlin_lerp_sse2(u, grads[6], grads[7]))
+            ));
+        }
+
+        for (; i < count; i++) {
+            noises[i] = perlin_noise(perlin, x[i], y[i], z[i]);
+        }
+    }
+
+    __attribute__((target("avx2"))) __m256d perlin_fade_avx2(__m256d t) {
+        __m256d t3 = _mm256_mul_pd(_mm256_mul_pd(t, t), t);
+        return _mm256_mul_pd(t3, _mm256_add_pd(_mm256_mul_pd(t, _mm256_sub_pd(_mm256_mul_pd(t, _mm256_set1_pd(6)), _mm256_set1_pd(15))), _mm256_set1_pd(10)));
+    }
+
+    __attribute__((target("avx2"))) __m256d perlin_lerp_avx2(__m256d t, __m256d a, __m256d b) {
+        return _mm256_add_pd(a, _mm256_mul_pd(t, _mm256_sub_pd(b, a)));
+    }
+
+    // Four points at once, the hashing is done per point because gathers are slower
+    __attribute__((target("avx2"))) void perlin_noise_batch_avx2(PerlinNoise* perlin, double* x, double* y, double* z, double* noises, int count) {
+        int* perlin_p = perlin->p;
+        __m256d seed = _mm256_set1_pd((double)perlin->seed);
+        __m256d one = _mm256_set1_pd(1);
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256d px = _mm256_add_pd(_mm256_loadu_pd(&x[i]), seed);
+            __m256d py = _mm256_add_pd(_mm256_loadu_pd(&y[i]), seed);
+            __m256d pz = _mm256_sub_pd(_mm256_loadu_pd(&z[i]), seed);
+
+            __m256d floor_x = _mm256_floor_pd(px);
+            __m256d floor_y = _mm256_floor_pd(py);
+            __m256d floor_z = _mm256_floor_pd(pz);
+            int cube[3][4];
+            _mm_storeu_si128((__m128i*)cube[0], _mm256_cvttpd_epi32(floor_x));
+            _mm_storeu_si128((__m128i*)cube[1], _mm256_cvttpd_epi32(floor_y));
+            _mm_storeu_si128((__m128i*)cube[2], _mm256_cvttpd_epi32(floor_z));
+
+            px = _mm256_sub_pd(px, floor_x);
+            py = _mm256_sub_pd(py, floor_y);
+            pz = _mm256_sub_pd(pz, floor_z);
+            __m256d u = perlin_fade_avx2(px);
+            __m256d v = perlin_fade_avx2(py);
+            __m256d w = perlin_fade_avx2(pz);
+
+            // Hash the 8 cube corners of all points
+            double* gradients[8][4];
+            for (int j = 0; j < 4; j++) {
+                int X = cube[0][j] & 255, Y = cube[1][j] & 255, Z = cube[2][j] & 255;
+                int A = perlin_p[X]+Y, AA = perlin_p[A]+Z, AB = perlin_p[A+1]+Z,
+                    B = perlin_p[X+1]+Y, BA = perlin_p[B]+Z, BB = perlin_p[B+1]+Z;
+                gradients[0][j] = &perlin_gradients[(perlin_p[AA] & 15) * 3];
+                gradients[1][j] = &perlin_gradients[(perlin_p[BA] & 15) * 3];
+                gradients[2][j] = &perlin_gradients[(perlin_p[AB] & 15) * 3];
+                gradients[3][j] = &perlin_gradients[(perlin_p[BB] & 15) * 3];
+                gradients[4][j] = &perlin_gradients[(perlin_p[AA+1] & 15) * 3];
+                gradients[5][j] = &perlin_gradients[(perlin_p[BA+1] & 15) * 3];
+                gradients[6][j] = &perlin_gradients[(perlin_p[AB+1] & 15) * 3];
+                gradients[7][j] = &perlin_gradients[(perlin_p[BB+1] & 15) * 3];
+            }
+
+            // The gradient of each corner is the dot product with its direction factors
+            __m256d grads[8];
+            for (int corner = 0; corner < 8; corner++) {
+                double** g = gradients[corner];
+                __m256d cx = (corner & 1) != 0 ? _mm256_sub_pd(px, one) : px;
+                __m256d cy = (corner & 2) != 0 ? _mm256_sub_pd(py, one) : py;
+                __m256d cz = (corner & 4) != 0 ? _mm256_sub_pd(pz, one) : pz;
+                grads[corner] = _mm256_add_pd(
+                    _mm256_add_pd(
+                        _mm256_mul_pd(_mm256_set_pd(g[3][0], g[2][0], g[1][0], g[0][0]), cx),
+                        _mm256_mul_pd(_mm256_set_pd(g[3][1], g[2][1], g[1][1], g[0][1]), cy)
+                    ),
+                    _mm256_mul_pd(_mm256_set_pd(g[3][2], g[2][2], g[1][2], g[0][2]), cz)
+                );
+            }
+
+            _mm256_storeu_pd(&noises[i], perlin_lerp_avx2(w,
+                perlin_lerp_avx2(v, perlin_lerp_avx2(u, grads[0], grads[1]), perlin_lerp_avx2(u, grads[2], grads[3])),
+                perlin_lerp_avx2(v, perlin_lerp_avx2(u, grads[4], grads[5]), perlin_lerp_avx2(u, grads[6], grads[7]))
+            ));
+        }
+
+        for (; i < count; i++) {
+            noises[i] = perlin_noise(perlin, x[i], y[i], z[i]);
+        }
+    }
+#endif
+
+void perlin_free(PerlinNoise* perlin) {
+    free(perlin);
+}
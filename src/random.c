@@ -7,10 +7,44 @@
 Random* random_new(int64_t seed) {
     Random* random = malloc(sizeof(Random));
     random->seed = seed;
+    random->is_counter_based = false;
+    random->key = 0;
+    random->counter = 0;
     return random;
 }
 
+// A counter based random only hashes the key and the counter so every stream can be computed on its own
+Random* random_new_counter_based(int64_t seed) {
+    Random* random = random_new(seed);
+    random->is_counter_based = true;
+    random_seek(random, 0, 0, 0);
+    return random;
+}
+
+// The splitmix64 finalizer
+uint64_t random_mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+    return x ^ (x >> 31);
+}
+
+// Key the stream on the seed and a block position, the old sin random has only one stream so it ignores this
+void random_seek(Random* random, int x, int y, int z) {
+    if (random->is_counter_based) {
+        uint64_t key = random_mix((uint64_t)random->seed + 0x9E3779B97F4A7C15);
+        key = random_mix(key ^ (uint32_t)x);
+        key = random_mix(key ^ ((uint64_t)(uint32_t)y << 32));
+        random->key = random_mix(key ^ (uint32_t)z);
+        random->counter = 0;
+    }
+}
+
 double random_random(Random* random) {
+    if (random->is_counter_based) {
+        uint64_t x = random_mix(random->key + ++random->counter * 0x9E3779B97F4A7C15);
+        return (x >> 11) * (1.0 / 9007199254740992.0);
+    }
+
     double x = sin(random->seed++) * 10000;
     return x - floor(x);
 }
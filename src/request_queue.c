@@ -0,0 +1,78 @@
+// PlaatCraft - Request Queue
+
+#include "request_queue.h"
+#include <stdlib.h>
+#include "log.h"
+
+// Create a request queue, the capacity must be a power of two
+RequestQueue* request_queue_new(int capacity) {
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+        log_error("Request queue capacity %d is not a power of two", capacity);
+    }
+
+    RequestQueue* request_queue = malloc(sizeof(RequestQueue));
+    request_queue->cells = malloc(capacity * sizeof(RequestQueueCell));
+    for (int i = 0; i < capacity; i++) {
+        request_queue->cells[i].sequence = i;
+        request_queue->cells[i].item = NULL;
+    }
+    request_queue->mask = capacity - 1;
+    request_queue->enqueue_position = 0;
+    request_queue->dequeue_position = 0;
+    return request_queue;
+}
+
+// Push an item to the back of the queue, returns false when the queue is full
+bool request_queue_push(RequestQueue* request_queue, void* item) {
+    unsigned int position = __atomic_load_n(&request_queue->enqueue_position, __ATOMIC_RELAXED);
+    for (;;) {
+        RequestQueueCell* cell = &request_queue->cells[position & request_queue->mask];
+        unsigned int sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        int difference = (int)(sequence - position);
+
+        if (difference == 0) {
+            // The cell is free claim it by moving the enqueue position
+            if (__atomic_compare_exchange_n(&request_queue->enqueue_position, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->item = item;
+                __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (difference < 0) {
+            // The cell is not popped yet so the queue is full
+            return false;
+        } else {
+            // An other producer was faster try again
+            position = __atomic_load_n(&request_queue->enqueue_position, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Pop an item from the front of the queue, returns NULL when the queue is empty
+void* request_queue_pop(RequestQueue* request_queue) {
+    unsigned int position = __atomic_load_n(&request_queue->dequeue_position, __ATOMIC_RELAXED);
+    for (;;) {
+        RequestQueueCell* cell = &request_queue->cells[position & request_queue->mask];
+        unsigned int sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        int difference = (int)(sequence - (position + 1));
+
+        if (difference == 0) {
+            // The cell is filled claim it by moving the dequeue position
+            if (__atomic_compare_exchange_n(&request_queue->dequeue_position, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                void* item = cell->item;
+                __atomic_store_n(&cell->sequence, position + request_queue->mask + 1, __ATOMIC_RELEASE);
+                return item;
+            }
+        } else if (difference < 0) {
+            // The cell is not pushed yet so the queue is empty
+            return NULL;
+        } else {
+            // An other consumer was faster try again
+            position = __atomic_load_n(&request_queue->dequeue_position, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void request_queue_free(RequestQueue* request_queue) {
+    free(request_queue->cells);
+    free(request_queue);
+}
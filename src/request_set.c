@@ -0,0 +1,123 @@
+// PlaatCraft - Request Set
+
+#include "request_set.h"
+#include <stdlib.h>
+#include "log.h"
+
+// Create a request set, the capacity must be a power of two and larger then the key count
+RequestSet* request_set_new(int capacity) {
+    if ((capacity & (capacity - 1)) != 0) {
+        log_error("Request set capacity %d is not a power of two", capacity);
+    }
+
+    RequestSet* request_set = malloc(sizeof(RequestSet));
+    request_set->keys = calloc(capacity, sizeof(uint64_t));
+    request_set->capacity = capacity;
+    request_set->sequence = 0;
+    mtx_init(&request_set->request_set_lock, mtx_plain);
+    return request_set;
+}
+
+int request_set_hash(RequestSet* request_set, uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccd;
+    key ^= key >> 33;
+    return key & (request_set->capacity - 1);
+}
+
+// Readers retry when a writer changed the set while they where probing (a sequence lock)
+bool request_set_contains(RequestSet* request_set, uint64_t key) {
+    int mask = request_set->capacity - 1;
+    for (;;) {
+        unsigned int sequence = __atomic_load_n(&request_set->sequence, __ATOMIC_ACQUIRE);
+        if ((sequence & 1) != 0) {
+            continue;
+        }
+
+        bool is_found = false;
+        int index = request_set_hash(request_set, key);
+        for (int i = 0; i < request_set->capacity; i++) {
+            uint64_t other_key = __atomic_load_n(&request_set->keys[index], __ATOMIC_RELAXED);
+            if (other_key == 0) {
+                break;
+            }
+            if (other_key == key) {
+                is_found = true;
+                break;
+            }
+            index = (index + 1) & mask;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&request_set->sequence, __ATOMIC_RELAXED) == sequence) {
+            return is_found;
+        }
+    }
+}
+
+// Add a key, returns false when the key is already in the set
+bool request_set_add(RequestSet* request_set, uint64_t key) {
+    mtx_lock(&request_set->request_set_lock);
+    int mask = request_set->capacity - 1;
+    int index = request_set_hash(request_set, key);
+    for (int i = 0; i < request_set->capacity; i++) {
+        uint64_t other_key = request_set->keys[index];
+        if (other_key == key) {
+            mtx_unlock(&request_set->request_set_lock);
+            return false;
+        }
+        if (other_key == 0) {
+            __atomic_store_n(&request_set->keys[index], key, __ATOMIC_RELEASE);
+            mtx_unlock(&request_set->request_set_lock);
+            return true;
+        }
+        index = (index + 1) & mask;
+    }
+    log_error("Request set is full");
+    return false;
+}
+
+// Remove a key and shift the following keys back so no tombstones are needed
+void request_set_remove(RequestSet* request_set, uint64_t key) {
+    mtx_lock(&request_set->request_set_lock);
+    int mask = request_set->capacity - 1;
+    int index = request_set_hash(request_set, key);
+    for (;;) {
+        uint64_t other_key = request_set->keys[index];
+        if (other_key == 0) {
+            mtx_unlock(&request_set->request_set_lock);
+            return;
+        }
+        if (other_key == key) {
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+
+    __atomic_store_n(&request_set->sequence, request_set->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    int empty_index = index;
+    for (;;) {
+        index = (index + 1) & mask;
+        uint64_t other_key = request_set->keys[index];
+        if (other_key == 0) {
+            break;
+        }
+
+        // Move the key to the empty slot when that slot is between its home slot and its current slot
+        int home_index = request_set_hash(request_set, other_key);
+        if (((index - home_index) & mask) >= ((index - empty_index) & mask)) {
+            __atomic_store_n(&request_set->keys[empty_index], other_key, __ATOMIC_RELAXED);
+            empty_index = index;
+        }
+    }
+    __atomic_store_n(&request_set->keys[empty_index], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&request_set->sequence, request_set->sequence + 1, __ATOMIC_RELEASE);
+    mtx_unlock(&request_set->request_set_lock);
+}
+
+void request_set_free(RequestSet* request_set) {
+    mtx_destroy(&request_set->request_set_lock);
+    free(request_set->keys);
+    free(request_set);
+}
@@ -0,0 +1,32 @@
+// PlaatCraft - Chunk Shader
+
+#include "shaders/chunk_shader.h"
+#include <stdlib.h>
+#include "utils.h"
+
+ChunkShader* chunk_shader_new(void) {
+    ChunkShader* chunk_shader = malloc(sizeof(ChunkShader));
+    chunk_shader->shader = shader_new("assets/shaders/chunk.vert", "assets/shaders/chunk.frag");
+
+    // The attributes are bound per chunk mesh via the layout locations
+
+    // Get uniforms
+    chunk_shader->view_matrix_uniform = glGetUniformLocation(chunk_shader->shader->program, "u_view_matrix");
+    chunk_shader->projection_matrix_uniform = glGetUniformLocation(chunk_shader->shader->program, "u_projection_matrix");
+    chunk_shader->is_flat_shaded_uniform = glGetUniformLocation(chunk_shader->shader->program, "u_is_flat_shaded");
+
+    return chunk_shader;
+}
+
+void chunk_shader_enable(ChunkShader* chunk_shader) {
+    shader_enable(chunk_shader->shader);
+}
+
+void chunk_shader_disable(ChunkShader* chunk_shader) {
+    (void)chunk_shader;
+}
+
+void chunk_shader_free(ChunkShader* chunk_shader) {
+    shader_free(chunk_shader->shader);
+    free(chunk_shader);
+}
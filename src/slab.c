@@ -0,0 +1,169 @@
+// PlaatCraft - Slab
+
+#include "slab.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "log.h"
+#ifdef __WIN32__
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+// The claimed thread caches and the thread cache index of this thread plus one, zero means no cache
+int slab_thread_caches_used[SLAB_THREAD_CACHES_COUNT];
+
+_Thread_local int slab_thread_cache_index;
+
+// Claim a free thread cache index for this thread, a thread that finds none uses the locked path
+void slab_thread_start(void) {
+    if (slab_thread_cache_index != 0) {
+        return;
+    }
+    for (int i = 0; i < SLAB_THREAD_CACHES_COUNT; i++) {
+        int is_used = 0;
+        if (__atomic_compare_exchange_n(&slab_thread_caches_used[i], &is_used, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            slab_thread_cache_index = i + 1;
+            return;
+        }
+    }
+}
+
+// Give the thread cache index back, the cached objects stay in the caches for the next thread
+void slab_thread_stop(void) {
+    if (slab_thread_cache_index != 0) {
+        __atomic_store_n(&slab_thread_caches_used[slab_thread_cache_index - 1], 0, __ATOMIC_RELEASE);
+        slab_thread_cache_index = 0;
+    }
+}
+
+// Create a slab, the object size is rounded up to 16 bytes so every object stays aligned
+Slab* slab_new(size_t object_size) {
+    object_size = (object_size + 15) & ~(size_t)15;
+    if (object_size > SLAB_REGION_SIZE) {
+        log_error("Slab object size %d is larger then the region size", (int)object_size);
+    }
+
+    Slab* slab = malloc(sizeof(Slab));
+    slab->object_size = object_size;
+    slab->region_objects_count = SLAB_REGION_SIZE / object_size;
+    mtx_init(&slab->lock, mtx_plain);
+    slab->free_objects = NULL;
+    slab->regions = NULL;
+    slab->regions_count = 0;
+    slab->regions_capacity = 0;
+    slab->used_count = 0;
+    slab->allocations_count = 0;
+    for (int i = 0; i < SLAB_THREAD_CACHES_COUNT; i++) {
+        slab->thread_caches[i].objects_count = 0;
+    }
+    return slab;
+}
+
+// Map a new region and link all its objects in the free objects, only call this when holding the slab lock
+void slab_add_region(Slab* slab) {
+    #ifdef __WIN32__
+        uint8_t* region = VirtualAlloc(NULL, SLAB_REGION_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (region == NULL) {
+            log_error("Can't map a slab region");
+        }
+    #else
+        uint8_t* region = mmap(NULL, SLAB_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            log_error("Can't map a slab region");
+        }
+    #endif
+
+    if (slab->regions_count == slab->regions_capacity) {
+        slab->regions_capacity = slab->regions_capacity == 0 ? 16 : slab->regions_capacity * 2;
+        slab->regions = realloc(slab->regions, slab->regions_capacity * sizeof(void*));
+    }
+    slab->regions[slab->regions_count++] = region;
+
+    for (int i = slab->region_objects_count - 1; i >= 0; i--) {
+        void** object = (void**)&region[i * slab->object_size];
+        *object = slab->free_objects;
+        slab->free_objects = object;
+    }
+}
+
+// Pop a free object, only call this when holding the slab lock
+void* slab_pop_object(Slab* slab) {
+    if (slab->free_objects == NULL) {
+        slab_add_region(slab);
+    }
+    void** object = slab->free_objects;
+    slab->free_objects = *object;
+    return object;
+}
+
+void* slab_allocate(Slab* slab) {
+    __atomic_add_fetch(&slab->used_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&slab->allocations_count, 1, __ATOMIC_RELAXED);
+
+    if (slab_thread_cache_index != 0) {
+        // Refill an empty thread cache with a batch of objects so the lock is taken only once in a while
+        SlabThreadCache* thread_cache = &slab->thread_caches[slab_thread_cache_index - 1];
+        if (thread_cache->objects_count == 0) {
+            mtx_lock(&slab->lock);
+            for (int i = 0; i < SLAB_THREAD_CACHE_BATCH_COUNT; i++) {
+                thread_cache->objects[thread_cache->objects_count++] = slab_pop_object(slab);
+            }
+            mtx_unlock(&slab->lock);
+        }
+        return thread_cache->objects[--thread_cache->objects_count];
+    }
+
+    mtx_lock(&slab->lock);
+    void* object = slab_pop_object(slab);
+    mtx_unlock(&slab->lock);
+    return object;
+}
+
+void slab_deallocate(Slab* slab, void* object) {
+    __atomic_sub_fetch(&slab->used_count, 1, __ATOMIC_RELAXED);
+
+    if (slab_thread_cache_index != 0) {
+        // Give a batch of objects back when the thread cache is full
+        SlabThreadCache* thread_cache = &slab->thread_caches[slab_thread_cache_index - 1];
+        if (thread_cache->objects_count == SLAB_THREAD_CACHE_COUNT) {
+            mtx_lock(&slab->lock);
+            for (int i = 0; i < SLAB_THREAD_CACHE_BATCH_COUNT; i++) {
+                void** cached_object = thread_cache->objects[--thread_cache->objects_count];
+                *cached_object = slab->free_objects;
+                slab->free_objects = cached_object;
+            }
+            mtx_unlock(&slab->lock);
+        }
+        thread_cache->objects[thread_cache->objects_count++] = object;
+        return;
+    }
+
+    mtx_lock(&slab->lock);
+    *(void**)object = slab->free_objects;
+    slab->free_objects = object;
+    mtx_unlock(&slab->lock);
+}
+
+// The mapped memory of the slab, the objects in use are in the used count
+size_t slab_get_memory_size(Slab* slab) {
+    mtx_lock(&slab->lock);
+    size_t memory_size = sizeof(Slab) + (size_t)slab->regions_count * SLAB_REGION_SIZE;
+    mtx_unlock(&slab->lock);
+    return memory_size;
+}
+
+// Free the slab and unmap all regions, all objects are freed with it
+void slab_free(Slab* slab) {
+    for (int i = 0; i < slab->regions_count; i++) {
+        #ifdef __WIN32__
+            VirtualFree(slab->regions[i], 0, MEM_RELEASE);
+        #else
+            munmap(slab->regions[i], SLAB_REGION_SIZE);
+        #endif
+    }
+    free(slab->regions);
+    mtx_destroy(&slab->lock);
+    free(slab);
+}
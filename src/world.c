@@ -6,6 +6,9 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#ifndef __WIN32__
+    #include <unistd.h>
+#endif
 #include "geometry/block.h"
 #include "perlin/perlin.h"
 #include "random.h"
@@ -24,23 +27,46 @@ World* world_new(Camera* camera, BlockType *selected_block_type) {
     #else
         world->render_distance = WORLD_RENDER_DISTANCE_NEAR;
     #endif
+    world->ticks = 0;
+    world->player_chunk_x = 0;
+    world->player_chunk_y = 0;
+    world->player_chunk_z = 0;
+    world->player_moves = 0;
+    world->camera = camera;
 
     // Create database
-    world->database = database_new();
+    DatabaseBackendType* backend_type = database_get_backend_type(DATABASE_BACKEND);
+    world->database = database_new(backend_type->path, backend_type);
 
     // Init chuch chache
-    for (int i = 0; i < WORLD_CHUNK_CACHE_COUNT; i++) {
-        world->chunk_cache[i] = NULL;
-    }
-    world->chunk_cache_start = 0;
+    world->chunk_cache_size = 0;
+    world->chunk_cache_memory = 0;
+    world->evict_candidates = malloc(WORLD_CHUNK_CACHE_COUNT * sizeof(WorldEvictCandidate));
+    world->chunk_index = chunk_index_new(WORLD_CHUNK_INDEX_COUNT);
     mtx_init(&world->chunk_cache_lock, mtx_plain);
 
-    // Init request queue
+    // Init the chunk slabs and the slab thread cache of the render thread
+    chunk_init_slabs();
+    slab_thread_start();
+
+    // Init the column cache for the chunk generator
+    world->column_cache = column_cache_new(WORLD_COLUMN_CACHE_COUNT);
+
+    // Init chunk garbage
+    world->chunk_garbage = NULL;
+    world->chunk_garbage_size = 0;
+    world->chunk_garbage_capacity = 0;
+    world->faces_garbage = NULL;
+    world->faces_garbage_size = 0;
+    world->faces_garbage_capacity = 0;
+
+    // Init request queue and fill the request pool with all requests
+    world->requests = malloc(WORLD_REQUEST_QUEUE_COUNT * sizeof(WorldRequest));
+    world->request_pool = request_queue_new(WORLD_REQUEST_QUEUE_COUNT);
     for (int i = 0; i < WORLD_REQUEST_QUEUE_COUNT; i++) {
-        world->request_queue[i] = NULL;
+        request_queue_push(world->request_pool, &world->requests[i]);
     }
-    world->request_queue_size = 0;
-    mtx_init(&world->request_queue_lock, mtx_plain);
+    world->request_set = request_set_new(WORLD_REQUEST_SET_COUNT);
 
     // Get world seed
     world->seed = database_settings_get_int(world->database, "seed", 0);
@@ -60,10 +86,12 @@ World* world_new(Camera* camera, BlockType *selected_block_type) {
         random_free(random);
 
         database_settings_set_int(world->database, "seed", world->seed);
+        database_settings_set_int(world->database, "generator_version", WORLD_GENERATOR_VERSION);
     }
 
-    // Init perlin noise with seed
-    perlin_init(world->seed);
+    // Init perlin noise with seed, older worlds keep the unseeded permutation so their new chunks still fit
+    world->generator_version = database_settings_get_int(world->database, "generator_version", 1);
+    world->perlin = perlin_new(world->seed, world->generator_version >= 2);
 
     // Get start location right hight (y position)
     int start_x = CHUNK_SIZE / 2;
@@ -73,13 +101,13 @@ World* world_new(Camera* camera, BlockType *selected_block_type) {
     do {
         Chunk *chunk = world_get_chunk(world, 0, chunk_y, 0);
         for (int y = 0; y < CHUNK_SIZE; y++) {
-            BlockType block_type = chunk->data[start_z * CHUNK_SIZE * CHUNK_SIZE + y * CHUNK_SIZE + start_x];
-            block_type &= ~CHUNK_DATA_VISIBLE_BIT;
+            BlockType block_type = chunk_get_block(chunk, start_x, y, start_z);
             if (block_type == BLOCK_TYPE_GRASS || block_type == BLOCK_TYPE_SAND_TOP || block_type == BLOCK_TYPE_WATER) {
                 start_y = chunk_y * CHUNK_SIZE + y;
                 break;
             }
         }
+        chunk_release(chunk);
         chunk_y++;
 
         if (chunk_y == 4) {
@@ -103,138 +131,445 @@ World* world_new(Camera* camera, BlockType *selected_block_type) {
     // Get old player selected block
     *selected_block_type = database_settings_get_int(world->database, "player_selected_block_type", BLOCK_TYPE_BROWN_WOOD);
 
-    // Init workers
+    // Init one worker per processor except the render thread, each with its own request queue
+    world->workers_count = world_get_processors_count() - 1;
+    if (world->workers_count < 1) {
+        world->workers_count = 1;
+    }
+    if (world->workers_count > WORLD_WORKER_THREAD_MAX_COUNT) {
+        world->workers_count = WORLD_WORKER_THREAD_MAX_COUNT;
+    }
+    world->workers_next = 0;
+    log_info("Starting %d world worker threads", world->workers_count);
+
     world->worker_running = true;
-    mtx_init(&world->worker_running_lock, mtx_plain);
-    for (int i = 0; i < WORLD_WORKER_THREAD_COUNT; i++) {
-        thrd_create(&world->worker_threads[i], world_worker_thread, world);
+    world->pending_requests_count = 0;
+    world->cancelled_requests_count = 0;
+    world->wasted_generations_count = 0;
+    world->sleeping_workers_count = 0;
+    mtx_init(&world->worker_lock, mtx_plain);
+    cnd_init(&world->worker_condition);
+    for (int i = 0; i < world->workers_count; i++) {
+        WorldWorker* worker = &world->workers[i];
+        worker->world = world;
+        worker->index = i;
+        for (int j = 0; j < WORLD_REQUEST_PRIORITY_COUNT; j++) {
+            worker->request_queues[j] = request_queue_new(WORLD_REQUEST_QUEUE_COUNT);
+        }
+    }
+    for (int i = 0; i < world->workers_count; i++) {
+        thrd_create(&world->workers[i].thread, world_worker_thread, &world->workers[i]);
     }
 
     return world;
 }
 
-void world_add_chunk_to_cache(World* world, Chunk* chunk) {
+// Read the chunk the player is in, readers retry when the render thread changed
+// the position while they where reading it (a sequence lock)
+void world_get_player_chunk(World* world, int* player_chunk_x, int* player_chunk_y, int* player_chunk_z) {
+    for (;;) {
+        unsigned int player_moves = __atomic_load_n(&world->player_moves, __ATOMIC_ACQUIRE);
+        if ((player_moves & 1) != 0) {
+            continue;
+        }
+
+        *player_chunk_x = __atomic_load_n(&world->player_chunk_x, __ATOMIC_RELAXED);
+        *player_chunk_y = __atomic_load_n(&world->player_chunk_y, __ATOMIC_RELAXED);
+        *player_chunk_z = __atomic_load_n(&world->player_chunk_z, __ATOMIC_RELAXED);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&world->player_moves, __ATOMIC_RELAXED) == player_moves) {
+            return;
+        }
+    }
+}
+
+// Get the distance in chunks from the chunk the player is in
+int world_get_player_chunk_distance(World* world, int chunk_x, int chunk_y, int chunk_z) {
+    int player_chunk_x, player_chunk_y, player_chunk_z;
+    world_get_player_chunk(world, &player_chunk_x, &player_chunk_y, &player_chunk_z);
+    int distance = abs(chunk_x - player_chunk_x);
+    if (abs(chunk_y - player_chunk_y) > distance) distance = abs(chunk_y - player_chunk_y);
+    if (abs(chunk_z - player_chunk_z) > distance) distance = abs(chunk_z - player_chunk_z);
+    return distance;
+}
+
+// Count the current memory size of a cached chunk in the cache total, call this when the chunk storage, faces
+// or mesh grew or shrank. Evicted chunks are skipped, only call this when holding the chunk cache lock and not
+// the chunk lock
+void world_update_chunk_cache_memory(World* world, Chunk* chunk) {
+    if (chunk->cache_index == -1) {
+        return;
+    }
+    size_t memory_size = chunk_get_memory_size(chunk);
+    world->chunk_cache_memory += memory_size - chunk->cache_memory_size;
+    chunk->cache_memory_size = memory_size;
+}
+
+// Remove a chunk from the cache and move it to the garbage, changed chunks are written back
+// first. Only call this when holding the chunk cache lock
+void world_remove_chunk_from_cache(World* world, Chunk* chunk) {
+    mtx_lock(&chunk->chunk_lock);
+    if (chunk->is_modified) {
+        database_chunks_set_chunk(world->database, chunk);
+        chunk->is_modified = false;
+    }
+    mtx_unlock(&chunk->chunk_lock);
+
+    chunk_index_remove(world->chunk_index, chunk->x, chunk->y, chunk->z);
+    Chunk* last_chunk = world->chunk_cache[--world->chunk_cache_size];
+    world->chunk_cache[chunk->cache_index] = last_chunk;
+    last_chunk->cache_index = chunk->cache_index;
+    chunk->cache_index = -1;
+    world->chunk_cache_memory -= chunk->cache_memory_size;
+
+    // Chunk meshes can only be freed on the OpenGL thread so move the chunk to the garbage
+    if (world->chunk_garbage_size == world->chunk_garbage_capacity) {
+        world->chunk_garbage_capacity = world->chunk_garbage_capacity == 0 ? 64 : world->chunk_garbage_capacity * 2;
+        world->chunk_garbage = realloc(world->chunk_garbage, world->chunk_garbage_capacity * sizeof(Chunk*));
+    }
+    world->chunk_garbage[world->chunk_garbage_size++] = chunk;
+}
+
+// Move a candidate down the max heap until it is larger then its children
+void world_evict_candidates_sift_down(WorldEvictCandidate* candidates, int candidates_count, int index) {
+    for (;;) {
+        int largest_index = index;
+        int left_index = index * 2 + 1;
+        int right_index = index * 2 + 2;
+        if (left_index < candidates_count && candidates[left_index].score > candidates[largest_index].score) {
+            largest_index = left_index;
+        }
+        if (right_index < candidates_count && candidates[right_index].score > candidates[largest_index].score) {
+            largest_index = right_index;
+        }
+        if (largest_index == index) {
+            return;
+        }
+        WorldEvictCandidate candidate = candidates[index];
+        candidates[index] = candidates[largest_index];
+        candidates[largest_index] = candidate;
+        index = largest_index;
+    }
+}
+
+// Evict the chunks that are the furthest away and the longest not used until the headroom of the cache
+// is free. The scores of the unreferenced chunks are put in a max heap once so evicting k chunks
+// costs O(n + k log n), only call this when holding the chunk cache lock
+void world_evict_chunks_from_cache(World* world) {
+    WorldEvictCandidate* candidates = world->evict_candidates;
+    int candidates_count = 0;
+    for (int i = 0; i < world->chunk_cache_size; i++) {
+        Chunk* chunk = world->chunk_cache[i];
+        if (__atomic_load_n(&chunk->references, __ATOMIC_ACQUIRE) == 0) {
+            int distance = world_get_player_chunk_distance(world, chunk->x, chunk->y, chunk->z);
+            candidates[candidates_count].score = distance * WORLD_CHUNK_EVICT_DISTANCE_WEIGHT + (world->ticks - chunk->last_used_tick);
+            candidates[candidates_count].chunk = chunk;
+            candidates_count++;
+        }
+    }
+    for (int i = candidates_count / 2 - 1; i >= 0; i--) {
+        world_evict_candidates_sift_down(candidates, candidates_count, i);
+    }
+
+    // References to a cached chunk are only taken when holding the cache lock so the candidates stay unreferenced
+    while (
+        candidates_count > 0 &&
+        (world->chunk_cache_size > WORLD_CHUNK_CACHE_COUNT - WORLD_CHUNK_CACHE_COUNT / WORLD_CHUNK_EVICT_HEADROOM ||
+        world->chunk_cache_memory > (size_t)WORLD_CHUNK_CACHE_MEMORY - WORLD_CHUNK_CACHE_MEMORY / WORLD_CHUNK_EVICT_HEADROOM)
+    ) {
+        world_remove_chunk_from_cache(world, candidates[0].chunk);
+        candidates[0] = candidates[--candidates_count];
+        world_evict_candidates_sift_down(candidates, candidates_count, 0);
+    }
+}
+
+// Add a chunk to the chunk cache and return a reference to it, when an other thread was faster
+// the cached chunk is returned. A full cache evicts chunks until it has headroom again
+Chunk* world_add_chunk_to_cache(World* world, Chunk* chunk) {
     mtx_lock(&world->chunk_cache_lock);
-    if (world->chunk_cache_start == WORLD_CHUNK_CACHE_COUNT) {
-        world->chunk_cache_start = 0;
+    Chunk* cached_chunk = chunk_index_get(world->chunk_index, chunk->x, chunk->y, chunk->z);
+    if (cached_chunk != NULL) {
+        chunk_retain(cached_chunk);
+        cached_chunk->last_used_tick = world->ticks;
+        mtx_unlock(&world->chunk_cache_lock);
+        chunk_free(chunk);
+        return cached_chunk;
+    }
+
+    size_t memory_size = chunk_get_memory_size(chunk);
+    if (world->chunk_cache_size == WORLD_CHUNK_CACHE_COUNT || world->chunk_cache_memory + memory_size > WORLD_CHUNK_CACHE_MEMORY) {
+        world_evict_chunks_from_cache(world);
     }
-    if (world->chunk_cache[world->chunk_cache_start] != NULL) {
-        chunk_free(world->chunk_cache[world->chunk_cache_start]);
+    if (world->chunk_cache_size == WORLD_CHUNK_CACHE_COUNT) {
+        log_error("The chunk cache is full and all chunks are referenced");
     }
-    world->chunk_cache[world->chunk_cache_start++] = chunk;
+
+    chunk_retain(chunk);
+    chunk->last_used_tick = world->ticks;
+    chunk->cache_index = world->chunk_cache_size;
+    chunk->cache_memory_size = memory_size;
+    world->chunk_cache[world->chunk_cache_size++] = chunk;
+    world->chunk_cache_memory += memory_size;
+    chunk_index_set(world->chunk_index, chunk->x, chunk->y, chunk->z, chunk);
     mtx_unlock(&world->chunk_cache_lock);
+    return chunk;
 }
 
-Chunk* world_get_chunk(World* world, int chunk_x, int chunk_y, int chunk_z) {
-    // Check if chunk is in cunk cache
-    for (int i = 0; i < WORLD_CHUNK_CACHE_COUNT; i++) {
-        Chunk* chunk = world->chunk_cache[i];
+// Move replaced chunk faces to the garbage, the render thread reads the faces without the chunk lock
+// so they are only freed when it starts a new frame. Don't hold a chunk lock when calling this
+void world_add_faces_garbage(World* world, uint8_t* faces) {
+    mtx_lock(&world->chunk_cache_lock);
+    if (world->faces_garbage_size == world->faces_garbage_capacity) {
+        world->faces_garbage_capacity = world->faces_garbage_capacity == 0 ? 64 : world->faces_garbage_capacity * 2;
+        world->faces_garbage = realloc(world->faces_garbage, world->faces_garbage_capacity * sizeof(uint8_t*));
+    }
+    world->faces_garbage[world->faces_garbage_size++] = faces;
+    mtx_unlock(&world->chunk_cache_lock);
+}
 
-        if (chunk == NULL) {
-            break;
-        }
+// Free the evicted chunks that are not referenced anymore and the replaced chunk faces, only call
+// this on the OpenGL thread when it holds no chunk faces
+void world_free_chunk_garbage(World* world) {
+    mtx_lock(&world->chunk_cache_lock);
+    for (int i = 0; i < world->faces_garbage_size; i++) {
+        slab_deallocate(chunk_faces_slab, world->faces_garbage[i]);
+    }
+    world->faces_garbage_size = 0;
 
-        if (chunk->x == chunk_x && chunk->y == chunk_y && chunk->z == chunk_z) {
-            return chunk;
+    int chunk_garbage_size = 0;
+    for (int i = 0; i < world->chunk_garbage_size; i++) {
+        Chunk* chunk = world->chunk_garbage[i];
+        if (__atomic_load_n(&chunk->references, __ATOMIC_ACQUIRE) == 0) {
+            chunk_free(chunk);
+        } else {
+            world->chunk_garbage[chunk_garbage_size++] = chunk;
         }
     }
+    world->chunk_garbage_size = chunk_garbage_size;
+    mtx_unlock(&world->chunk_cache_lock);
+}
+
+// Get a chunk from the cache, the database or the generator, the returned chunk
+// is referenced so release it with chunk_release when done with it
+Chunk* world_get_chunk(World* world, int chunk_x, int chunk_y, int chunk_z) {
+    // Check if chunk is in cunk cache
+    mtx_lock(&world->chunk_cache_lock);
+    Chunk* chunk = chunk_index_get(world->chunk_index, chunk_x, chunk_y, chunk_z);
+    if (chunk != NULL) {
+        chunk_retain(chunk);
+        chunk->last_used_tick = world->ticks;
+    }
+    mtx_unlock(&world->chunk_cache_lock);
+    if (chunk != NULL) {
+        return chunk;
+    }
 
     // Select / Search chunk in database
-    Chunk* chunk = database_chunks_get_chunk(world->database, chunk_x, chunk_y, chunk_z);
+    chunk = database_chunks_get_chunk(world->database, chunk_x, chunk_y, chunk_z);
     if (chunk != NULL) {
         // When found add to cache
-        world_add_chunk_to_cache(world, chunk);
-        return chunk;
+        return world_add_chunk_to_cache(world, chunk);
     }
 
-    // When not found generate chunk and add to cache and add it to database
-    chunk = chunk_new_from_generator(chunk_x, chunk_y, chunk_z);
-    world_add_chunk_to_cache(world, chunk);
-    database_chunks_set_chunk(world->database, chunk);
-    return chunk;
+    // When not found generate chunk and add to cache, the generator is deterministic
+    // so the chunk is only stored in the database when the player changes it
+    chunk = chunk_new_from_generator(world, chunk_x, chunk_y, chunk_z);
+    return world_add_chunk_to_cache(world, chunk);
 }
 
-Chunk* world_request_chunk(World* world, int chunk_x, int chunk_y, int chunk_z) {
-    // Check if chunk is in cunk cache
-    for (int i = 0; i < WORLD_CHUNK_CACHE_COUNT; i++) {
-        Chunk* chunk = world->chunk_cache[i];
+// Pack the request type and chunk position in one non zero key for the request set
+uint64_t world_get_request_key(WorldRequestType type, int chunk_x, int chunk_y, int chunk_z) {
+    return ((uint64_t)(type + 1) << 60) |
+        ((uint64_t)(chunk_x & 0xfffff) << 40) |
+        ((uint64_t)(chunk_y & 0xfffff) << 20) |
+        (uint64_t)(chunk_z & 0xfffff);
+}
 
-        if (chunk == NULL) {
-            break;
-        }
+// Push a request to the request queue when the same request is not already pending, update
+// requests hold a chunk reference. Returns false when it is pending or the request pool is empty
+bool world_push_request(World* world, WorldRequestType type, int chunk_x, int chunk_y, int chunk_z, Chunk* chunk) {
+    uint64_t key = world_get_request_key(type, chunk_x, chunk_y, chunk_z);
+    if (request_set_contains(world->request_set, key) || !request_set_add(world->request_set, key)) {
+        return false;
+    }
 
-        if (chunk->x == chunk_x && chunk->y == chunk_y && chunk->z == chunk_z) {
-            return chunk;
+    WorldRequest* request = request_queue_pop(world->request_pool);
+    if (request == NULL) {
+        request_set_remove(world->request_set, key);
+        return false;
+    }
+
+    request->type = type;
+    request->key = key;
+    // The player moves are read before the priority so a request is never ranked for an older position
+    // then its player moves, when the player moves in between the request is only ranked again
+    request->player_moves = __atomic_load_n(&world->player_moves, __ATOMIC_ACQUIRE);
+    request->is_visible = chunk_is_in_frustum(chunk_x, chunk_y, chunk_z, world->camera);
+    request->priority = world_get_request_priority(world, chunk_x, chunk_y, chunk_z, request->is_visible);
+    if (type == WORLD_REQUEST_TYPE_CHUNK_UPDATE) {
+        chunk_retain(chunk);
+        request->arguments.chunk_pointer = chunk;
+    } else {
+        request->arguments.chunk_position.x = chunk_x;
+        request->arguments.chunk_position.y = chunk_y;
+        request->arguments.chunk_position.z = chunk_z;
+    }
+
+    // Spread the requests over the worker request queues, they have the same capacity
+    // as the request pool so they can't be full
+    unsigned int worker_index = __atomic_fetch_add(&world->workers_next, 1, __ATOMIC_RELAXED) % world->workers_count;
+    request_queue_push(world->workers[worker_index].request_queues[request->priority], request);
+
+    // Wake up a sleeping worker, the worker lock makes sure the signal is not lost
+    __atomic_add_fetch(&world->pending_requests_count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&world->sleeping_workers_count, __ATOMIC_SEQ_CST) > 0) {
+        mtx_lock(&world->worker_lock);
+        cnd_signal(&world->worker_condition);
+        mtx_unlock(&world->worker_lock);
+    }
+    return true;
+}
+
+// Near chunks go first and chunks outside the camera frustum get a lower priority
+int world_get_request_priority(World* world, int chunk_x, int chunk_y, int chunk_z, bool is_visible) {
+    int priority = world_get_player_chunk_distance(world, chunk_x, chunk_y, chunk_z);
+    if (!is_visible) {
+        priority += WORLD_REQUEST_HIDDEN_PRIORITY;
+    }
+    return priority < WORLD_REQUEST_PRIORITY_COUNT ? priority : WORLD_REQUEST_PRIORITY_COUNT - 1;
+}
+
+// Drop a request without handling it and give it back to the request pool
+void world_cancel_request(World* world, WorldRequest* request) {
+    request_set_remove(world->request_set, request->key);
+    if (request->type == WORLD_REQUEST_TYPE_CHUNK_UPDATE) {
+        chunk_release(request->arguments.chunk_pointer);
+    }
+    request_queue_push(world->request_pool, request);
+    __atomic_sub_fetch(&world->pending_requests_count, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&world->cancelled_requests_count, 1, __ATOMIC_RELAXED);
+}
+
+// Pop the highest priority request from the own request queues or steal one from the other
+// workers. Requests are re-ranked lazily when the player moved to an other chunk since their push
+// and requests for chunks that left the render distance are cancelled before doing any work
+WorldRequest* world_pop_request(World* world, WorldWorker* worker) {
+    for (int priority = 0; priority < WORLD_REQUEST_PRIORITY_COUNT; priority++) {
+        for (int i = 0; i < world->workers_count; i++) {
+            RequestQueue* request_queue = world->workers[(worker->index + i) % world->workers_count].request_queues[priority];
+            WorldRequest* request;
+            while ((request = request_queue_pop(request_queue)) != NULL) {
+                unsigned int player_moves = __atomic_load_n(&world->player_moves, __ATOMIC_ACQUIRE);
+                if (request->player_moves == player_moves) {
+                    __atomic_sub_fetch(&world->pending_requests_count, 1, __ATOMIC_SEQ_CST);
+                    return request;
+                }
+
+                int chunk_x, chunk_y, chunk_z;
+                if (request->type == WORLD_REQUEST_TYPE_CHUNK_UPDATE) {
+                    chunk_x = request->arguments.chunk_pointer->x;
+                    chunk_y = request->arguments.chunk_pointer->y;
+                    chunk_z = request->arguments.chunk_pointer->z;
+                } else {
+                    chunk_x = request->arguments.chunk_position.x;
+                    chunk_y = request->arguments.chunk_position.y;
+                    chunk_z = request->arguments.chunk_position.z;
+                }
+                if (world_get_player_chunk_distance(world, chunk_x, chunk_y, chunk_z) > world->render_distance) {
+                    world_cancel_request(world, request);
+                    continue;
+                }
+
+                request->player_moves = player_moves;
+                request->priority = world_get_request_priority(world, chunk_x, chunk_y, chunk_z, request->is_visible);
+                if (request->priority <= priority) {
+                    __atomic_sub_fetch(&world->pending_requests_count, 1, __ATOMIC_SEQ_CST);
+                    return request;
+                }
+                request_queue_push(worker->request_queues[request->priority], request);
+            }
         }
     }
+    return NULL;
+}
+
+// Pop a request or sleep until there is one, returns NULL when the workers are stopping
+WorldRequest* world_wait_request(World* world, WorldWorker* worker) {
+    while (__atomic_load_n(&world->worker_running, __ATOMIC_ACQUIRE)) {
+        WorldRequest* request = world_pop_request(world, worker);
+        if (request != NULL) {
+            return request;
+        }
 
-    // Check for an pending chunk new request
-    for (int i = 0; i < world->request_queue_size; i++) {
-        WorldRequest* request = world->request_queue[i];
-        if (
-            request->type == WORLD_REQUEST_TYPE_CHUNK_NEW &&
-            request->arguments.chunk_position.x == chunk_x &&
-            request->arguments.chunk_position.y == chunk_y &&
-            request->arguments.chunk_position.z == chunk_z
+        mtx_lock(&world->worker_lock);
+        __atomic_add_fetch(&world->sleeping_workers_count, 1, __ATOMIC_SEQ_CST);
+        while (
+            __atomic_load_n(&world->pending_requests_count, __ATOMIC_SEQ_CST) == 0 &&
+            __atomic_load_n(&world->worker_running, __ATOMIC_ACQUIRE)
         ) {
-            return NULL;
+            cnd_wait(&world->worker_condition, &world->worker_lock);
         }
+        __atomic_sub_fetch(&world->sleeping_workers_count, 1, __ATOMIC_SEQ_CST);
+        mtx_unlock(&world->worker_lock);
+    }
+    return NULL;
+}
+
+// Get a chunk from the cache or request it when not loaded, only call this on the OpenGL thread
+// the returned chunk is not referenced but it stays valid until the next chunk garbage free
+Chunk* world_request_chunk(World* world, int chunk_x, int chunk_y, int chunk_z) {
+    // Check if chunk is in cunk cache
+    Chunk* chunk = chunk_index_get(world->chunk_index, chunk_x, chunk_y, chunk_z);
+    if (chunk != NULL) {
+        chunk->last_used_tick = world->ticks;
+        return chunk;
     }
 
-    // Create chunk new request and push it to the request queue
-    mtx_lock(&world->request_queue_lock);
-    WorldRequest* request = malloc(sizeof(WorldRequest));
-    request->type = WORLD_REQUEST_TYPE_CHUNK_NEW;
-    request->arguments.chunk_position.x = chunk_x;
-    request->arguments.chunk_position.y = chunk_y;
-    request->arguments.chunk_position.z = chunk_z;
-    world->request_queue[world->request_queue_size++] = request;
-    mtx_unlock(&world->request_queue_lock);
+    // Request the chunk when it is not already pending
+    world_push_request(world, WORLD_REQUEST_TYPE_CHUNK_NEW, chunk_x, chunk_y, chunk_z, NULL);
     return NULL;
 }
 
+// Request an update of a chunk that world_request_chunk returned, the request references the chunk so that is
+// done when holding the chunk cache lock like every other reference. Evicted chunks need no update
 void world_request_chunk_update(World* world, Chunk* chunk) {
-    // Check for an pending chunk update request
-    for (int i = 0; i < world->request_queue_size; i++) {
-        WorldRequest* request = world->request_queue[i];
-        if (
-            request->type == WORLD_REQUEST_TYPE_CHUNK_UPDATE &&
-            request->arguments.chunk_pointer == chunk
-        ) {
-            return;
-        }
+    mtx_lock(&world->chunk_cache_lock);
+    if (chunk->cache_index != -1) {
+        world_push_request(world, WORLD_REQUEST_TYPE_CHUNK_UPDATE, chunk->x, chunk->y, chunk->z, chunk);
     }
-
-    // Create chunk update request and push it to the request queue
-    mtx_lock(&world->request_queue_lock);
-    WorldRequest* request = malloc(sizeof(WorldRequest));
-    request->type = WORLD_REQUEST_TYPE_CHUNK_UPDATE;
-    request->arguments.chunk_pointer = chunk;
-    world->request_queue[world->request_queue_size++] = request;
-    mtx_unlock(&world->request_queue_lock);
+    mtx_unlock(&world->chunk_cache_lock);
 }
 
-int world_render(World* world, Camera* camera, BlockShader* block_shader, TextureAtlas* blocks_texture_atlas) {
-    block_shader_enable(block_shader);
+int world_render(World* world, Camera* camera, ChunkShader* chunk_shader, TextureAtlas* blocks_texture_atlas) {
+    // Free the chunks that where removed from the chunk cache
+    world_free_chunk_garbage(world);
+    world->ticks++;
+
+    chunk_shader_enable(chunk_shader);
     texture_atlas_enable(blocks_texture_atlas);
 
     if (world->is_wireframed) {
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     }
 
-    glUniform1i(block_shader->is_lighted_uniform, true);
-    glUniform1i(block_shader->is_flad_shaded_uniform, world->is_flat_shaded);
-
-    glUniformMatrix4fv(block_shader->projection_matrix_uniform, 1, GL_FALSE, &camera->projection_matrix.m11);
-    glUniformMatrix4fv(block_shader->view_matrix_uniform, 1, GL_FALSE, &camera->view_matrix.m11);
+    glUniform1i(chunk_shader->is_flat_shaded_uniform, world->is_flat_shaded);
 
-    Matrix4 rotation_matrix;
-    matrix4_rotate_x(&rotation_matrix, radians(90));
+    glUniformMatrix4fv(chunk_shader->projection_matrix_uniform, 1, GL_FALSE, &camera->projection_matrix.m11);
+    glUniformMatrix4fv(chunk_shader->view_matrix_uniform, 1, GL_FALSE, &camera->view_matrix.m11);
 
     // Loop over all rendered chunks
     int player_chunk_x = floor(camera->position.x / (float)CHUNK_SIZE);
     int player_chunk_y = floor(camera->position.y / (float)CHUNK_SIZE);
     int player_chunk_z = floor(camera->position.z / (float)CHUNK_SIZE);
+    if (player_chunk_x != world->player_chunk_x || player_chunk_y != world->player_chunk_y || player_chunk_z != world->player_chunk_z) {
+        __atomic_store_n(&world->player_moves, world->player_moves + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&world->player_chunk_x, player_chunk_x, __ATOMIC_RELAXED);
+        __atomic_store_n(&world->player_chunk_y, player_chunk_y, __ATOMIC_RELAXED);
+        __atomic_store_n(&world->player_chunk_z, player_chunk_z, __ATOMIC_RELAXED);
+        __atomic_store_n(&world->player_moves, world->player_moves + 1, __ATOMIC_RELEASE);
+    }
     int rendered_chunks = 0;
     for (int chunk_z = player_chunk_z + world->render_distance; chunk_z > player_chunk_z - world->render_distance; chunk_z--) {
         for (int chunk_y = player_chunk_y - world->render_distance; chunk_y <= player_chunk_y + world->render_distance; chunk_y++) {
@@ -242,36 +577,24 @@ int world_render(World* world, Camera* camera, BlockShader* block_shader, Textur
                 // Get lighted chunk data
                 Chunk* chunk = world_request_chunk(world, chunk_x, chunk_y, chunk_z);
                 if (chunk != NULL) {
-                    if (!chunk->is_lighted) {
+                    if (!chunk_is_lighted(chunk)) {
                         world_request_chunk_update(world, chunk);
                     } else {
-                        // Render the chunk when visible
-                        if (chunk_is_visible(chunk, camera)) {
-                            for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
-                                for (int block_y = 0; block_y < CHUNK_SIZE; block_y++) {
-                                    for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
-                                        BlockType block_type = chunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x];
-                                        if ((block_type & CHUNK_DATA_VISIBLE_BIT) != 0) {
-                                            block_type &= (~CHUNK_DATA_VISIBLE_BIT);
-
-                                            Matrix4 model_matrix;
-                                            Vector4 block_position_vector = {
-                                                chunk_x * CHUNK_SIZE + block_x,
-                                                chunk_y * CHUNK_SIZE + block_y,
-                                                -(chunk_z * CHUNK_SIZE + block_z),
-                                                1
-                                            };
-                                            matrix4_translate(&model_matrix, &block_position_vector);
-                                            matrix4_mul(&model_matrix, &rotation_matrix);
-                                            glUniformMatrix4fv(block_shader->model_matrix_uniform, 1, GL_FALSE, &model_matrix.m11);
-
-                                            glUniform1iv(block_shader->texture_indexes_uniform, 6, (const GLint*)&BLOCK_TYPE_TEXTURE_FACES[block_type]);
-
-                                            glDrawArrays(GL_TRIANGLES, 0, BLOCK_VERTICES_COUNT);
-                                        }
-                                    }
-                                }
-                            }
+                        // Upload the chunk mesh when it is rebuilded and no worker is busy with it
+                        if (chunk->mesh->is_changed && mtx_trylock(&chunk->chunk_lock) == thrd_success) {
+                            chunk_mesh_upload(chunk->mesh);
+                            mtx_unlock(&chunk->chunk_lock);
+
+                            mtx_lock(&world->chunk_cache_lock);
+                            world_update_chunk_cache_memory(world, chunk);
+                            mtx_unlock(&world->chunk_cache_lock);
+                        }
+
+                        // Render the chunk when visible with one draw call
+                        if (chunk->mesh->uploaded_vertices_count > 0 && chunk_is_visible(chunk, camera)) {
+                            chunk_mesh_enable(chunk->mesh);
+                            glDrawArrays(GL_TRIANGLES, 0, chunk->mesh->uploaded_vertices_count);
+                            chunk_mesh_disable(chunk->mesh);
 
                             rendered_chunks++;
                         }
@@ -286,7 +609,7 @@ int world_render(World* world, Camera* camera, BlockShader* block_shader, Textur
     }
 
     texture_atlas_disable(blocks_texture_atlas);
-    block_shader_disable(block_shader);
+    chunk_shader_disable(chunk_shader);
 
     return rendered_chunks;
 }
@@ -325,15 +648,16 @@ BlockPosition *world_get_selected_block(World* world, Camera* camera) {
                         // Get lighted chunk data
                         Chunk* chunk = world_request_chunk(world, chunk_x, chunk_y, chunk_z);
                         if (chunk != NULL) {
-                            if (!chunk->is_lighted) {
+                            if (!chunk_is_lighted(chunk)) {
                                 world_request_chunk_update(world, chunk);
                             } else {
                                 // Ray point is in chunk check all blocks for collision
+                                uint8_t* faces = chunk_get_faces(chunk);
                                 for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
                                     for (int block_y = 0; block_y < CHUNK_SIZE; block_y++) {
                                         for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
-                                            BlockType block_type = chunk->data[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x];
-                                            if ((block_type & CHUNK_DATA_VISIBLE_BIT) != 0) {
+                                            uint8_t block_faces = faces[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x];
+                                            if (block_faces != 0) {
                                                 // Check if ray point falls in block
                                                 float block_min_x = chunk->x * CHUNK_SIZE + block_x - 0.5;
                                                 float block_max_x = chunk->x * CHUNK_SIZE + block_x + 0.5;
@@ -355,32 +679,32 @@ BlockPosition *world_get_selected_block(World* world, Camera* camera) {
                                                     block_position->block_y = block_y;
                                                     block_position->block_z = block_z;
 
-                                                    // Check good block side
+                                                    // Check good block side, only faces that touch air can be selected
                                                     float distance = 1;
 
-                                                    if (fabs(ray_point.x - block_min_x) < distance) {
+                                                    if ((block_faces & CHUNK_FACE_BIT(BLOCK_SIDE_LEFT)) != 0 && fabs(ray_point.x - block_min_x) < distance) {
                                                         distance = fabs(ray_point.x - block_min_x);
                                                         block_position->block_side = BLOCK_SIDE_LEFT;
                                                     }
-                                                    if (fabs(ray_point.x - block_max_x) < distance) {
+                                                    if ((block_faces & CHUNK_FACE_BIT(BLOCK_SIDE_RIGHT)) != 0 && fabs(ray_point.x - block_max_x) < distance) {
                                                         distance = fabs(ray_point.x - block_max_x);
                                                         block_position->block_side = BLOCK_SIDE_RIGHT;
                                                     }
 
-                                                    if (fabs(ray_point.y - block_min_y) < distance) {
+                                                    if ((block_faces & CHUNK_FACE_BIT(BLOCK_SIDE_BELOW)) != 0 && fabs(ray_point.y - block_min_y) < distance) {
                                                         distance = fabs(ray_point.y - block_min_y);
                                                         block_position->block_side = BLOCK_SIDE_BELOW;
                                                     }
-                                                    if (fabs(ray_point.y - block_max_y) < distance) {
+                                                    if ((block_faces & CHUNK_FACE_BIT(BLOCK_SIDE_ABOVE)) != 0 && fabs(ray_point.y - block_max_y) < distance) {
                                                         distance = fabs(ray_point.y - block_max_y);
                                                         block_position->block_side = BLOCK_SIDE_ABOVE;
                                                     }
 
-                                                    if (fabs(ray_point.z - block_min_z) < distance) {
+                                                    if ((block_faces & CHUNK_FACE_BIT(BLOCK_SIDE_FRONT)) != 0 && fabs(ray_point.z - block_min_z) < distance) {
                                                         distance = fabs(ray_point.z - block_min_z);
                                                         block_position->block_side = BLOCK_SIDE_FRONT;
                                                     }
-                                                    if (fabs(ray_point.z - block_max_z) < distance) {
+                                                    if ((block_faces & CHUNK_FACE_BIT(BLOCK_SIDE_BACK)) != 0 && fabs(ray_point.z - block_max_z) < distance) {
                                                         distance = fabs(ray_point.z - block_max_z);
                                                         block_position->block_side = BLOCK_SIDE_BACK;
                                                     }
@@ -412,73 +736,113 @@ BlockPosition *world_get_selected_block(World* world, Camera* camera) {
 
 BlockType world_get_block(World* world, BlockPosition* block_position) {
     Chunk* chunk = world_get_chunk(world, block_position->chunk_x, block_position->chunk_y, block_position->chunk_z);
-    BlockType block_type = chunk->data[block_position->block_z * CHUNK_SIZE * CHUNK_SIZE + block_position->block_y * CHUNK_SIZE + block_position->block_x];
-    block_type &= ~CHUNK_DATA_VISIBLE_BIT;
+    BlockType block_type = chunk_get_block(chunk, block_position->block_x, block_position->block_y, block_position->block_z);
+    chunk_release(chunk);
     return block_type;
 }
 
 void world_set_block(World* world, BlockPosition* block_position, BlockType block_type) {
     Chunk* chunk = world_get_chunk(world, block_position->chunk_x, block_position->chunk_y, block_position->chunk_z);
+    chunk_set_block(chunk, block_position->block_x, block_position->block_y, block_position->block_z, block_type);
     chunk->is_changed = true;
-    chunk->data[block_position->block_z * CHUNK_SIZE * CHUNK_SIZE + block_position->block_y * CHUNK_SIZE + block_position->block_x] = block_type;
+    mtx_lock(&world->chunk_cache_lock);
+    world_update_chunk_cache_memory(world, chunk);
+    mtx_unlock(&world->chunk_cache_lock);
     world_request_chunk_update(world, chunk);
+    chunk_release(chunk);
 
     if (block_position->block_x == 0) {
         Chunk* other_chunk =  world_get_chunk(world, block_position->chunk_x - 1, block_position->chunk_y, block_position->chunk_z);
         other_chunk->is_relighted = false;
         world_request_chunk_update(world, other_chunk);
+        chunk_release(other_chunk);
     }
 
     if (block_position->block_x == CHUNK_SIZE - 1) {
         Chunk* other_chunk =  world_get_chunk(world, block_position->chunk_x + 1, block_position->chunk_y, block_position->chunk_z);
         other_chunk->is_relighted = false;
         world_request_chunk_update(world, other_chunk);
+        chunk_release(other_chunk);
     }
 
     if (block_position->block_y == 0) {
         Chunk* other_chunk =  world_get_chunk(world, block_position->chunk_x, block_position->chunk_y - 1, block_position->chunk_z);
         other_chunk->is_relighted = false;
         world_request_chunk_update(world, other_chunk);
+        chunk_release(other_chunk);
     }
 
     if (block_position->block_y == CHUNK_SIZE - 1) {
         Chunk* other_chunk =  world_get_chunk(world, block_position->chunk_x, block_position->chunk_y + 1, block_position->chunk_z);
         other_chunk->is_relighted = false;
         world_request_chunk_update(world, other_chunk);
+        chunk_release(other_chunk);
     }
 
     if (block_position->block_z == 0) {
         Chunk* other_chunk =  world_get_chunk(world, block_position->chunk_x, block_position->chunk_y, block_position->chunk_z - 1);
         other_chunk->is_relighted = false;
         world_request_chunk_update(world, other_chunk);
+        chunk_release(other_chunk);
     }
 
     if (block_position->block_z == CHUNK_SIZE - 1) {
         Chunk* other_chunk =  world_get_chunk(world, block_position->chunk_x, block_position->chunk_y, block_position->chunk_z + 1);
         other_chunk->is_relighted = false;
         world_request_chunk_update(world, other_chunk);
+        chunk_release(other_chunk);
     }
 }
 
 void world_free(World* world, Camera* camera, BlockType *selected_block_type) {
-    mtx_lock(&world->worker_running_lock);
-    world->worker_running = false;
-    mtx_unlock(&world->worker_running_lock);
-
-    for (int i = 0; i < WORLD_WORKER_THREAD_COUNT; i++) {
-        thrd_join(world->worker_threads[i], NULL);
+    // Stop the workers, they finish there current request and don't start a new one
+    mtx_lock(&world->worker_lock);
+    __atomic_store_n(&world->worker_running, false, __ATOMIC_RELEASE);
+    cnd_broadcast(&world->worker_condition);
+    mtx_unlock(&world->worker_lock);
+
+    for (int i = 0; i < world->workers_count; i++) {
+        thrd_join(world->workers[i].thread, NULL);
     }
+    mtx_destroy(&world->worker_lock);
+    cnd_destroy(&world->worker_condition);
+
+    // Release the chunk references of the queued requests
+    for (int i = 0; i < world->workers_count; i++) {
+        WorldRequest* request;
+        for (int j = 0; j < WORLD_REQUEST_PRIORITY_COUNT; j++) {
+            while ((request = request_queue_pop(world->workers[i].request_queues[j])) != NULL) {
+                if (request->type == WORLD_REQUEST_TYPE_CHUNK_UPDATE) {
+                    chunk_release(request->arguments.chunk_pointer);
+                }
+            }
+            request_queue_free(world->workers[i].request_queues[j]);
+        }
+    }
+    request_queue_free(world->request_pool);
+    request_set_free(world->request_set);
+    free(world->requests);
 
-    for (int i = 0; i < WORLD_CHUNK_CACHE_COUNT; i++) {
+    // Write back the changed chunks and free the chunk cache
+    for (int i = 0; i < world->chunk_cache_size; i++) {
         Chunk* chunk = world->chunk_cache[i];
-        if (chunk != NULL) {
-            chunk_free(chunk);
+        if (chunk->is_modified) {
+            database_chunks_set_chunk(world->database, chunk);
         }
+        chunk_free(chunk);
     }
+    world_free_chunk_garbage(world);
+    free(world->chunk_garbage);
+    free(world->faces_garbage);
+    free(world->evict_candidates);
+
+    chunk_index_free(world->chunk_index);
+    column_cache_free(world->column_cache);
+    perlin_free(world->perlin);
+    slab_thread_stop();
 
     // Free mutex locks
     mtx_destroy(&world->chunk_cache_lock);
-    mtx_destroy(&world->request_queue_lock);
 
     // Save player position
     database_settings_set_float(world->database, "player_x", camera->position.x);
@@ -497,49 +861,66 @@ void world_free(World* world, Camera* camera, BlockType *selected_block_type) {
     free(world);
 }
 
-int world_worker_thread(void* argument) {
-    World* world = (World*)argument;
-
-    while (world->worker_running) {
-        if (world->request_queue_size > 0) {
-            // Get first request and remove it by shifting
-            mtx_lock(&world->request_queue_lock);
-
-            WorldRequest* request = world->request_queue[0];
+// Get the number of processors of the system
+int world_get_processors_count(void) {
+    #ifdef __WIN32__
+        SYSTEM_INFO system_info;
+        GetSystemInfo(&system_info);
+        return system_info.dwNumberOfProcessors;
+    #else
+        return sysconf(_SC_NPROCESSORS_ONLN);
+    #endif
+}
 
-            for (int i = 1; i < world->request_queue_size; i++) {
-                world->request_queue[i - 1] = world->request_queue[i];
-            }
-            world->request_queue_size--;
-
-            mtx_unlock(&world->request_queue_lock);
-
-            // Create chunk
-            if (request->type == WORLD_REQUEST_TYPE_CHUNK_NEW) {
-                world_get_chunk(
-                    world,
-                    request->arguments.chunk_position.x,
-                    request->arguments.chunk_position.y,
-                    request->arguments.chunk_position.z
-                );
+int world_worker_thread(void* argument) {
+    WorldWorker* worker = (WorldWorker*)argument;
+    World* world = worker->world;
+    slab_thread_start();
+
+    WorldRequest* request;
+    while ((request = world_wait_request(world, worker)) != NULL) {
+        // Create chunk
+        if (request->type == WORLD_REQUEST_TYPE_CHUNK_NEW) {
+            Chunk* chunk = world_get_chunk(
+                world,
+                request->arguments.chunk_position.x,
+                request->arguments.chunk_position.y,
+                request->arguments.chunk_position.z
+            );
+            if (world_get_player_chunk_distance(world, chunk->x, chunk->y, chunk->z) > world->render_distance) {
+                __atomic_add_fetch(&world->wasted_generations_count, 1, __ATOMIC_RELAXED);
             }
+            chunk_release(chunk);
 
-            // Update chunk
-            if (request->type == WORLD_REQUEST_TYPE_CHUNK_UPDATE) {
-                Chunk* chunk = request->arguments.chunk_pointer;
-                if (chunk->is_changed) {
-                    database_chunks_set_chunk(world->database, chunk);
-                }
-                chunk_update(chunk, world);
+            // The chunk is in the cache now so it is no longer pending
+            request_set_remove(world->request_set, request->key);
+        }
+
+        // Update chunk
+        if (request->type == WORLD_REQUEST_TYPE_CHUNK_UPDATE) {
+            // Allow new update requests before updating so later changes are not missed
+            request_set_remove(world->request_set, request->key);
+
+            // The database write and chunk update of a chunk are only done when holding the chunk lock
+            Chunk* chunk = request->arguments.chunk_pointer;
+            mtx_lock(&chunk->chunk_lock);
+            if (chunk->is_modified) {
+                database_chunks_set_chunk(world->database, chunk);
+                chunk->is_modified = false;
             }
+            mtx_unlock(&chunk->chunk_lock);
+            chunk_update(chunk, world);
 
-            // Free request
-            free(request);
-        } else {
-            struct timespec duration = { 0, WORLD_WORKER_THREAD_UPDATE_TIMEOUT * 1000 };
-            thrd_sleep(&duration, NULL);
+            mtx_lock(&world->chunk_cache_lock);
+            world_update_chunk_cache_memory(world, chunk);
+            mtx_unlock(&world->chunk_cache_lock);
+            chunk_release(chunk);
         }
+
+        // Give the request back to the request pool
+        request_queue_push(world->request_pool, request);
     }
 
+    slab_thread_stop();
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,219 @@
+// PlaatCraft - Chunk Codec Test
+
+#include "test.h"
+#include <string.h>
+#include "chunk_codec.h"
+#include "geometry/block.h"
+
+#define CHUNK_CODEC_TEST_CHUNKS_COUNT 256
+#define CHUNK_CODEC_TEST_RANDOM_COUNT 200000
+
+// Fill a chunk of terrain layers like the generator makes, with a few ores when is_noisy is set
+void chunk_codec_test_fill_terrain(uint16_t* blocks, int height, bool is_noisy) {
+    for (int i = 0; i < CHUNK_CODEC_BLOCKS_COUNT; i++) {
+        int block_y = i / CHUNK_SIZE % CHUNK_SIZE;
+        if (block_y > height) {
+            blocks[i] = BLOCK_TYPE_AIR;
+        } else if (block_y == height) {
+            blocks[i] = BLOCK_TYPE_GRASS;
+        } else if (block_y > height - 3) {
+            blocks[i] = BLOCK_TYPE_DIRT;
+        } else {
+            blocks[i] = BLOCK_TYPE_STONE;
+        }
+        if (is_noisy && blocks[i] == BLOCK_TYPE_STONE && rand() % 32 == 0) {
+            blocks[i] = rand() % 2 == 0 ? BLOCK_TYPE_COAL : BLOCK_TYPE_GOLD;
+        }
+    }
+}
+
+// Fill a chunk with random block types so no runs are left and the indices are packed
+void chunk_codec_test_fill_random(uint16_t* blocks, int block_types_count) {
+    for (int i = 0; i < CHUNK_CODEC_BLOCKS_COUNT; i++) {
+        blocks[i] = rand() % block_types_count;
+    }
+}
+
+// Encode the blocks as the legacy run length encoding of version 1
+int chunk_codec_test_encode_legacy(uint16_t* blocks, uint8_t* buffer) {
+    int size = 2;
+    int i = 0;
+    while (i < CHUNK_CODEC_BLOCKS_COUNT) {
+        int count = 1;
+        while (i + count < CHUNK_CODEC_BLOCKS_COUNT && blocks[i + count] == blocks[i] && count < 256) {
+            count++;
+        }
+        if (count == 1) {
+            buffer[size++] = blocks[i];
+        } else {
+            buffer[size++] = blocks[i] | CHUNK_CODEC_LEGACY_REPEAT_BIT;
+            buffer[size++] = count - 1;
+        }
+        i += count;
+    }
+    buffer[0] = size & 0xff;
+    buffer[1] = size >> 8;
+    return size;
+}
+
+// Encode and decode the blocks, check the mode and that every shorter size of the encoded chunk is rejected
+int chunk_codec_test_round_trip(uint16_t* blocks, ChunkCodecMode mode) {
+    uint8_t buffer[CHUNK_CODEC_MAX_SIZE];
+    int size = chunk_codec_encode(blocks, buffer);
+    TEST_ASSERT(size > 0 && size <= CHUNK_CODEC_MAX_SIZE);
+    TEST_ASSERT(buffer[3] == mode);
+
+    uint16_t decoded_blocks[CHUNK_CODEC_BLOCKS_COUNT];
+    TEST_ASSERT(chunk_codec_decode(buffer, size, decoded_blocks));
+    TEST_ASSERT(!memcmp(blocks, decoded_blocks, sizeof(decoded_blocks)));
+    for (int truncated_size = 0; truncated_size < size; truncated_size++) {
+        TEST_ASSERT(!chunk_codec_decode(buffer, truncated_size, decoded_blocks));
+    }
+    return size;
+}
+
+void chunk_codec_test_modes(void) {
+    uint16_t blocks[CHUNK_CODEC_BLOCKS_COUNT];
+    srand(CHUNK_CODEC_BLOCKS_COUNT);
+
+    // Uniform chunks of every block type
+    for (int block_type = 0; block_type < BLOCK_TYPE_SIZE; block_type++) {
+        for (int i = 0; i < CHUNK_CODEC_BLOCKS_COUNT; i++) {
+            blocks[i] = block_type;
+        }
+        TEST_ASSERT(chunk_codec_test_round_trip(blocks, CHUNK_CODEC_MODE_UNIFORM) == CHUNK_CODEC_HEADER_SIZE + 2);
+    }
+
+    // Terrain chunks are runs and random chunks are packed with 1, 2 and 4 bits per block
+    for (int height = 0; height < CHUNK_SIZE; height++) {
+        chunk_codec_test_fill_terrain(blocks, height, height % 2 == 0);
+        chunk_codec_test_round_trip(blocks, CHUNK_CODEC_MODE_RUNS);
+    }
+    int block_types_counts[] = { 2, 3, 4, 5, 16 };
+    for (size_t i = 0; i < sizeof(block_types_counts) / sizeof(int); i++) {
+        chunk_codec_test_fill_random(blocks, block_types_counts[i]);
+        chunk_codec_test_round_trip(blocks, CHUNK_CODEC_MODE_PACKED);
+    }
+
+    // A run longer then 129 blocks needs a two byte run length
+    chunk_codec_test_fill_random(blocks, 4);
+    for (int i = 100; i < 3000; i++) {
+        blocks[i] = BLOCK_TYPE_STONE;
+    }
+    for (int i = 3000; i < CHUNK_CODEC_BLOCKS_COUNT; i++) {
+        blocks[i] = BLOCK_TYPE_AIR;
+    }
+    chunk_codec_test_round_trip(blocks, CHUNK_CODEC_MODE_RUNS);
+}
+
+// The legacy run length encoding still decodes and a chunk of only the size header is air
+void chunk_codec_test_legacy(void) {
+    uint16_t blocks[CHUNK_CODEC_BLOCKS_COUNT];
+    uint16_t decoded_blocks[CHUNK_CODEC_BLOCKS_COUNT];
+    uint8_t buffer[CHUNK_CODEC_MAX_SIZE];
+    for (int height = 0; height < CHUNK_SIZE; height += 3) {
+        chunk_codec_test_fill_terrain(blocks, height, true);
+        int size = chunk_codec_test_encode_legacy(blocks, buffer);
+        TEST_ASSERT(chunk_codec_decode(buffer, size, decoded_blocks));
+        TEST_ASSERT(!memcmp(blocks, decoded_blocks, sizeof(decoded_blocks)));
+        TEST_ASSERT(!chunk_codec_decode(buffer, size - 1, decoded_blocks));
+    }
+
+    uint8_t air_buffer[2] = { 2, 0 };
+    TEST_ASSERT(chunk_codec_decode(air_buffer, sizeof(air_buffer), decoded_blocks));
+    for (int i = 0; i < CHUNK_CODEC_BLOCKS_COUNT; i++) {
+        TEST_ASSERT(decoded_blocks[i] == BLOCK_TYPE_AIR);
+    }
+
+    // Unknown block types are rejected
+    chunk_codec_test_fill_terrain(blocks, 8, false);
+    int size = chunk_codec_test_encode_legacy(blocks, buffer);
+    buffer[2] = (buffer[2] & CHUNK_CODEC_LEGACY_REPEAT_BIT) | 0x7f;
+    TEST_ASSERT(!chunk_codec_decode(buffer, size, decoded_blocks));
+}
+
+// Random bytes and changed bytes of valid chunks must never decode to unknown block types
+void chunk_codec_test_corrupt(void) {
+    uint16_t blocks[CHUNK_CODEC_BLOCKS_COUNT];
+    uint8_t buffer[CHUNK_CODEC_MAX_SIZE];
+    int decoded_count = 0;
+
+    // A palette entry of a newer version is rejected
+    chunk_codec_test_fill_terrain(blocks, 8, false);
+    int size = chunk_codec_encode(blocks, buffer);
+    buffer[CHUNK_CODEC_HEADER_SIZE] = BLOCK_TYPE_SIZE;
+    buffer[CHUNK_CODEC_HEADER_SIZE + 1] = 0;
+    TEST_ASSERT(!chunk_codec_decode(buffer, size, blocks));
+
+    for (int i = 0; i < CHUNK_CODEC_TEST_RANDOM_COUNT; i++) {
+        if (i % 2 == 0) {
+            size = 1 + rand() % 64;
+            for (int j = 0; j < size; j++) {
+                buffer[j] = rand();
+            }
+            // Random small chunks of both versions with a matching size header
+            if (rand() % 2 == 0) {
+                buffer[0] = size & 0xff;
+                buffer[1] = (size >> 8) | (rand() % 2 == 0 ? CHUNK_CODEC_VERSION_BIT >> 8 : 0);
+                buffer[2] = CHUNK_CODEC_VERSION;
+                buffer[3] %= 3;
+            }
+        } else {
+            chunk_codec_test_fill_terrain(blocks, rand() % CHUNK_SIZE, true);
+            size = chunk_codec_encode(blocks, buffer);
+            buffer[rand() % size] ^= 1 << (rand() % 8);
+        }
+
+        if (chunk_codec_decode(buffer, size, blocks)) {
+            decoded_count++;
+            for (int j = 0; j < CHUNK_CODEC_BLOCKS_COUNT; j++) {
+                TEST_ASSERT(blocks[j] < BLOCK_TYPE_SIZE);
+            }
+        }
+    }
+    printf("fuzz   | %d corrupt chunks | %d decode to known block types\n", CHUNK_CODEC_TEST_RANDOM_COUNT, decoded_count);
+}
+
+// Time the encoding and decoding of terrain chunks and print the compression ratio
+void chunk_codec_test_benchmark(char* name, bool is_terrain) {
+    uint16_t* chunks = malloc(CHUNK_CODEC_TEST_CHUNKS_COUNT * CHUNK_CODEC_BLOCKS_COUNT * sizeof(uint16_t));
+    uint8_t* buffers = malloc(CHUNK_CODEC_TEST_CHUNKS_COUNT * CHUNK_CODEC_MAX_SIZE);
+    int sizes[CHUNK_CODEC_TEST_CHUNKS_COUNT];
+    for (int i = 0; i < CHUNK_CODEC_TEST_CHUNKS_COUNT; i++) {
+        if (is_terrain) {
+            chunk_codec_test_fill_terrain(&chunks[i * CHUNK_CODEC_BLOCKS_COUNT], i % CHUNK_SIZE, true);
+        } else {
+            chunk_codec_test_fill_random(&chunks[i * CHUNK_CODEC_BLOCKS_COUNT], 4);
+        }
+    }
+
+    long encoded_size = 0;
+    double encode_time = test_get_time();
+    for (int i = 0; i < CHUNK_CODEC_TEST_CHUNKS_COUNT; i++) {
+        sizes[i] = chunk_codec_encode(&chunks[i * CHUNK_CODEC_BLOCKS_COUNT], &buffers[i * CHUNK_CODEC_MAX_SIZE]);
+        encoded_size += sizes[i];
+    }
+    encode_time = test_get_time() - encode_time;
+
+    uint16_t blocks[CHUNK_CODEC_BLOCKS_COUNT];
+    double decode_time = test_get_time();
+    for (int i = 0; i < CHUNK_CODEC_TEST_CHUNKS_COUNT; i++) {
+        TEST_ASSERT(chunk_codec_decode(&buffers[i * CHUNK_CODEC_MAX_SIZE], sizes[i], blocks));
+    }
+    decode_time = test_get_time() - decode_time;
+
+    double blocks_size = (double)CHUNK_CODEC_TEST_CHUNKS_COUNT * CHUNK_CODEC_BLOCKS_COUNT * sizeof(uint16_t);
+    printf("%-6s | %d chunks | ratio %.1fx | encode %.0f MB/s | decode %.0f MB/s\n", name, CHUNK_CODEC_TEST_CHUNKS_COUNT,
+        blocks_size / encoded_size, blocks_size / encode_time / 1e6, blocks_size / decode_time / 1e6);
+    free(chunks);
+    free(buffers);
+}
+
+int main(void) {
+    chunk_codec_test_modes();
+    chunk_codec_test_legacy();
+    chunk_codec_test_corrupt();
+    chunk_codec_test_benchmark("runs", true);
+    chunk_codec_test_benchmark("packed", false);
+    return EXIT_SUCCESS;
+}
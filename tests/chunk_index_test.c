@@ -0,0 +1,134 @@
+// PlaatCraft - Chunk Index Test
+
+#include "test.h"
+#include <stdint.h>
+#include "chunk_index.h"
+
+#define CHUNK_INDEX_TEST_CAPACITY 64
+#define CHUNK_INDEX_TEST_SIZE 8 // Chunks per side of the positions the model test uses
+#define CHUNK_INDEX_TEST_POSITIONS_COUNT (CHUNK_INDEX_TEST_SIZE * CHUNK_INDEX_TEST_SIZE * CHUNK_INDEX_TEST_SIZE)
+#define CHUNK_INDEX_TEST_OPERATIONS_COUNT 400000
+#define CHUNK_INDEX_TEST_LOOKUPS_COUNT 4000000
+
+// The chunks are never read so any unique pointer is a chunk
+char chunk_index_test_chunks[CHUNK_INDEX_TEST_POSITIONS_COUNT];
+
+struct Chunk* chunk_index_test_get_chunk(int position) {
+    return (struct Chunk*)&chunk_index_test_chunks[position];
+}
+
+void chunk_index_test_get_position(int position, int* chunk_x, int* chunk_y, int* chunk_z) {
+    *chunk_x = position % CHUNK_INDEX_TEST_SIZE - CHUNK_INDEX_TEST_SIZE / 2;
+    *chunk_y = position / CHUNK_INDEX_TEST_SIZE % CHUNK_INDEX_TEST_SIZE - CHUNK_INDEX_TEST_SIZE / 2;
+    *chunk_z = position / (CHUNK_INDEX_TEST_SIZE * CHUNK_INDEX_TEST_SIZE) - CHUNK_INDEX_TEST_SIZE / 2;
+}
+
+// Count the entries that wrapped around the end of the entries to a slot before their home slot
+int chunk_index_test_count_wrapped(ChunkIndex* chunk_index) {
+    int wrapped_count = 0;
+    for (int i = 0; i < chunk_index->capacity; i++) {
+        ChunkIndexEntry* entry = &chunk_index->entries[i];
+        if (entry->chunk != NULL && (int)(chunk_index_hash(entry->x, entry->y, entry->z) & (chunk_index->capacity - 1)) > i) {
+            wrapped_count++;
+        }
+    }
+    return wrapped_count;
+}
+
+// Set and remove random chunks in a small index and compare it with an array of all positions, the index
+// is filled up to half its capacity so the clusters are long, wrap around and are shifted back a lot
+void chunk_index_test_model(void) {
+    ChunkIndex* chunk_index = chunk_index_new(CHUNK_INDEX_TEST_CAPACITY);
+    struct Chunk* model[CHUNK_INDEX_TEST_POSITIONS_COUNT] = { NULL };
+    int chunks_count = 0;
+    int wrapped_count = 0;
+    int replaced_count = 0;
+
+    srand(CHUNK_INDEX_TEST_CAPACITY);
+    for (int i = 0; i < CHUNK_INDEX_TEST_OPERATIONS_COUNT; i++) {
+        int position = rand() % CHUNK_INDEX_TEST_POSITIONS_COUNT;
+        int chunk_x, chunk_y, chunk_z;
+        chunk_index_test_get_position(position, &chunk_x, &chunk_y, &chunk_z);
+        if (rand() % 2 == 0 && (model[position] != NULL || chunks_count < CHUNK_INDEX_TEST_CAPACITY / 2)) {
+            // Replace chunks with the chunk of an other position to check that set replaces
+            struct Chunk* chunk = chunk_index_test_get_chunk(rand() % CHUNK_INDEX_TEST_POSITIONS_COUNT);
+            replaced_count += model[position] != NULL;
+            chunks_count += model[position] == NULL;
+            chunk_index_set(chunk_index, chunk_x, chunk_y, chunk_z, chunk);
+            model[position] = chunk;
+        } else {
+            chunks_count -= model[position] != NULL;
+            chunk_index_remove(chunk_index, chunk_x, chunk_y, chunk_z);
+            model[position] = NULL;
+        }
+        wrapped_count += chunk_index_test_count_wrapped(chunk_index) > 0;
+
+        // Check some positions after every operation and all positions now and then
+        int checks_count = i % 1024 == 0 ? CHUNK_INDEX_TEST_POSITIONS_COUNT : 8;
+        for (int j = 0; j < checks_count; j++) {
+            int other_position = checks_count == CHUNK_INDEX_TEST_POSITIONS_COUNT ? j : rand() % CHUNK_INDEX_TEST_POSITIONS_COUNT;
+            chunk_index_test_get_position(other_position, &chunk_x, &chunk_y, &chunk_z);
+            TEST_ASSERT(chunk_index_get(chunk_index, chunk_x, chunk_y, chunk_z) == model[other_position]);
+        }
+    }
+
+    int index_chunks_count = 0;
+    for (int i = 0; i < chunk_index->capacity; i++) {
+        index_chunks_count += chunk_index->entries[i].chunk != NULL;
+    }
+    TEST_ASSERT(index_chunks_count == chunks_count);
+    TEST_ASSERT(wrapped_count > 0);
+    TEST_ASSERT(replaced_count > 0);
+    printf("model | %d operations | %d with wrapped entries | %d replaces\n", CHUNK_INDEX_TEST_OPERATIONS_COUNT, wrapped_count, replaced_count);
+    chunk_index_free(chunk_index);
+}
+
+// Fill an index to half its capacity, the load factor the world sizes it for, with a box of chunks of the
+// given size and time hit and miss lookups
+void chunk_index_test_benchmark(int size_x, int size_y, int size_z) {
+    int chunks_count = size_x * size_y * size_z;
+    ChunkIndex* chunk_index = chunk_index_new(chunks_count * 2);
+    for (int chunk_x = 0; chunk_x < size_x; chunk_x++) {
+        for (int chunk_y = 0; chunk_y < size_y; chunk_y++) {
+            for (int chunk_z = 0; chunk_z < size_z; chunk_z++) {
+                chunk_index_set(chunk_index, chunk_x, chunk_y, chunk_z, chunk_index_test_get_chunk(chunk_x % CHUNK_INDEX_TEST_POSITIONS_COUNT));
+            }
+        }
+    }
+
+    srand(chunks_count);
+    int* positions = malloc(CHUNK_INDEX_TEST_LOOKUPS_COUNT * sizeof(int));
+    for (int i = 0; i < CHUNK_INDEX_TEST_LOOKUPS_COUNT; i++) {
+        positions[i] = rand() % chunks_count;
+    }
+
+    int found_count = 0;
+    double hit_time = test_get_time();
+    for (int i = 0; i < CHUNK_INDEX_TEST_LOOKUPS_COUNT; i++) {
+        int position = positions[i];
+        found_count += chunk_index_get(chunk_index, position % size_x, position / size_x % size_y, position / (size_x * size_y)) != NULL;
+    }
+    hit_time = test_get_time() - hit_time;
+    TEST_ASSERT(found_count == CHUNK_INDEX_TEST_LOOKUPS_COUNT);
+
+    double miss_time = test_get_time();
+    for (int i = 0; i < CHUNK_INDEX_TEST_LOOKUPS_COUNT; i++) {
+        int position = positions[i];
+        found_count -= chunk_index_get(chunk_index, -1 - position % size_x, position / size_x % size_y, position / (size_x * size_y)) != NULL;
+    }
+    miss_time = test_get_time() - miss_time;
+    TEST_ASSERT(found_count == CHUNK_INDEX_TEST_LOOKUPS_COUNT);
+
+    printf("get   | %5d chunks in %5d entries | hit %.1f ns | miss %.1f ns\n", chunks_count, chunk_index->capacity,
+        hit_time / CHUNK_INDEX_TEST_LOOKUPS_COUNT * 1e9, miss_time / CHUNK_INDEX_TEST_LOOKUPS_COUNT * 1e9);
+    free(positions);
+    chunk_index_free(chunk_index);
+}
+
+int main(void) {
+    chunk_index_test_model();
+    chunk_index_test_benchmark(16, 4, 16);
+    chunk_index_test_benchmark(16, 16, 16);
+    chunk_index_test_benchmark(32, 16, 32);
+    return EXIT_SUCCESS;
+}
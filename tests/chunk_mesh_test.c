@@ -0,0 +1,198 @@
+// PlaatCraft - Chunk Mesh Test
+
+#include "test.h"
+#include <string.h>
+#include "chunk.h"
+#include "log.h"
+
+#define CHUNK_MESH_TEST_CHUNKS_COUNT 64
+#define CHUNK_MESH_TEST_BENCHMARK_ROUNDS_COUNT 16
+
+// A chunk with its six neighbour chunks, the mesh is build without an OpenGL context
+typedef struct ChunkMeshTestChunks {
+    uint16_t chunk_data[CHUNK_DATA_SIZE];
+    uint16_t neighbours_data[BLOCK_SIDE_SIZE][CHUNK_DATA_SIZE];
+} ChunkMeshTestChunks;
+
+// Fill a chunk with random blocks where every block is air with the given chance in percent
+void chunk_mesh_test_fill(uint16_t* chunk_data, int air_percentage) {
+    for (int i = 0; i < CHUNK_DATA_SIZE; i++) {
+        chunk_data[i] = rand() % 100 < air_percentage ? BLOCK_TYPE_AIR : 1 + rand() % (BLOCK_TYPE_SIZE - 1);
+    }
+}
+
+// Build the mesh of the chunk at a chunk position like chunk_update does
+void chunk_mesh_test_build(ChunkMeshTestChunks* chunks, int chunk_x, int chunk_y, int chunk_z, ChunkMesh* chunk_mesh) {
+    uint16_t border_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE];
+    for (int i = 0; i < BLOCK_SIDE_SIZE; i++) {
+        Chunk* neighbour_chunk = chunk_new_from_data(chunk_x + CHUNK_BLOCK_SIDE_OFFSETS[i][0],
+            chunk_y + CHUNK_BLOCK_SIDE_OFFSETS[i][1], chunk_z + CHUNK_BLOCK_SIDE_OFFSETS[i][2], chunks->neighbours_data[i]);
+        chunk_get_border_rows(neighbour_chunk, i, border_rows[i]);
+        chunk_free(neighbour_chunk);
+    }
+    uint16_t face_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE];
+    chunk_get_face_rows(chunks->chunk_data, border_rows, face_rows);
+    chunk_build_mesh(chunk_mesh, chunk_x, chunk_y, chunk_z, chunks->chunk_data, face_rows);
+}
+
+// Get a block of the chunk or of one of its neighbour chunks
+BlockType chunk_mesh_test_get_block(ChunkMeshTestChunks* chunks, int block_x, int block_y, int block_z) {
+    for (int i = 0; i < BLOCK_SIDE_SIZE; i++) {
+        int neighbour_x = block_x - CHUNK_BLOCK_SIDE_OFFSETS[i][0] * CHUNK_SIZE;
+        int neighbour_y = block_y - CHUNK_BLOCK_SIDE_OFFSETS[i][1] * CHUNK_SIZE;
+        int neighbour_z = block_z - CHUNK_BLOCK_SIDE_OFFSETS[i][2] * CHUNK_SIZE;
+        if (
+            neighbour_x >= 0 && neighbour_x < CHUNK_SIZE &&
+            neighbour_y >= 0 && neighbour_y < CHUNK_SIZE &&
+            neighbour_z >= 0 && neighbour_z < CHUNK_SIZE
+        ) {
+            return chunks->neighbours_data[i][neighbour_z * CHUNK_SIZE * CHUNK_SIZE + neighbour_y * CHUNK_SIZE + neighbour_x];
+        }
+    }
+    return chunks->chunk_data[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x];
+}
+
+// Build the mesh block by block, a face is added when the block is not air and its neighbour block is air
+void chunk_mesh_test_build_simple(ChunkMeshTestChunks* chunks, int chunk_x, int chunk_y, int chunk_z, ChunkMesh* chunk_mesh) {
+    chunk_mesh_clear(chunk_mesh);
+    for (BlockSide block_side = 0; block_side < BLOCK_SIDE_SIZE; block_side++) {
+        for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
+            for (int block_y = 0; block_y < CHUNK_SIZE; block_y++) {
+                for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
+                    BlockType block_type = chunk_mesh_test_get_block(chunks, block_x, block_y, block_z);
+                    if (block_type != BLOCK_TYPE_AIR && chunk_mesh_test_get_block(chunks,
+                        block_x + CHUNK_BLOCK_SIDE_OFFSETS[block_side][0],
+                        block_y + CHUNK_BLOCK_SIDE_OFFSETS[block_side][1],
+                        block_z + CHUNK_BLOCK_SIDE_OFFSETS[block_side][2]) == BLOCK_TYPE_AIR
+                    ) {
+                        chunk_mesh_add_face(chunk_mesh, chunk_x * CHUNK_SIZE + block_x, chunk_y * CHUNK_SIZE + block_y,
+                            chunk_z * CHUNK_SIZE + block_z, block_side, block_type);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// One block in an empty world has six faces, every face lies on the side of the block it belongs to, the
+// world z axis is flipped in the vertices, and the texture index comes from the block type
+void chunk_mesh_test_block(void) {
+    ChunkMeshTestChunks* chunks = calloc(1, sizeof(ChunkMeshTestChunks));
+    ChunkMesh* chunk_mesh = chunk_mesh_new();
+    int chunk_x = 1, chunk_y = -2, chunk_z = 3;
+    int block_x = 3, block_y = 4, block_z = 5;
+    for (BlockType block_type = 1; block_type < BLOCK_TYPE_SIZE; block_type++) {
+        chunks->chunk_data[block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x] = block_type;
+        chunk_mesh_test_build(chunks, chunk_x, chunk_y, chunk_z, chunk_mesh);
+        TEST_ASSERT(chunk_mesh->is_changed);
+        TEST_ASSERT(chunk_mesh->vertices_count == BLOCK_SIDE_SIZE * CHUNK_MESH_FACE_VERTICES_COUNT);
+
+        for (BlockSide block_side = 0; block_side < BLOCK_SIDE_SIZE; block_side++) {
+            float center[3] = { chunk_x * CHUNK_SIZE + block_x, chunk_y * CHUNK_SIZE + block_y, -(chunk_z * CHUNK_SIZE + block_z) };
+            float direction[3] = { CHUNK_BLOCK_SIDE_OFFSETS[block_side][0], CHUNK_BLOCK_SIDE_OFFSETS[block_side][1], -CHUNK_BLOCK_SIDE_OFFSETS[block_side][2] };
+            for (int i = 0; i < CHUNK_MESH_FACE_VERTICES_COUNT; i++) {
+                float* vertex = &chunk_mesh->vertices[(block_side * CHUNK_MESH_FACE_VERTICES_COUNT + i) * CHUNK_MESH_VERTEX_SIZE];
+                float distance = 0;
+                for (int j = 0; j < 3; j++) {
+                    TEST_ASSERT(vertex[j] == center[j] - 0.5f || vertex[j] == center[j] + 0.5f);
+                    distance += (vertex[j] - center[j]) * direction[j];
+                }
+                TEST_ASSERT(distance == 0.5f);
+                int texture_face = vertex[5];
+                TEST_ASSERT(texture_face >= 1 && texture_face <= 6);
+                TEST_ASSERT(vertex[6] == BLOCK_TYPE_TEXTURE_FACES[block_type][texture_face - 1]);
+            }
+        }
+    }
+    chunk_mesh_free(chunk_mesh);
+    free(chunks);
+}
+
+// A solid chunk has only its outside faces when the neighbours are air and no faces when they are solid
+void chunk_mesh_test_solid(void) {
+    ChunkMeshTestChunks* chunks = calloc(1, sizeof(ChunkMeshTestChunks));
+    ChunkMesh* chunk_mesh = chunk_mesh_new();
+    for (int i = 0; i < CHUNK_DATA_SIZE; i++) {
+        chunks->chunk_data[i] = BLOCK_TYPE_STONE;
+    }
+    chunk_mesh_test_build(chunks, 0, 0, 0, chunk_mesh);
+    TEST_ASSERT(chunk_mesh->vertices_count == BLOCK_SIDE_SIZE * CHUNK_SIZE * CHUNK_SIZE * CHUNK_MESH_FACE_VERTICES_COUNT);
+
+    for (int i = 0; i < BLOCK_SIDE_SIZE; i++) {
+        for (int j = 0; j < CHUNK_DATA_SIZE; j++) {
+            chunks->neighbours_data[i][j] = BLOCK_TYPE_DIRT;
+        }
+    }
+    chunk_mesh_test_build(chunks, 0, 0, 0, chunk_mesh);
+    TEST_ASSERT(chunk_mesh->vertices_count == 0);
+    chunk_mesh_free(chunk_mesh);
+    free(chunks);
+}
+
+// Random chunks with random neighbours must give the same vertices as the simple block by block mesh
+void chunk_mesh_test_compare(void) {
+    ChunkMeshTestChunks* chunks = malloc(sizeof(ChunkMeshTestChunks));
+    ChunkMesh* chunk_mesh = chunk_mesh_new();
+    ChunkMesh* expected_chunk_mesh = chunk_mesh_new();
+    long faces_count = 0;
+    srand(CHUNK_MESH_TEST_CHUNKS_COUNT);
+    for (int i = 0; i < CHUNK_MESH_TEST_CHUNKS_COUNT; i++) {
+        int air_percentage = i * 100 / CHUNK_MESH_TEST_CHUNKS_COUNT;
+        chunk_mesh_test_fill(chunks->chunk_data, air_percentage);
+        for (int j = 0; j < BLOCK_SIDE_SIZE; j++) {
+            chunk_mesh_test_fill(chunks->neighbours_data[j], rand() % 100);
+        }
+        int chunk_x = rand() % 64 - 32, chunk_y = rand() % 64 - 32, chunk_z = rand() % 64 - 32;
+        chunk_mesh_test_build(chunks, chunk_x, chunk_y, chunk_z, chunk_mesh);
+        chunk_mesh_test_build_simple(chunks, chunk_x, chunk_y, chunk_z, expected_chunk_mesh);
+        TEST_ASSERT(chunk_mesh->vertices_count == expected_chunk_mesh->vertices_count);
+        TEST_ASSERT(!memcmp(chunk_mesh->vertices, expected_chunk_mesh->vertices, chunk_mesh->vertices_count * CHUNK_MESH_VERTEX_SIZE * sizeof(float)));
+        faces_count += chunk_mesh->vertices_count / CHUNK_MESH_FACE_VERTICES_COUNT;
+    }
+    printf("compare | %d random chunks | %ld faces the same as the block by block mesh\n", CHUNK_MESH_TEST_CHUNKS_COUNT, faces_count);
+    chunk_mesh_free(chunk_mesh);
+    chunk_mesh_free(expected_chunk_mesh);
+    free(chunks);
+}
+
+// Time the face rows and the mesh of a terrain like chunk and of a random chunk with half air
+void chunk_mesh_test_benchmark(char* name, bool is_terrain) {
+    ChunkMeshTestChunks* chunks = calloc(1, sizeof(ChunkMeshTestChunks));
+    if (is_terrain) {
+        for (int i = 0; i < CHUNK_DATA_SIZE; i++) {
+            chunks->chunk_data[i] = i / CHUNK_SIZE % CHUNK_SIZE < 8 ? BLOCK_TYPE_STONE : BLOCK_TYPE_AIR;
+        }
+    } else {
+        chunk_mesh_test_fill(chunks->chunk_data, 50);
+    }
+
+    uint16_t border_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE] = { { 0 } };
+    uint16_t face_rows[BLOCK_SIDE_SIZE][CHUNK_SIZE * CHUNK_SIZE];
+    ChunkMesh* chunk_mesh = chunk_mesh_new();
+    double time = test_get_time();
+    for (int i = 0; i < CHUNK_MESH_TEST_BENCHMARK_ROUNDS_COUNT * 64; i++) {
+        chunk_get_face_rows(chunks->chunk_data, border_rows, face_rows);
+        chunk_build_mesh(chunk_mesh, 0, 0, 0, chunks->chunk_data, face_rows);
+    }
+    time = (test_get_time() - time) / (CHUNK_MESH_TEST_BENCHMARK_ROUNDS_COUNT * 64);
+    printf("%-7s | %d faces %.1f KB of vertices | %.1f us per mesh\n", name, chunk_mesh->vertices_count / CHUNK_MESH_FACE_VERTICES_COUNT,
+        chunk_mesh->vertices_count * CHUNK_MESH_VERTEX_SIZE * sizeof(float) / 1024.0, time * 1e6);
+    chunk_mesh_free(chunk_mesh);
+    free(chunks);
+}
+
+int main(void) {
+    log_init();
+    chunk_init_slabs();
+    slab_thread_start();
+
+    chunk_mesh_test_block();
+    chunk_mesh_test_solid();
+    chunk_mesh_test_compare();
+    chunk_mesh_test_benchmark("terrain", true);
+    chunk_mesh_test_benchmark("random", false);
+
+    slab_thread_stop();
+    log_close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+// PlaatCraft - Database SQLite Test
+
+#include "test.h"
+#include <string.h>
+#include <sqlite3.h>
+#include "chunk_codec.h"
+#include "database.h"
+#include "database_sqlite.h"
+#include "geometry/block.h"
+#include "log.h"
+
+#define DATABASE_SQLITE_TEST_PATH "database_sqlite_test_world.db"
+#define DATABASE_SQLITE_TEST_KEYS_COUNT 1000000
+#define DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT 100000
+#define DATABASE_SQLITE_TEST_LOADS_COUNT 20000
+#define DATABASE_SQLITE_TEST_MAX_COORDINATE ((1 << 20) - 1) // The largest coordinate that fits in 21 bits
+
+// The chunks of the migration test, the corners of the 21 bits coordinate range and some chunks around zero
+int database_sqlite_test_positions[][3] = {
+    { 0, 0, 0 },
+    { -1, -1, -1 },
+    { 1, -2, 3 },
+    { -5, 4, -3 },
+    { DATABASE_SQLITE_TEST_MAX_COORDINATE, 0, 0 },
+    { 0, DATABASE_SQLITE_TEST_MAX_COORDINATE, 0 },
+    { 0, 0, DATABASE_SQLITE_TEST_MAX_COORDINATE },
+    { -DATABASE_SQLITE_TEST_MAX_COORDINATE - 1, 0, 0 },
+    { 0, -DATABASE_SQLITE_TEST_MAX_COORDINATE - 1, 0 },
+    { 0, 0, -DATABASE_SQLITE_TEST_MAX_COORDINATE - 1 },
+    { DATABASE_SQLITE_TEST_MAX_COORDINATE, -DATABASE_SQLITE_TEST_MAX_COORDINATE - 1, DATABASE_SQLITE_TEST_MAX_COORDINATE },
+    { -DATABASE_SQLITE_TEST_MAX_COORDINATE - 1, DATABASE_SQLITE_TEST_MAX_COORDINATE, -DATABASE_SQLITE_TEST_MAX_COORDINATE - 1 },
+    { 123456, -654321, 1000 },
+    { -999999, 999999, -1 }
+};
+
+#define DATABASE_SQLITE_TEST_POSITIONS_COUNT (int)(sizeof(database_sqlite_test_positions) / sizeof(database_sqlite_test_positions[0]))
+
+// Encode a test chunk whose blocks depend on its position so a chunk at the wrong key is found
+int database_sqlite_test_encode_chunk(int chunk_x, int chunk_y, int chunk_z, uint8_t* buffer) {
+    uint16_t chunk_data[CHUNK_DATA_SIZE];
+    uint32_t hash = (uint32_t)chunk_x * 0x8da6b343 ^ (uint32_t)chunk_y * 0xd8163841 ^ (uint32_t)chunk_z * 0xcb1ab31f;
+    for (int i = 0; i < CHUNK_DATA_SIZE; i++) {
+        chunk_data[i] = i / CHUNK_SIZE % CHUNK_SIZE < (int)(hash % CHUNK_SIZE) ? BLOCK_TYPE_STONE : BLOCK_TYPE_AIR;
+    }
+    chunk_data[hash % CHUNK_DATA_SIZE] = 1 + (hash >> 8) % (BLOCK_TYPE_SIZE - 1);
+    return chunk_codec_encode(chunk_data, buffer);
+}
+
+void database_sqlite_test_remove_world(void) {
+    remove(DATABASE_SQLITE_TEST_PATH);
+    remove(DATABASE_SQLITE_TEST_PATH "-wal");
+    remove(DATABASE_SQLITE_TEST_PATH "-shm");
+}
+
+void database_sqlite_test_exec(sqlite3* database, char* query) {
+    char* error_message = NULL;
+    if (sqlite3_exec(database, query, NULL, NULL, &error_message) != SQLITE_OK) {
+        fprintf(stderr, "%s\n", error_message);
+        TEST_ASSERT(false);
+    }
+}
+
+// Create a world database of schema version 1 like the first versions did, with a x, y and z column
+sqlite3* database_sqlite_test_create_v1(void) {
+    database_sqlite_test_remove_world();
+    sqlite3* database;
+    TEST_ASSERT(sqlite3_open(DATABASE_SQLITE_TEST_PATH, &database) == SQLITE_OK);
+    database_sqlite_test_exec(database,
+        "CREATE TABLE [settings] ([key] VARCHAR(32) UNIQUE NOT NULL, [value] VARCHAR(255) NOT NULL);"
+        "CREATE TABLE [chunks] ([x] INT NOT NULL, [y] INT NOT NULL, [z] INT NOT NULL, [data] BLOB NOT NULL, UNIQUE([x], [y], [z]));"
+        "INSERT INTO [settings] ([key], [value]) VALUES ('seed', '1234')");
+    return database;
+}
+
+// Insert a chunk in a schema version 1 database
+void database_sqlite_test_insert_v1(sqlite3_stmt* statement, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size) {
+    sqlite3_reset(statement);
+    sqlite3_bind_int(statement, 1, chunk_x);
+    sqlite3_bind_int(statement, 2, chunk_y);
+    sqlite3_bind_int(statement, 3, chunk_z);
+    sqlite3_bind_blob(statement, 4, compressed_data, compressed_size, SQLITE_STATIC);
+    TEST_ASSERT(sqlite3_step(statement) == SQLITE_DONE);
+}
+
+// Every packed key must give back the same coordinates
+void database_sqlite_test_keys(void) {
+    for (int i = 0; i < DATABASE_SQLITE_TEST_POSITIONS_COUNT; i++) {
+        int* position = database_sqlite_test_positions[i];
+        int chunk_x, chunk_y, chunk_z;
+        database_get_chunk_position(database_get_chunk_key(position[0], position[1], position[2]), &chunk_x, &chunk_y, &chunk_z);
+        TEST_ASSERT(chunk_x == position[0] && chunk_y == position[1] && chunk_z == position[2]);
+    }
+
+    srand(DATABASE_SQLITE_TEST_KEYS_COUNT);
+    for (int i = 0; i < DATABASE_SQLITE_TEST_KEYS_COUNT; i++) {
+        int position[3];
+        for (int j = 0; j < 3; j++) {
+            position[j] = (rand() % (DATABASE_SQLITE_TEST_MAX_COORDINATE + 1)) * (rand() % 2 == 0 ? 1 : -1);
+        }
+        int64_t key = database_get_chunk_key(position[0], position[1], position[2]);
+        TEST_ASSERT(key >= 0);
+        int chunk_x, chunk_y, chunk_z;
+        database_get_chunk_position(key, &chunk_x, &chunk_y, &chunk_z);
+        TEST_ASSERT(chunk_x == position[0] && chunk_y == position[1] && chunk_z == position[2]);
+    }
+}
+
+void database_sqlite_test_iterate_callback(void* argument, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size) {
+    int found_index = -1;
+    for (int i = 0; i < DATABASE_SQLITE_TEST_POSITIONS_COUNT; i++) {
+        int* position = database_sqlite_test_positions[i];
+        if (position[0] == chunk_x && position[1] == chunk_y && position[2] == chunk_z) {
+            found_index = i;
+        }
+    }
+    TEST_ASSERT(found_index != -1);
+
+    uint8_t buffer[CHUNK_CODEC_MAX_SIZE];
+    int size = database_sqlite_test_encode_chunk(chunk_x, chunk_y, chunk_z, buffer);
+    TEST_ASSERT(compressed_size == size && !memcmp(compressed_data, buffer, size));
+    ((bool*)argument)[found_index] = true;
+}
+
+// Migrate a schema version 1 world with chunks at negative and large coordinates and find them all again
+void database_sqlite_test_migrate(void) {
+    sqlite3* database = database_sqlite_test_create_v1();
+    sqlite3_stmt* insert_statement;
+    sqlite3_prepare_v2(database, "INSERT INTO [chunks] ([x], [y], [z], [data]) VALUES (?, ?, ?, ?)", -1, &insert_statement, NULL);
+    for (int i = 0; i < DATABASE_SQLITE_TEST_POSITIONS_COUNT; i++) {
+        int* position = database_sqlite_test_positions[i];
+        uint8_t buffer[CHUNK_CODEC_MAX_SIZE];
+        int size = database_sqlite_test_encode_chunk(position[0], position[1], position[2], buffer);
+        database_sqlite_test_insert_v1(insert_statement, position[0], position[1], position[2], buffer, size);
+    }
+    sqlite3_finalize(insert_statement);
+    sqlite3_close(database);
+
+    void* backend = DATABASE_BACKEND_SQLITE.open(DATABASE_SQLITE_TEST_PATH);
+    char* seed = DATABASE_BACKEND_SQLITE.get_setting(backend, "seed");
+    TEST_ASSERT(seed != NULL && !strcmp(seed, "1234"));
+    free(seed);
+
+    for (int i = 0; i < DATABASE_SQLITE_TEST_POSITIONS_COUNT; i++) {
+        int* position = database_sqlite_test_positions[i];
+        uint8_t buffer[CHUNK_CODEC_MAX_SIZE];
+        uint16_t expected_chunk_data[CHUNK_DATA_SIZE];
+        uint16_t chunk_data[CHUNK_DATA_SIZE];
+        int size = database_sqlite_test_encode_chunk(position[0], position[1], position[2], buffer);
+        TEST_ASSERT(chunk_codec_decode(buffer, size, expected_chunk_data));
+        TEST_ASSERT(DATABASE_BACKEND_SQLITE.get_chunk(backend, position[0], position[1], position[2], chunk_data));
+        TEST_ASSERT(!memcmp(chunk_data, expected_chunk_data, sizeof(chunk_data)));
+    }
+    uint16_t chunk_data[CHUNK_DATA_SIZE];
+    TEST_ASSERT(!DATABASE_BACKEND_SQLITE.get_chunk(backend, 2, 2, 2, chunk_data));
+
+    bool is_found[DATABASE_SQLITE_TEST_POSITIONS_COUNT] = { false };
+    DATABASE_BACKEND_SQLITE.iterate_chunks(backend, database_sqlite_test_iterate_callback, is_found);
+    for (int i = 0; i < DATABASE_SQLITE_TEST_POSITIONS_COUNT; i++) {
+        TEST_ASSERT(is_found[i]);
+    }
+    DATABASE_BACKEND_SQLITE.close(backend);
+
+    // The migrated world has schema version 2 and the chunks table has only the key and the data
+    TEST_ASSERT(sqlite3_open(DATABASE_SQLITE_TEST_PATH, &database) == SQLITE_OK);
+    sqlite3_stmt* statement;
+    sqlite3_prepare_v2(database, "PRAGMA user_version", -1, &statement, NULL);
+    TEST_ASSERT(sqlite3_step(statement) == SQLITE_ROW && sqlite3_column_int(statement, 0) == DATABASE_SCHEMA_VERSION);
+    sqlite3_finalize(statement);
+    TEST_ASSERT(sqlite3_prepare_v2(database, "SELECT [x] FROM [chunks]", -1, &statement, NULL) != SQLITE_OK);
+    sqlite3_finalize(statement);
+    sqlite3_close(database);
+    database_sqlite_test_remove_world();
+}
+
+// Get a random position of the benchmark chunks, they are spread over a large area around zero
+void database_sqlite_test_get_benchmark_position(int i, int* chunk_x, int* chunk_y, int* chunk_z) {
+    uint32_t hash = (uint32_t)i * 0x9e3779b9;
+    hash ^= hash >> 16;
+    *chunk_x = (int)(hash % 4096) - 2048;
+    *chunk_y = (int)(i % 16) - 8;
+    *chunk_z = i / 16 - DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT / 32;
+}
+
+// Write 100k chunks to a schema version 1 world, time the loads, migrate it and time the same loads on schema version 2
+void database_sqlite_test_benchmark(void) {
+    uint8_t buffer[CHUNK_CODEC_MAX_SIZE];
+    int size = database_sqlite_test_encode_chunk(1, 2, 3, buffer);
+
+    sqlite3* database = database_sqlite_test_create_v1();
+    sqlite3_stmt* insert_statement;
+    sqlite3_prepare_v2(database, "INSERT INTO [chunks] ([x], [y], [z], [data]) VALUES (?, ?, ?, ?)", -1, &insert_statement, NULL);
+    double v1_put_time = test_get_time();
+    database_sqlite_test_exec(database, "BEGIN");
+    for (int i = 0; i < DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT; i++) {
+        int chunk_x, chunk_y, chunk_z;
+        database_sqlite_test_get_benchmark_position(i, &chunk_x, &chunk_y, &chunk_z);
+        database_sqlite_test_insert_v1(insert_statement, chunk_x, chunk_y, chunk_z, buffer, size);
+    }
+    database_sqlite_test_exec(database, "COMMIT");
+    v1_put_time = test_get_time() - v1_put_time;
+    sqlite3_finalize(insert_statement);
+
+    sqlite3_stmt* select_statement;
+    sqlite3_prepare_v2(database, "SELECT [data] FROM [chunks] WHERE [x] = ? AND [y] = ? AND [z] = ?", -1, &select_statement, NULL);
+    srand(DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT);
+    double v1_load_time = test_get_time();
+    for (int i = 0; i < DATABASE_SQLITE_TEST_LOADS_COUNT; i++) {
+        int chunk_x, chunk_y, chunk_z;
+        database_sqlite_test_get_benchmark_position(rand() % DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT, &chunk_x, &chunk_y, &chunk_z);
+        sqlite3_bind_int(select_statement, 1, chunk_x);
+        sqlite3_bind_int(select_statement, 2, chunk_y);
+        sqlite3_bind_int(select_statement, 3, chunk_z);
+        TEST_ASSERT(sqlite3_step(select_statement) == SQLITE_ROW);
+        uint16_t chunk_data[CHUNK_DATA_SIZE];
+        TEST_ASSERT(chunk_codec_decode((uint8_t*)sqlite3_column_blob(select_statement, 0), sqlite3_column_bytes(select_statement, 0), chunk_data));
+        sqlite3_reset(select_statement);
+    }
+    v1_load_time = test_get_time() - v1_load_time;
+    sqlite3_finalize(select_statement);
+    sqlite3_close(database);
+
+    double migrate_time = test_get_time();
+    void* backend = DATABASE_BACKEND_SQLITE.open(DATABASE_SQLITE_TEST_PATH);
+    migrate_time = test_get_time() - migrate_time;
+
+    srand(DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT);
+    double v2_load_time = test_get_time();
+    for (int i = 0; i < DATABASE_SQLITE_TEST_LOADS_COUNT; i++) {
+        int chunk_x, chunk_y, chunk_z;
+        database_sqlite_test_get_benchmark_position(rand() % DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT, &chunk_x, &chunk_y, &chunk_z);
+        uint16_t chunk_data[CHUNK_DATA_SIZE];
+        TEST_ASSERT(DATABASE_BACKEND_SQLITE.get_chunk(backend, chunk_x, chunk_y, chunk_z, chunk_data));
+    }
+    v2_load_time = test_get_time() - v2_load_time;
+
+    // Rewrite all chunks as upserts in one batch like the writer thread does
+    DatabaseChunkWrite* writes = malloc(DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT * sizeof(DatabaseChunkWrite));
+    for (int i = 0; i < DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT; i++) {
+        database_sqlite_test_get_benchmark_position(i, &writes[i].x, &writes[i].y, &writes[i].z);
+        writes[i].compressed_data = buffer;
+        writes[i].compressed_size = size;
+    }
+    double v2_put_time = test_get_time();
+    DATABASE_BACKEND_SQLITE.put_chunks(backend, writes, DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT);
+    v2_put_time = test_get_time() - v2_put_time;
+    free(writes);
+    DATABASE_BACKEND_SQLITE.close(backend);
+
+    printf("schema 1 | %d chunks | insert %.1f ms | load %.2f us\n", DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT,
+        v1_put_time * 1000, v1_load_time / DATABASE_SQLITE_TEST_LOADS_COUNT * 1e6);
+    printf("schema 2 | %d chunks | migrate %.1f ms | upsert %.1f ms | load %.2f us\n", DATABASE_SQLITE_TEST_BENCHMARK_CHUNKS_COUNT,
+        migrate_time * 1000, v2_put_time * 1000, v2_load_time / DATABASE_SQLITE_TEST_LOADS_COUNT * 1e6);
+    database_sqlite_test_remove_world();
+}
+
+int main(void) {
+    log_init();
+    database_sqlite_test_keys();
+    database_sqlite_test_migrate();
+    database_sqlite_test_benchmark();
+    log_close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,295 @@
+// PlaatCraft - Database Test
+
+#include "test.h"
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "chunk_codec.h"
+#include "database.h"
+#include "database_memory.h"
+#include "database_region.h"
+#include "database_sqlite.h"
+#include "log.h"
+#include "slab.h"
+
+#define DATABASE_TEST_SIZE 16 // Chunks per side of the test world
+#define DATABASE_TEST_CHUNKS_COUNT (DATABASE_TEST_SIZE * DATABASE_TEST_SIZE * DATABASE_TEST_SIZE)
+#define DATABASE_TEST_LOADS_COUNT 20000
+#define DATABASE_TEST_REWRITES_COUNT 3
+#define DATABASE_TEST_WRITER_Y 1000 // The writer of the latency benchmark writes chunks above the test world
+
+// Fill the blocks of a test chunk, every chunk gets other blocks so a mixed up chunk is found
+void database_test_fill_chunk(uint16_t* chunk_data, int chunk_x, int chunk_y, int chunk_z, int version) {
+    uint32_t hash = (uint32_t)chunk_x * 0x8da6b343 ^ (uint32_t)chunk_y * 0xd8163841 ^ (uint32_t)chunk_z * 0xcb1ab31f ^ (uint32_t)version * 0x9e3779b9;
+    int height = hash % CHUNK_SIZE;
+    for (int i = 0; i < CHUNK_DATA_SIZE; i++) {
+        int block_y = i / CHUNK_SIZE % CHUNK_SIZE;
+        chunk_data[i] = block_y < height ? 1 + (hash >> 8) % 4 : BLOCK_TYPE_AIR;
+    }
+    for (int i = 0; i < 16; i++) {
+        hash = hash * 1664525 + 1013904223;
+        chunk_data[(hash >> 8) % CHUNK_DATA_SIZE] = 1 + (hash >> 20) % (BLOCK_TYPE_SIZE - 1);
+    }
+}
+
+// Check that a loaded chunk has the blocks of its test chunk
+void database_test_check_chunk(Chunk* chunk, int version) {
+    TEST_ASSERT(chunk != NULL);
+    uint16_t chunk_data[CHUNK_DATA_SIZE];
+    uint16_t expected_chunk_data[CHUNK_DATA_SIZE];
+    chunk_storage_decode(chunk->storage, chunk_data);
+    database_test_fill_chunk(expected_chunk_data, chunk->x, chunk->y, chunk->z, version);
+    TEST_ASSERT(!memcmp(chunk_data, expected_chunk_data, sizeof(chunk_data)));
+    chunk_free(chunk);
+}
+
+// Put all test chunks in the write behind buffer
+void database_test_put_chunks(Database* database, int version) {
+    for (int i = 0; i < DATABASE_TEST_CHUNKS_COUNT; i++) {
+        int chunk_x = i % DATABASE_TEST_SIZE;
+        int chunk_y = i / DATABASE_TEST_SIZE % DATABASE_TEST_SIZE - DATABASE_TEST_SIZE / 2;
+        int chunk_z = -(i / (DATABASE_TEST_SIZE * DATABASE_TEST_SIZE));
+        uint16_t chunk_data[CHUNK_DATA_SIZE];
+        database_test_fill_chunk(chunk_data, chunk_x, chunk_y, chunk_z, version);
+        Chunk* chunk = chunk_new_from_data(chunk_x, chunk_y, chunk_z, chunk_data);
+        database_chunks_set_chunk(database, chunk);
+        chunk_free(chunk);
+    }
+}
+
+// Wait until the writer thread wrote all buffered chunks to the backend
+void database_test_wait_flushed(Database* database) {
+    for (;;) {
+        mtx_lock(&database->writes_lock);
+        bool is_flushed = database->writes_count == 0 && database->flushing_writes_count == 0;
+        mtx_unlock(&database->writes_lock);
+        if (is_flushed) {
+            return;
+        }
+        struct timespec sleep_time = { 0, 1000000 };
+        thrd_sleep(&sleep_time, NULL);
+    }
+}
+
+// Count the iterated chunks and check that they decode
+void database_test_iterate_callback(void* argument, int chunk_x, int chunk_y, int chunk_z, uint8_t* compressed_data, int compressed_size) {
+    (void)chunk_x;
+    (void)chunk_y;
+    (void)chunk_z;
+    uint16_t chunk_data[CHUNK_DATA_SIZE];
+    TEST_ASSERT(chunk_codec_decode(compressed_data, compressed_size, chunk_data));
+    (*(int*)argument)++;
+}
+
+// Load random chunks of the first version and store the latency of every load
+void database_test_load_chunks(Database* database, double* latencies) {
+    for (int i = 0; i < DATABASE_TEST_LOADS_COUNT; i++) {
+        int chunk_index = rand() % DATABASE_TEST_CHUNKS_COUNT;
+        double time = test_get_time();
+        Chunk* chunk = database_chunks_get_chunk(database,
+            chunk_index % DATABASE_TEST_SIZE,
+            chunk_index / DATABASE_TEST_SIZE % DATABASE_TEST_SIZE - DATABASE_TEST_SIZE / 2,
+            -(chunk_index / (DATABASE_TEST_SIZE * DATABASE_TEST_SIZE)));
+        latencies[i] = test_get_time() - time;
+        database_test_check_chunk(chunk, 0);
+    }
+}
+
+int database_test_compare_latencies(const void* a, const void* b) {
+    double latency_a = *(double*)a;
+    double latency_b = *(double*)b;
+    return (latency_a > latency_b) - (latency_a < latency_b);
+}
+
+// Sort the latencies and get the latency that the given percentage of the loads is below
+double database_test_get_percentile(double* latencies, int percentage) {
+    qsort(latencies, DATABASE_TEST_LOADS_COUNT, sizeof(double), database_test_compare_latencies);
+    return latencies[DATABASE_TEST_LOADS_COUNT * percentage / 100];
+}
+
+typedef struct DatabaseTestWriter {
+    Database* database;
+    bool is_running;
+    int writes_count;
+} DatabaseTestWriter;
+
+// Write a heavy stream of chunks next to the test world until the loads are done, the write behind
+// buffer fills up so the writer thread of the database flushes all the time
+int database_test_writer_thread(void* argument) {
+    DatabaseTestWriter* writer = argument;
+    int writes_count = 0;
+    while (__atomic_load_n(&writer->is_running, __ATOMIC_ACQUIRE)) {
+        int chunk_x = writes_count % DATABASE_TEST_SIZE;
+        int chunk_y = DATABASE_TEST_WRITER_Y + writes_count / DATABASE_TEST_SIZE % DATABASE_TEST_SIZE;
+        int chunk_z = writes_count / (DATABASE_TEST_SIZE * DATABASE_TEST_SIZE) % DATABASE_TEST_SIZE;
+        uint16_t chunk_data[CHUNK_DATA_SIZE];
+        database_test_fill_chunk(chunk_data, chunk_x, chunk_y, chunk_z, writes_count);
+        Chunk* chunk = chunk_new_from_data(chunk_x, chunk_y, chunk_z, chunk_data);
+        database_chunks_set_chunk(writer->database, chunk);
+        chunk_free(chunk);
+        writes_count++;
+    }
+    writer->writes_count = writes_count;
+    return EXIT_SUCCESS;
+}
+
+// Get the size of a world file or the sum of the files in a world directory
+long database_test_get_world_size(char* path) {
+    struct stat path_stat;
+    if (stat(path, &path_stat) != 0) {
+        return 0;
+    }
+    if (!S_ISDIR(path_stat.st_mode)) {
+        return path_stat.st_size;
+    }
+
+    long world_size = 0;
+    DIR* directory = opendir(path);
+    struct dirent* directory_entry;
+    while ((directory_entry = readdir(directory)) != NULL) {
+        char file_path[512];
+        sprintf(file_path, "%s/%s", path, directory_entry->d_name);
+        if (stat(file_path, &path_stat) == 0 && !S_ISDIR(path_stat.st_mode)) {
+            world_size += path_stat.st_size;
+        }
+    }
+    closedir(directory);
+    return world_size;
+}
+
+// Remove the world file or directory of an earlier run
+void database_test_remove_world(char* path) {
+    char file_path[512];
+    sprintf(file_path, "%s-wal", path);
+    remove(file_path);
+    sprintf(file_path, "%s-shm", path);
+    remove(file_path);
+
+    DIR* directory = opendir(path);
+    if (directory != NULL) {
+        struct dirent* directory_entry;
+        while ((directory_entry = readdir(directory)) != NULL) {
+            sprintf(file_path, "%s/%s", path, directory_entry->d_name);
+            remove(file_path);
+        }
+        closedir(directory);
+        rmdir(path);
+    } else {
+        remove(path);
+    }
+}
+
+// Run the same checks and benchmarks against a storage backend, the persistent backends are reopened
+// to check that the chunks and the settings are stored and rewritten chunks must not grow the world much
+void database_test_backend(DatabaseBackendType* backend_type, char* path) {
+    bool is_persistent = backend_type != &DATABASE_BACKEND_MEMORY;
+    database_test_remove_world(path);
+    Database* database = database_new(path, backend_type);
+
+    // Settings
+    database_settings_set_int(database, "seed", 1234);
+    database_settings_set_string(database, "name", "test");
+    TEST_ASSERT(database_settings_get_int(database, "seed", 0) == 1234);
+    TEST_ASSERT(database_settings_get_int(database, "missing", 42) == 42);
+
+    // Puts, the first version replaces a newer version in the write behind buffer and is also loaded from it
+    database_test_put_chunks(database, 1);
+    double put_time = test_get_time();
+    database_test_put_chunks(database, 0);
+    put_time = test_get_time() - put_time;
+    database_test_check_chunk(database_chunks_get_chunk(database, 1, 0, -1), 0);
+    double flush_time = test_get_time();
+    database_test_wait_flushed(database);
+    flush_time = test_get_time() - flush_time;
+
+    // Hit and miss loads of random chunks
+    srand(DATABASE_TEST_CHUNKS_COUNT);
+    double* latencies = malloc(DATABASE_TEST_LOADS_COUNT * sizeof(double));
+    double hit_load_time = test_get_time();
+    database_test_load_chunks(database, latencies);
+    hit_load_time = test_get_time() - hit_load_time;
+    double hit_load_p50 = database_test_get_percentile(latencies, 50);
+    double hit_load_p99 = database_test_get_percentile(latencies, 99);
+
+    double miss_load_time = test_get_time();
+    for (int i = 0; i < DATABASE_TEST_LOADS_COUNT; i++) {
+        TEST_ASSERT(database_chunks_get_chunk(database, rand() % 1000 - 500, DATABASE_TEST_SIZE + rand() % 100, rand() % 1000) == NULL);
+    }
+    miss_load_time = test_get_time() - miss_load_time;
+
+    // Hit loads while an other thread writes a heavy stream of chunks
+    DatabaseTestWriter writer = { database, true, 0 };
+    thrd_t writer_thread;
+    thrd_create(&writer_thread, database_test_writer_thread, &writer);
+    double writing_load_time = test_get_time();
+    database_test_load_chunks(database, latencies);
+    writing_load_time = test_get_time() - writing_load_time;
+    __atomic_store_n(&writer.is_running, false, __ATOMIC_RELEASE);
+    thrd_join(writer_thread, NULL);
+    database_test_wait_flushed(database);
+    double writing_load_p50 = database_test_get_percentile(latencies, 50);
+    double writing_load_p99 = database_test_get_percentile(latencies, 99);
+    free(latencies);
+
+    // Iterate over all chunks, a region file that can't be opened is skipped
+    if (backend_type == &DATABASE_BACKEND_REGION) {
+        char region_path[512];
+        sprintf(region_path, "%s/r.99.99.99.region", path);
+        mkdir(region_path, 0755);
+    }
+    int chunks_count = 0;
+    double iterate_time = test_get_time();
+    database_chunks_iterate(database, database_test_iterate_callback, &chunks_count);
+    iterate_time = test_get_time() - iterate_time;
+    TEST_ASSERT(chunks_count == DATABASE_TEST_CHUNKS_COUNT + (writer.writes_count < DATABASE_TEST_CHUNKS_COUNT ? writer.writes_count : DATABASE_TEST_CHUNKS_COUNT));
+
+    // Rewrite all chunks a few times and reopen the world between the rewrites
+    long world_size = 0;
+    if (is_persistent) {
+        database_free(database);
+        world_size = database_test_get_world_size(path);
+        for (int version = 1; version <= DATABASE_TEST_REWRITES_COUNT; version++) {
+            database = database_new(path, backend_type);
+            TEST_ASSERT(database_settings_get_int(database, "seed", 0) == 1234);
+            database_test_check_chunk(database_chunks_get_chunk(database, 3, -2, -5), version - 1);
+            database_test_put_chunks(database, version);
+            database_test_wait_flushed(database);
+            database_test_check_chunk(database_chunks_get_chunk(database, 3, -2, -5), version);
+            database_free(database);
+        }
+    } else {
+        database_free(database);
+    }
+    long rewritten_world_size = database_test_get_world_size(path);
+    if (is_persistent) {
+        TEST_ASSERT(rewritten_world_size <= world_size * 2);
+    }
+
+    printf(
+        "%-6s | %d puts %.1f ms + flush %.1f ms | hit load %.2f us | miss load %.2f us | iterate %.1f ms | world %ld KB, rewritten %d times %ld KB\n",
+        backend_type->name, DATABASE_TEST_CHUNKS_COUNT, put_time * 1000, flush_time * 1000,
+        hit_load_time / DATABASE_TEST_LOADS_COUNT * 1e6, miss_load_time / DATABASE_TEST_LOADS_COUNT * 1e6,
+        iterate_time * 1000, world_size / 1024, DATABASE_TEST_REWRITES_COUNT, rewritten_world_size / 1024
+    );
+    printf(
+        "%-6s | hit load p50 %.2f us p99 %.2f us | while writing %d chunks: load %.2f us p50 %.2f us p99 %.2f us\n",
+        backend_type->name, hit_load_p50 * 1e6, hit_load_p99 * 1e6, writer.writes_count,
+        writing_load_time / DATABASE_TEST_LOADS_COUNT * 1e6, writing_load_p50 * 1e6, writing_load_p99 * 1e6
+    );
+    database_test_remove_world(path);
+}
+
+int main(void) {
+    log_init();
+    chunk_init_slabs();
+    slab_thread_start();
+
+    database_test_backend(&DATABASE_BACKEND_SQLITE, "database_test_world.db");
+    database_test_backend(&DATABASE_BACKEND_REGION, "database_test_world");
+    database_test_backend(&DATABASE_BACKEND_MEMORY, "");
+
+    slab_thread_stop();
+    log_close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+// PlaatCraft - Generator Test
+
+#include "test.h"
+#include <string.h>
+#include "chunk.h"
+#include "log.h"
+#include "world.h"
+
+#define GENERATOR_TEST_SIZE 12 // Chunk columns per side of the test area
+#define GENERATOR_TEST_MIN_Y -3 // The test area goes from solid chunks to empty chunks
+#define GENERATOR_TEST_MAX_Y 2
+#define GENERATOR_TEST_CHUNKS_COUNT (GENERATOR_TEST_SIZE * GENERATOR_TEST_SIZE * (GENERATOR_TEST_MAX_Y - GENERATOR_TEST_MIN_Y + 1))
+
+// The block generator before the column generator, it evaluates the height and dryness noise for every block
+BlockType generator_test_generate_block(PerlinNoise* perlin, Random *random, int x, int y, int z) {
+    float scale = 64;
+    int max_height = 24;
+    int sea_level = -5;
+    int height = perlin_noise(perlin, (float)x / scale, 1, (float)z / scale) * max_height;
+    if (height < sea_level) height = sea_level;
+    int dryness = perlin_noise(perlin, (float)(x + 1000000) / scale, 1, (float)(z + 1000000) / scale) * (max_height / 2);
+    return chunk_generate_block(random, height, dryness, y);
+}
+
+// The chunk generator before the column generator, it generates every block of the chunk in z, y, x order
+void generator_test_generate_chunk(PerlinNoise* perlin, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data) {
+    memset(chunk_data, BLOCK_TYPE_AIR, CHUNK_DATA_SIZE * sizeof(uint16_t));
+    Random *random = random_new(chunk_x + chunk_y + chunk_z);
+    for (int block_z = 0; block_z < CHUNK_SIZE; block_z++) {
+        for (int block_y = 0; block_y < CHUNK_SIZE; block_y++) {
+            for (int block_x = 0; block_x < CHUNK_SIZE; block_x++) {
+                int block_index = block_z * CHUNK_SIZE * CHUNK_SIZE + block_y * CHUNK_SIZE + block_x;
+                BlockType blockType = generator_test_generate_block(perlin, random,
+                    chunk_x * CHUNK_SIZE + block_x, chunk_y * CHUNK_SIZE + block_y, chunk_z * CHUNK_SIZE + block_z);
+                if (blockType == BLOCK_TYPE_AIR) {
+                    if (
+                        chunk_data[block_index] != BLOCK_TYPE_OAK_TRUNK &&
+                        chunk_data[block_index] != BLOCK_TYPE_BEECH_TRUNK &&
+                        chunk_data[block_index] != BLOCK_TYPE_GREEN_LEAVES &&
+                        chunk_data[block_index] != BLOCK_TYPE_ORANGE_LEAVES &&
+                        chunk_data[block_index] != BLOCK_TYPE_CACTUS
+                    ) {
+                        chunk_data[block_index] = BLOCK_TYPE_AIR;
+                    }
+                } else {
+                    chunk_data[block_index] = blockType;
+                }
+
+                if (
+                    blockType == BLOCK_TYPE_GRASS && random_rand(random, 1, 75) == 1 &&
+                    block_x >= 2 && block_x <= CHUNK_SIZE - 2 &&
+                    block_y >= 1 && block_y <= CHUNK_SIZE - 7 &&
+                    block_z >= 2 && block_z <= CHUNK_SIZE - 2
+                ) {
+                    bool oak_type = random_rand(random, 1, 2) == 1;
+                    bool leave_type = random_rand(random, 1, 2) == 1;
+                    for (int tree_y = 1; tree_y < 6; tree_y++) {
+                        if (tree_y >= 3) {
+                            for (int leave_z = -1; leave_z <= 1; leave_z++) {
+                                for (int leave_x = -1; leave_x <= 1; leave_x++) {
+                                    chunk_data[(block_z + leave_z) * CHUNK_SIZE * CHUNK_SIZE + (block_y + tree_y) * CHUNK_SIZE + (block_x + leave_x)] =
+                                        leave_z == 0 && leave_x == 0 && tree_y != 5
+                                            ? (oak_type ? BLOCK_TYPE_BEECH_TRUNK : BLOCK_TYPE_OAK_TRUNK)
+                                            : (leave_type ? BLOCK_TYPE_GREEN_LEAVES : BLOCK_TYPE_ORANGE_LEAVES);
+                                }
+                            }
+                        } else {
+                            chunk_data[block_z * CHUNK_SIZE * CHUNK_SIZE + (block_y + tree_y) * CHUNK_SIZE + block_x] =
+                                oak_type ? BLOCK_TYPE_BEECH_TRUNK : BLOCK_TYPE_OAK_TRUNK;
+                        }
+                    }
+                }
+
+                if (
+                    blockType == BLOCK_TYPE_SAND_TOP && random_rand(random, 1, 150) == 1 &&
+                    block_y >= 1 && block_y <= CHUNK_SIZE - 7
+                ) {
+                    for (int cactus_y = 1; cactus_y < 5; cactus_y++) {
+                        chunk_data[block_z * CHUNK_SIZE * CHUNK_SIZE + (block_y + cactus_y) * CHUNK_SIZE + block_x] = BLOCK_TYPE_CACTUS;
+                    }
+                }
+            }
+        }
+    }
+    random_free(random);
+}
+
+// A world with only the parts that the generator uses
+World* generator_test_world_new(int64_t seed, int generator_version) {
+    World* world = calloc(1, sizeof(World));
+    world->seed = seed;
+    world->generator_version = generator_version;
+    world->perlin = perlin_new(seed, generator_version >= 2);
+    world->column_cache = column_cache_new(WORLD_COLUMN_CACHE_COUNT);
+    return world;
+}
+
+void generator_test_world_free(World* world) {
+    perlin_free(world->perlin);
+    column_cache_free(world->column_cache);
+    free(world);
+}
+
+void generator_test_get_position(int i, int* chunk_x, int* chunk_y, int* chunk_z) {
+    *chunk_x = i % GENERATOR_TEST_SIZE - GENERATOR_TEST_SIZE / 2;
+    *chunk_z = i / GENERATOR_TEST_SIZE % GENERATOR_TEST_SIZE - GENERATOR_TEST_SIZE / 2;
+    *chunk_y = GENERATOR_TEST_MIN_Y + i / (GENERATOR_TEST_SIZE * GENERATOR_TEST_SIZE);
+}
+
+// The worlds of the sin random must generate the same blocks as before the column generator, else
+// the chunks of existing worlds don't match there neighbours anymore
+void generator_test_compare(int generator_version) {
+    World* world = generator_test_world_new(1234, generator_version);
+    int types_counts[3] = { 0 };
+    for (int i = 0; i < GENERATOR_TEST_CHUNKS_COUNT; i++) {
+        int chunk_x, chunk_y, chunk_z;
+        generator_test_get_position(i, &chunk_x, &chunk_y, &chunk_z);
+
+        uint16_t expected_chunk_data[CHUNK_DATA_SIZE];
+        generator_test_generate_chunk(world->perlin, chunk_x, chunk_y, chunk_z, expected_chunk_data);
+        Chunk* chunk = chunk_new_from_generator(world, chunk_x, chunk_y, chunk_z);
+        uint16_t chunk_data[CHUNK_DATA_SIZE];
+        chunk_storage_decode(chunk->storage, chunk_data);
+        TEST_ASSERT(!memcmp(chunk_data, expected_chunk_data, sizeof(chunk_data)));
+        chunk_free(chunk);
+
+        int min_height = INT32_MAX;
+        int max_height = INT32_MIN;
+        for (int j = 0; j < CHUNK_SIZE * CHUNK_SIZE; j++) {
+            int x = chunk_x * CHUNK_SIZE + j % CHUNK_SIZE;
+            int z = chunk_z * CHUNK_SIZE + j / CHUNK_SIZE;
+            int height = perlin_noise(world->perlin, (float)x / 64, 1, (float)z / 64) * 24;
+            if (height < -5) height = -5;
+            if (height < min_height) min_height = height;
+            if (height > max_height) max_height = height;
+        }
+        types_counts[chunk_generate_classify(chunk_y, min_height, max_height)]++;
+    }
+    TEST_ASSERT(types_counts[CHUNK_GENERATE_TYPE_EMPTY] > 0);
+    TEST_ASSERT(types_counts[CHUNK_GENERATE_TYPE_SOLID] > 0);
+    TEST_ASSERT(types_counts[CHUNK_GENERATE_TYPE_MIXED] > 0);
+    printf("compare | version %d | %d chunks the same as the block generator | %d empty %d solid %d mixed\n",
+        generator_version, GENERATOR_TEST_CHUNKS_COUNT, types_counts[CHUNK_GENERATE_TYPE_EMPTY],
+        types_counts[CHUNK_GENERATE_TYPE_SOLID], types_counts[CHUNK_GENERATE_TYPE_MIXED]);
+    generator_test_world_free(world);
+}
+
+// Generate all chunks of the test area with the block generator and the column generator, the column
+// generator starts with an empty column cache so the height maps are generated once per column
+void generator_test_benchmark(int generator_version) {
+    World* world = generator_test_world_new(1234, generator_version);
+
+    uint16_t chunk_data[CHUNK_DATA_SIZE];
+    double block_time = test_get_time();
+    for (int i = 0; i < GENERATOR_TEST_CHUNKS_COUNT; i++) {
+        int chunk_x, chunk_y, chunk_z;
+        generator_test_get_position(i, &chunk_x, &chunk_y, &chunk_z);
+        generator_test_generate_chunk(world->perlin, chunk_x, chunk_y, chunk_z, chunk_data);
+        chunk_free(chunk_new_from_data(chunk_x, chunk_y, chunk_z, chunk_data));
+    }
+    block_time = test_get_time() - block_time;
+
+    double column_time = test_get_time();
+    for (int i = 0; i < GENERATOR_TEST_CHUNKS_COUNT; i++) {
+        int chunk_x, chunk_y, chunk_z;
+        generator_test_get_position(i, &chunk_x, &chunk_y, &chunk_z);
+        chunk_free(chunk_new_from_generator(world, chunk_x, chunk_y, chunk_z));
+    }
+    column_time = test_get_time() - column_time;
+
+    printf("block   | version %d | %d chunks %.1f ms | %.0f chunks per second\n", generator_version,
+        GENERATOR_TEST_CHUNKS_COUNT, block_time * 1000, GENERATOR_TEST_CHUNKS_COUNT / block_time);
+    printf("column  | version %d | %d chunks %.1f ms | %.0f chunks per second | %.2fx the block generator\n", generator_version,
+        GENERATOR_TEST_CHUNKS_COUNT, column_time * 1000, GENERATOR_TEST_CHUNKS_COUNT / column_time, block_time / column_time);
+    generator_test_world_free(world);
+}
+
+int main(void) {
+    log_init();
+    chunk_init_slabs();
+    slab_thread_start();
+
+    generator_test_compare(1);
+    generator_test_compare(2);
+    generator_test_benchmark(2);
+
+    slab_thread_stop();
+    log_close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+// PlaatCraft - Perlin Noise Test
+
+#include "test.h"
+#include "perlin/perlin.h"
+
+#define PERLIN_TEST_POINTS_COUNT (1 << 20)
+#define PERLIN_TEST_BENCHMARK_ROUNDS_COUNT 8
+
+typedef void (*PerlinTestBatch)(PerlinNoise* perlin, double* x, double* y, double* z, double* noises, int count);
+
+// Evaluate the points one by one with the scalar noise, this is what the batches must match
+void perlin_test_noise_scalar(PerlinNoise* perlin, double* x, double* y, double* z, double* noises, int count) {
+    for (int i = 0; i < count; i++) {
+        noises[i] = perlin_noise(perlin, x[i], y[i], z[i]);
+    }
+}
+
+// Fill the points, the first half like the terrain generator asks them and the second half random
+// points with negative coordinates, whole numbers and points just below whole numbers
+void perlin_test_fill_points(double* x, double* y, double* z) {
+    srand(PERLIN_TEST_POINTS_COUNT);
+    for (int i = 0; i < PERLIN_TEST_POINTS_COUNT / 2; i++) {
+        int block_x = rand() % 2000000 - 1000000;
+        int block_z = rand() % 2000000 - 1000000;
+        x[i] = (float)(block_x + (i % 2) * 1000000) / 64;
+        y[i] = 1;
+        z[i] = (float)(block_z + (i % 2) * 1000000) / 64;
+    }
+    for (int i = PERLIN_TEST_POINTS_COUNT / 2; i < PERLIN_TEST_POINTS_COUNT; i++) {
+        x[i] = ((double)rand() / RAND_MAX - 0.5) * 100000;
+        y[i] = ((double)rand() / RAND_MAX - 0.5) * 512;
+        z[i] = ((double)rand() / RAND_MAX - 0.5) * 100000;
+        if (i % 7 == 0) {
+            x[i] = (int)x[i];
+        }
+        if (i % 11 == 0) {
+            z[i] = (int)z[i] - 1e-12;
+        }
+    }
+}
+
+// Compare a batch with the scalar noise, only the sign of a zero noise may differ. Odd batch sizes check the
+// leftover points of the SIMD paths
+void perlin_test_compare(char* name, PerlinTestBatch batch, PerlinNoise* perlin, double* x, double* y, double* z, double* expected_noises, double* noises) {
+    int position = 0;
+    int batch_size = 1;
+    while (position < PERLIN_TEST_POINTS_COUNT) {
+        int count = position + batch_size <= PERLIN_TEST_POINTS_COUNT ? batch_size : PERLIN_TEST_POINTS_COUNT - position;
+        batch(perlin, &x[position], &y[position], &z[position], &noises[position], count);
+        position += count;
+        batch_size = batch_size % 67 + 1;
+    }
+
+    int differences_count = 0;
+    for (int i = 0; i < PERLIN_TEST_POINTS_COUNT; i++) {
+        if (noises[i] != expected_noises[i]) {
+            differences_count++;
+        }
+    }
+    printf("%-6s | %d points | %d differ from the scalar noise\n", name, PERLIN_TEST_POINTS_COUNT, differences_count);
+    TEST_ASSERT(differences_count == 0);
+}
+
+// Time a batch over all points in rows of 32 points like the terrain generator does and return the time
+double perlin_test_benchmark(char* name, PerlinTestBatch batch, PerlinNoise* perlin, double* x, double* y, double* z, double* noises, double scalar_time) {
+    double time = test_get_time();
+    for (int round = 0; round < PERLIN_TEST_BENCHMARK_ROUNDS_COUNT; round++) {
+        for (int i = 0; i < PERLIN_TEST_POINTS_COUNT; i += 32) {
+            batch(perlin, &x[i], &y[i], &z[i], &noises[i], 32);
+        }
+    }
+    time = (test_get_time() - time) / PERLIN_TEST_BENCHMARK_ROUNDS_COUNT;
+    printf("%-6s | %.2f ns per point | %.2fx the scalar noise\n", name, time / PERLIN_TEST_POINTS_COUNT * 1e9,
+        scalar_time > 0 ? scalar_time / time : 1);
+    return time;
+}
+
+int main(void) {
+    double* x = malloc(PERLIN_TEST_POINTS_COUNT * sizeof(double));
+    double* y = malloc(PERLIN_TEST_POINTS_COUNT * sizeof(double));
+    double* z = malloc(PERLIN_TEST_POINTS_COUNT * sizeof(double));
+    double* expected_noises = malloc(PERLIN_TEST_POINTS_COUNT * sizeof(double));
+    double* noises = malloc(PERLIN_TEST_POINTS_COUNT * sizeof(double));
+    perlin_test_fill_points(x, y, z);
+
+    // The original permutation and a seeded permutation
+    for (int is_permutation_seeded = 0; is_permutation_seeded < 2; is_permutation_seeded++) {
+        PerlinNoise* perlin = perlin_new(1234, is_permutation_seeded);
+        perlin_test_noise_scalar(perlin, x, y, z, expected_noises, PERLIN_TEST_POINTS_COUNT);
+        perlin_test_compare("batch", perlin_noise_batch, perlin, x, y, z, expected_noises, noises);
+        #ifndef NO_SIMD
+            perlin_test_compare("sse2", perlin_noise_batch_sse2, perlin, x, y, z, expected_noises, noises);
+            if (__builtin_cpu_supports("avx2")) {
+                perlin_test_compare("avx2", perlin_noise_batch_avx2, perlin, x, y, z, expected_noises, noises);
+            }
+        #endif
+        perlin_free(perlin);
+    }
+
+    PerlinNoise* perlin = perlin_new(1234, true);
+    double scalar_time = perlin_test_benchmark("scalar", perlin_test_noise_scalar, perlin, x, y, z, noises, 0);
+    perlin_test_benchmark("batch", perlin_noise_batch, perlin, x, y, z, noises, scalar_time);
+    #ifndef NO_SIMD
+        perlin_test_benchmark("sse2", perlin_noise_batch_sse2, perlin, x, y, z, noises, scalar_time);
+        if (__builtin_cpu_supports("avx2")) {
+            perlin_test_benchmark("avx2", perlin_noise_batch_avx2, perlin, x, y, z, noises, scalar_time);
+        }
+    #endif
+    perlin_free(perlin);
+
+    free(x);
+    free(y);
+    free(z);
+    free(expected_noises);
+    free(noises);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+// PlaatCraft - Random Test
+
+#include "test.h"
+#include <string.h>
+#include "chunk.h"
+#include "log.h"
+#include "random.h"
+#include "world.h"
+
+#define RANDOM_TEST_NUMBERS_COUNT 1000000
+#define RANDOM_TEST_SIZE 4 // Chunks per side of the decoration test area
+#define RANDOM_TEST_CHUNKS_COUNT (RANDOM_TEST_SIZE * RANDOM_TEST_SIZE * RANDOM_TEST_SIZE)
+#define RANDOM_TEST_BLOCKS_COUNT (1 << 22)
+
+// The same seed and block position always give the same numbers, an other position or seed other numbers
+void random_test_streams(void) {
+    Random* random = random_new_counter_based(1234);
+    Random* other_random = random_new_counter_based(1234);
+    random_seek(random, 5, -7, 9);
+    random_seek(other_random, 5, -7, 9);
+    for (int i = 0; i < 64; i++) {
+        TEST_ASSERT(random_random(random) == random_random(other_random));
+    }
+
+    // Seeking again starts the stream again
+    random_seek(random, 5, -7, 9);
+    double number = random_random(random);
+    random_seek(random, 5, -7, 9);
+    TEST_ASSERT(random_random(random) == number);
+
+    int positions[][3] = { { 5, -7, 8 }, { 4, -7, 9 }, { 5, 7, 9 }, { -7, 5, 9 }, { 9, -7, 5 } };
+    for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++) {
+        random_seek(other_random, positions[i][0], positions[i][1], positions[i][2]);
+        TEST_ASSERT(random_random(other_random) != number);
+    }
+    random_free(other_random);
+    other_random = random_new_counter_based(1235);
+    random_seek(other_random, 5, -7, 9);
+    TEST_ASSERT(random_random(other_random) != number);
+    random_free(other_random);
+
+    // The numbers are in [0, 1) and spread evenly over the buckets of random_rand
+    int counts[10] = { 0 };
+    for (int i = 0; i < RANDOM_TEST_NUMBERS_COUNT; i++) {
+        if (i % 16 == 0) {
+            random_seek(random, i, i / 7, -i);
+        }
+        double number = random_random(random);
+        TEST_ASSERT(number >= 0 && number < 1);
+        int bucket = random_rand(random, 1, 10);
+        TEST_ASSERT(bucket >= 1 && bucket <= 10);
+        counts[bucket - 1]++;
+    }
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT(counts[i] > RANDOM_TEST_NUMBERS_COUNT / 10 * 0.98 && counts[i] < RANDOM_TEST_NUMBERS_COUNT / 10 * 1.02);
+    }
+    random_free(random);
+}
+
+// A world with only the parts that the generator uses
+World* random_test_world_new(int64_t seed, int generator_version) {
+    World* world = calloc(1, sizeof(World));
+    world->seed = seed;
+    world->generator_version = generator_version;
+    world->perlin = perlin_new(seed, generator_version >= 2);
+    world->column_cache = column_cache_new(WORLD_COLUMN_CACHE_COUNT);
+    return world;
+}
+
+void random_test_world_free(World* world) {
+    perlin_free(world->perlin);
+    column_cache_free(world->column_cache);
+    free(world);
+}
+
+void random_test_generate_chunk(World* world, int chunk_x, int chunk_y, int chunk_z, uint16_t* chunk_data) {
+    Chunk* chunk = chunk_new_from_generator(world, chunk_x, chunk_y, chunk_z);
+    chunk_storage_decode(chunk->storage, chunk_data);
+    chunk_free(chunk);
+}
+
+// Count the blocks where both chunks have the same ore, deep chunks are only stone and ores
+int random_test_count_same_ores(World* world, int chunk_x, int chunk_y, int chunk_z, int other_chunk_x, int other_chunk_y, int other_chunk_z) {
+    uint16_t chunk_data[CHUNK_DATA_SIZE];
+    uint16_t other_chunk_data[CHUNK_DATA_SIZE];
+    random_test_generate_chunk(world, chunk_x, chunk_y, chunk_z, chunk_data);
+    random_test_generate_chunk(world, other_chunk_x, other_chunk_y, other_chunk_z, other_chunk_data);
+    int same_ores_count = 0;
+    for (int i = 0; i < CHUNK_DATA_SIZE; i++) {
+        same_ores_count += chunk_data[i] != BLOCK_TYPE_STONE && chunk_data[i] == other_chunk_data[i];
+    }
+    return same_ores_count;
+}
+
+// Worlds of the same seed decorate every chunk the same in any generate order, an other seed decorates
+// them differently and chunks with the same coordinate sum don't share there ores anymore
+void random_test_decoration(void) {
+    World* world = random_test_world_new(1234, 3);
+    World* other_world = random_test_world_new(1234, 3);
+    World* other_seed_world = random_test_world_new(4321, 3);
+    int different_chunks_count = 0;
+    for (int i = 0; i < RANDOM_TEST_CHUNKS_COUNT; i++) {
+        int chunk_x = i % RANDOM_TEST_SIZE;
+        int chunk_y = i / RANDOM_TEST_SIZE % RANDOM_TEST_SIZE - RANDOM_TEST_SIZE / 2;
+        int chunk_z = i / (RANDOM_TEST_SIZE * RANDOM_TEST_SIZE);
+        int other_i = RANDOM_TEST_CHUNKS_COUNT - 1 - i;
+        uint16_t chunk_data[CHUNK_DATA_SIZE];
+        uint16_t other_chunk_data[CHUNK_DATA_SIZE];
+        random_test_generate_chunk(world, chunk_x, chunk_y, chunk_z, chunk_data);
+        random_test_generate_chunk(other_world, other_i % RANDOM_TEST_SIZE, other_i / RANDOM_TEST_SIZE % RANDOM_TEST_SIZE - RANDOM_TEST_SIZE / 2,
+            other_i / (RANDOM_TEST_SIZE * RANDOM_TEST_SIZE), other_chunk_data);
+        random_test_generate_chunk(other_world, chunk_x, chunk_y, chunk_z, other_chunk_data);
+        TEST_ASSERT(!memcmp(chunk_data, other_chunk_data, sizeof(chunk_data)));
+
+        random_test_generate_chunk(other_seed_world, chunk_x, chunk_y, chunk_z, other_chunk_data);
+        different_chunks_count += memcmp(chunk_data, other_chunk_data, sizeof(chunk_data)) != 0;
+    }
+    TEST_ASSERT(different_chunks_count > RANDOM_TEST_CHUNKS_COUNT / 2);
+
+    World* sin_world = random_test_world_new(1234, 2);
+    int sin_same_ores_count = random_test_count_same_ores(sin_world, 0, -8, 1, 1, -8, 0);
+    int same_ores_count = random_test_count_same_ores(world, 0, -8, 1, 1, -8, 0);
+    TEST_ASSERT(sin_same_ores_count > 0);
+    TEST_ASSERT(same_ores_count < sin_same_ores_count / 4);
+    printf("decorate | %d chunks the same in both orders | %d differ with an other seed | same ores of chunks 0 -8 1 and 1 -8 0: sin %d, counter %d\n",
+        RANDOM_TEST_CHUNKS_COUNT, different_chunks_count, sin_same_ores_count, same_ores_count);
+
+    random_test_world_free(sin_world);
+    random_test_world_free(world);
+    random_test_world_free(other_world);
+    random_test_world_free(other_seed_world);
+}
+
+// Decorate stone blocks like the generator does, the counter based random seeks to every block first
+double random_test_benchmark(char* name, Random* random, double sin_time) {
+    int ores_count = 0;
+    double time = test_get_time();
+    for (int i = 0; i < RANDOM_TEST_BLOCKS_COUNT; i++) {
+        random_seek(random, i % CHUNK_SIZE, i / CHUNK_SIZE % CHUNK_SIZE, i / (CHUNK_SIZE * CHUNK_SIZE));
+        if (random_rand(random, 1, 75) == 1 || random_rand(random, 1, 100) == 1) {
+            ores_count++;
+        }
+    }
+    time = test_get_time() - time;
+
+    // 1 / 75 + 74 / 75 / 100 = 2.32% of the blocks are ores, the sin random is too uneven to get this
+    double ores_ratio = (double)ores_count / RANDOM_TEST_BLOCKS_COUNT;
+    if (random->is_counter_based) {
+        TEST_ASSERT(ores_ratio > 0.0228 && ores_ratio < 0.0236);
+    }
+    printf("%-8s | %d blocks %.1f ms | %.1f ns per block | %.2f%% ores | %.2fx the sin random\n", name, RANDOM_TEST_BLOCKS_COUNT,
+        time * 1000, time / RANDOM_TEST_BLOCKS_COUNT * 1e9, ores_ratio * 100, sin_time > 0 ? sin_time / time : 1);
+    return time;
+}
+
+int main(void) {
+    log_init();
+    chunk_init_slabs();
+    slab_thread_start();
+
+    random_test_streams();
+    random_test_decoration();
+
+    Random* random = random_new(1234);
+    double sin_time = random_test_benchmark("sin", random, 0);
+    random_free(random);
+    random = random_new_counter_based(1234);
+    random_test_benchmark("counter", random, sin_time);
+    random_free(random);
+
+    slab_thread_stop();
+    log_close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+// PlaatCraft - Request Test
+
+#include "test.h"
+#include <stdint.h>
+#include <string.h>
+#include "log.h"
+#include "request_queue.h"
+#include "request_set.h"
+
+#define REQUEST_TEST_QUEUE_CAPACITY 256
+#define REQUEST_TEST_ITEMS_COUNT 400000
+#define REQUEST_TEST_SET_CAPACITY 64
+#define REQUEST_TEST_SET_KEYS_COUNT 28 // Keys the writer thread adds and removes, the set is almost half full
+#define REQUEST_TEST_SET_ROUNDS_COUNT 20000
+
+typedef struct RequestTestQueue {
+    RequestQueue* request_queue;
+    int producers_count;
+    int producer_index;
+    int popped_count;
+    int* seen_counts;
+} RequestTestQueue;
+
+// Every producer pushes its share of the items, an item is its number plus one because NULL means empty
+int request_test_producer_thread(void* argument) {
+    RequestTestQueue* test_queue = argument;
+    int producer_index = __atomic_fetch_add(&test_queue->producer_index, 1, __ATOMIC_RELAXED);
+    for (int i = producer_index; i < REQUEST_TEST_ITEMS_COUNT; i += test_queue->producers_count) {
+        while (!request_queue_push(test_queue->request_queue, (void*)(uintptr_t)(i + 1))) {
+            thrd_yield();
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Every consumer pops items until all items are popped and counts how often it saw them
+int request_test_consumer_thread(void* argument) {
+    RequestTestQueue* test_queue = argument;
+    while (__atomic_load_n(&test_queue->popped_count, __ATOMIC_RELAXED) < REQUEST_TEST_ITEMS_COUNT) {
+        void* item = request_queue_pop(test_queue->request_queue);
+        if (item == NULL) {
+            thrd_yield();
+            continue;
+        }
+        int i = (int)(uintptr_t)item - 1;
+        TEST_ASSERT(i >= 0 && i < REQUEST_TEST_ITEMS_COUNT);
+        __atomic_fetch_add(&test_queue->seen_counts[i], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&test_queue->popped_count, 1, __ATOMIC_RELAXED);
+    }
+    return EXIT_SUCCESS;
+}
+
+// Push and pop all items with some producer and consumer threads and check that every item is popped exactly once
+void request_test_queue(int producers_count, int consumers_count) {
+    RequestTestQueue test_queue;
+    test_queue.request_queue = request_queue_new(REQUEST_TEST_QUEUE_CAPACITY);
+    test_queue.producers_count = producers_count;
+    test_queue.producer_index = 0;
+    test_queue.popped_count = 0;
+    test_queue.seen_counts = calloc(REQUEST_TEST_ITEMS_COUNT, sizeof(int));
+
+    thrd_t threads[16];
+    double time = test_get_time();
+    for (int i = 0; i < producers_count; i++) {
+        thrd_create(&threads[i], request_test_producer_thread, &test_queue);
+    }
+    for (int i = 0; i < consumers_count; i++) {
+        thrd_create(&threads[producers_count + i], request_test_consumer_thread, &test_queue);
+    }
+    for (int i = 0; i < producers_count + consumers_count; i++) {
+        thrd_join(threads[i], NULL);
+    }
+    time = test_get_time() - time;
+
+    for (int i = 0; i < REQUEST_TEST_ITEMS_COUNT; i++) {
+        TEST_ASSERT(test_queue.seen_counts[i] == 1);
+    }
+    TEST_ASSERT(request_queue_pop(test_queue.request_queue) == NULL);
+
+    printf("queue | %d producers %d consumers | %d items %.1f ms | %.2f million items per second\n",
+        producers_count, consumers_count, REQUEST_TEST_ITEMS_COUNT, time * 1000, REQUEST_TEST_ITEMS_COUNT / time / 1e6);
+    free(test_queue.seen_counts);
+    request_queue_free(test_queue.request_queue);
+}
+
+// Fill the queue to its capacity and empty it again in the same order
+void request_test_queue_bounds(void) {
+    RequestQueue* request_queue = request_queue_new(REQUEST_TEST_QUEUE_CAPACITY);
+    for (int round = 0; round < 3; round++) {
+        TEST_ASSERT(request_queue_pop(request_queue) == NULL);
+        for (int i = 0; i < REQUEST_TEST_QUEUE_CAPACITY; i++) {
+            TEST_ASSERT(request_queue_push(request_queue, (void*)(uintptr_t)(i + 1)));
+        }
+        TEST_ASSERT(!request_queue_push(request_queue, (void*)1));
+        for (int i = 0; i < REQUEST_TEST_QUEUE_CAPACITY; i++) {
+            TEST_ASSERT(request_queue_pop(request_queue) == (void*)(uintptr_t)(i + 1));
+        }
+    }
+    request_queue_free(request_queue);
+}
+
+// Add and remove random keys and compare the set with a simple array of the keys in it
+void request_test_set_model(void) {
+    RequestSet* request_set = request_set_new(REQUEST_TEST_SET_CAPACITY);
+    bool is_added[REQUEST_TEST_SET_CAPACITY] = { false };
+    int keys_count = 0;
+    srand(REQUEST_TEST_SET_CAPACITY);
+    for (int i = 0; i < REQUEST_TEST_ITEMS_COUNT; i++) {
+        int key = rand() % REQUEST_TEST_SET_CAPACITY;
+        if (rand() % 2 == 0 && keys_count < REQUEST_TEST_SET_CAPACITY * 3 / 4) {
+            TEST_ASSERT(request_set_add(request_set, key + 1) == !is_added[key]);
+            keys_count += !is_added[key];
+            is_added[key] = true;
+        } else {
+            request_set_remove(request_set, key + 1);
+            keys_count -= is_added[key];
+            is_added[key] = false;
+        }
+
+        int other_key = rand() % REQUEST_TEST_SET_CAPACITY;
+        TEST_ASSERT(request_set_contains(request_set, other_key + 1) == is_added[other_key]);
+    }
+    request_set_free(request_set);
+}
+
+typedef struct RequestTestSet {
+    RequestSet* request_set;
+    bool is_running;
+    int contains_count;
+} RequestTestSet;
+
+// The stable keys are odd and always in the set, the writer adds and removes the even keys around them
+// so the backward shift deletion moves the stable keys while the readers look for them
+int request_test_set_writer_thread(void* argument) {
+    RequestTestSet* test_set = argument;
+    for (int round = 0; round < REQUEST_TEST_SET_ROUNDS_COUNT; round++) {
+        for (int i = 0; i < REQUEST_TEST_SET_KEYS_COUNT / 2; i++) {
+            TEST_ASSERT(request_set_add(test_set->request_set, (uint64_t)(round * REQUEST_TEST_SET_KEYS_COUNT + i) * 2 + 2));
+        }
+        for (int i = 0; i < REQUEST_TEST_SET_KEYS_COUNT / 2; i++) {
+            request_set_remove(test_set->request_set, (uint64_t)(round * REQUEST_TEST_SET_KEYS_COUNT + i) * 2 + 2);
+        }
+        if (round % 64 == 0) {
+            thrd_yield();
+        }
+    }
+    __atomic_store_n(&test_set->is_running, false, __ATOMIC_RELEASE);
+    return EXIT_SUCCESS;
+}
+
+int request_test_set_reader_thread(void* argument) {
+    RequestTestSet* test_set = argument;
+    int contains_count = 0;
+    while (__atomic_load_n(&test_set->is_running, __ATOMIC_ACQUIRE)) {
+        for (int i = 0; i < REQUEST_TEST_SET_KEYS_COUNT / 2; i++) {
+            TEST_ASSERT(request_set_contains(test_set->request_set, i * 2 + 1));
+        }
+        TEST_ASSERT(!request_set_contains(test_set->request_set, REQUEST_TEST_SET_KEYS_COUNT + 1));
+        contains_count += REQUEST_TEST_SET_KEYS_COUNT / 2 + 1;
+    }
+    __atomic_fetch_add(&test_set->contains_count, contains_count, __ATOMIC_RELAXED);
+    return EXIT_SUCCESS;
+}
+
+// Look for the stable keys with some reader threads while the writer thread changes the set
+void request_test_set(int readers_count) {
+    RequestTestSet test_set;
+    test_set.request_set = request_set_new(REQUEST_TEST_SET_CAPACITY);
+    test_set.is_running = true;
+    test_set.contains_count = 0;
+    for (int i = 0; i < REQUEST_TEST_SET_KEYS_COUNT / 2; i++) {
+        TEST_ASSERT(request_set_add(test_set.request_set, i * 2 + 1));
+    }
+
+    thrd_t threads[16];
+    double time = test_get_time();
+    thrd_create(&threads[0], request_test_set_writer_thread, &test_set);
+    for (int i = 0; i < readers_count; i++) {
+        thrd_create(&threads[1 + i], request_test_set_reader_thread, &test_set);
+    }
+    for (int i = 0; i < 1 + readers_count; i++) {
+        thrd_join(threads[i], NULL);
+    }
+    time = test_get_time() - time;
+
+    int changes_count = REQUEST_TEST_SET_ROUNDS_COUNT * REQUEST_TEST_SET_KEYS_COUNT;
+    printf("set   | 1 writer %d readers | %d adds and removes %.1f ms | %.2f million contains per second\n",
+        readers_count, changes_count, time * 1000, test_set.contains_count / time / 1e6);
+    request_set_free(test_set.request_set);
+}
+
+int main(void) {
+    log_init();
+
+    request_test_queue_bounds();
+    for (int producers_count = 1; producers_count <= 4; producers_count *= 4) {
+        for (int consumers_count = 1; consumers_count <= 8; consumers_count *= 2) {
+            request_test_queue(producers_count, consumers_count);
+        }
+    }
+
+    request_test_set_model();
+    request_test_set(1);
+    request_test_set(4);
+
+    log_close();
+    return EXIT_SUCCESS;
+}
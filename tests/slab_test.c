@@ -0,0 +1,206 @@
+// PlaatCraft - Slab Test
+
+#include "test.h"
+#include <stdint.h>
+#include <string.h>
+#include "log.h"
+#include "slab.h"
+
+#define SLAB_TEST_THREADS_COUNT 4
+#define SLAB_TEST_OBJECTS_COUNT 20000 // Objects every thread allocates, more then one region holds
+#define SLAB_TEST_ROUNDS_COUNT 8
+#define SLAB_TEST_WINDOW_COUNT 2048 // Objects the churn benchmark keeps alive, like the chunks around a flying player
+#define SLAB_TEST_CHURN_COUNT 2000000
+
+typedef struct SlabTestThreads {
+    Slab* slab;
+    uint64_t** objects;
+    int round;
+} SlabTestThreads;
+
+typedef struct SlabTestThread {
+    SlabTestThreads* test_threads;
+    int index;
+} SlabTestThread;
+
+uint64_t slab_test_get_stamp(int thread_index, int object_index, int round) {
+    return ((uint64_t)round << 48) | ((uint64_t)thread_index << 32) | (uint64_t)object_index;
+}
+
+// Allocate the objects of this thread and stamp them
+int slab_test_allocate_thread(void* argument) {
+    SlabTestThread* test_thread = argument;
+    SlabTestThreads* test_threads = test_thread->test_threads;
+    slab_thread_start();
+    for (int i = 0; i < SLAB_TEST_OBJECTS_COUNT; i++) {
+        uint64_t* object = slab_allocate(test_threads->slab);
+        TEST_ASSERT(((uintptr_t)object & 15) == 0);
+        object[0] = slab_test_get_stamp(test_thread->index, i, test_threads->round);
+        object[1] = ~object[0];
+        test_threads->objects[test_thread->index * SLAB_TEST_OBJECTS_COUNT + i] = object;
+    }
+    slab_thread_stop();
+    return EXIT_SUCCESS;
+}
+
+// Check the stamps of the objects of the next thread and deallocate them, so every object is freed
+// by an other thread then the one that allocated it
+int slab_test_deallocate_thread(void* argument) {
+    SlabTestThread* test_thread = argument;
+    SlabTestThreads* test_threads = test_thread->test_threads;
+    int other_index = (test_thread->index + 1) % SLAB_TEST_THREADS_COUNT;
+    slab_thread_start();
+    for (int i = 0; i < SLAB_TEST_OBJECTS_COUNT; i++) {
+        uint64_t* object = test_threads->objects[other_index * SLAB_TEST_OBJECTS_COUNT + i];
+        TEST_ASSERT(object[0] == slab_test_get_stamp(other_index, i, test_threads->round));
+        TEST_ASSERT(object[1] == ~object[0]);
+        slab_deallocate(test_threads->slab, object);
+    }
+    slab_thread_stop();
+    return EXIT_SUCCESS;
+}
+
+int slab_test_compare_objects(const void* a, const void* b) {
+    uintptr_t object_a = *(uintptr_t*)a;
+    uintptr_t object_b = *(uintptr_t*)b;
+    return (object_a > object_b) - (object_a < object_b);
+}
+
+void slab_test_run_threads(SlabTestThreads* test_threads, int (*thread_function)(void* argument)) {
+    thrd_t threads[SLAB_TEST_THREADS_COUNT];
+    SlabTestThread test_thread[SLAB_TEST_THREADS_COUNT];
+    for (int i = 0; i < SLAB_TEST_THREADS_COUNT; i++) {
+        test_thread[i].test_threads = test_threads;
+        test_thread[i].index = i;
+        thrd_create(&threads[i], thread_function, &test_thread[i]);
+    }
+    for (int i = 0; i < SLAB_TEST_THREADS_COUNT; i++) {
+        thrd_join(threads[i], NULL);
+    }
+}
+
+// Allocate objects on some threads and free them on other threads for some rounds, no object may be handed
+// out twice and after the first round all objects come from the free objects and thread caches again
+void slab_test_threads(void) {
+    SlabTestThreads test_threads;
+    test_threads.slab = slab_new(24);
+    test_threads.objects = malloc(SLAB_TEST_THREADS_COUNT * SLAB_TEST_OBJECTS_COUNT * sizeof(uint64_t*));
+    TEST_ASSERT(test_threads.slab->object_size == 32);
+
+    size_t memory_size = 0;
+    for (test_threads.round = 0; test_threads.round < SLAB_TEST_ROUNDS_COUNT; test_threads.round++) {
+        slab_test_run_threads(&test_threads, slab_test_allocate_thread);
+        TEST_ASSERT(test_threads.slab->used_count == SLAB_TEST_THREADS_COUNT * SLAB_TEST_OBJECTS_COUNT);
+
+        uint64_t** sorted_objects = malloc(SLAB_TEST_THREADS_COUNT * SLAB_TEST_OBJECTS_COUNT * sizeof(uint64_t*));
+        memcpy(sorted_objects, test_threads.objects, SLAB_TEST_THREADS_COUNT * SLAB_TEST_OBJECTS_COUNT * sizeof(uint64_t*));
+        qsort(sorted_objects, SLAB_TEST_THREADS_COUNT * SLAB_TEST_OBJECTS_COUNT, sizeof(uint64_t*), slab_test_compare_objects);
+        for (int i = 1; i < SLAB_TEST_THREADS_COUNT * SLAB_TEST_OBJECTS_COUNT; i++) {
+            TEST_ASSERT((uintptr_t)sorted_objects[i] - (uintptr_t)sorted_objects[i - 1] >= test_threads.slab->object_size);
+        }
+        free(sorted_objects);
+
+        slab_test_run_threads(&test_threads, slab_test_deallocate_thread);
+        TEST_ASSERT(test_threads.slab->used_count == 0);
+
+        // The thread caches can hold some objects more then the first round needed, but never a region of them
+        if (test_threads.round == 0) {
+            memory_size = slab_get_memory_size(test_threads.slab);
+        }
+        TEST_ASSERT(slab_get_memory_size(test_threads.slab) <= memory_size + SLAB_REGION_SIZE);
+    }
+    printf("threads | %d threads %d rounds | %d objects | %d KB mapped after the first round, %d KB after the last\n",
+        SLAB_TEST_THREADS_COUNT, SLAB_TEST_ROUNDS_COUNT, SLAB_TEST_THREADS_COUNT * SLAB_TEST_OBJECTS_COUNT,
+        (int)(memory_size / 1024), (int)(slab_get_memory_size(test_threads.slab) / 1024));
+    free(test_threads.objects);
+    slab_free(test_threads.slab);
+}
+
+// A freed object is handed out again first, with a thread cache and on the locked path
+void slab_test_reuse(void) {
+    for (int has_thread_cache = 0; has_thread_cache < 2; has_thread_cache++) {
+        if (has_thread_cache) {
+            slab_thread_start();
+        }
+        Slab* slab = slab_new(100);
+        TEST_ASSERT(slab->object_size == 112);
+        void* object = slab_allocate(slab);
+        slab_deallocate(slab, object);
+        TEST_ASSERT(slab_allocate(slab) == object);
+
+        // Objects that went back from a full thread cache to the free objects are reused too
+        void* objects[SLAB_THREAD_CACHE_COUNT * 4];
+        for (int i = 0; i < SLAB_THREAD_CACHE_COUNT * 4; i++) {
+            objects[i] = slab_allocate(slab);
+        }
+        size_t memory_size = slab_get_memory_size(slab);
+        for (int round = 0; round < 16; round++) {
+            for (int i = 0; i < SLAB_THREAD_CACHE_COUNT * 4; i++) {
+                slab_deallocate(slab, objects[i]);
+            }
+            for (int i = 0; i < SLAB_THREAD_CACHE_COUNT * 4; i++) {
+                objects[i] = slab_allocate(slab);
+            }
+        }
+        TEST_ASSERT(slab_get_memory_size(slab) == memory_size);
+        TEST_ASSERT(slab->used_count == SLAB_THREAD_CACHE_COUNT * 4 + 1);
+        slab_free(slab);
+        if (has_thread_cache) {
+            slab_thread_stop();
+        }
+    }
+}
+
+// Keep a window of objects alive and replace the oldest object with a new one, like the chunk cache
+// evicts the chunks behind a flying player and loads the chunks in front of it
+double slab_test_churn(char* name, Slab* slab, size_t object_size, double malloc_time) {
+    void** window = calloc(SLAB_TEST_WINDOW_COUNT, sizeof(void*));
+    double time = test_get_time();
+    for (int i = 0; i < SLAB_TEST_CHURN_COUNT; i++) {
+        void** object = &window[i % SLAB_TEST_WINDOW_COUNT];
+        if (*object != NULL) {
+            if (slab != NULL) {
+                slab_deallocate(slab, *object);
+            } else {
+                free(*object);
+            }
+        }
+        *object = slab != NULL ? slab_allocate(slab) : malloc(object_size);
+        memset(*object, i, 64);
+    }
+    for (int i = 0; i < SLAB_TEST_WINDOW_COUNT; i++) {
+        if (slab != NULL) {
+            slab_deallocate(slab, window[i]);
+        } else {
+            free(window[i]);
+        }
+    }
+    time = test_get_time() - time;
+    printf("%-7s | %5d byte objects | %d allocations %.1f ms | %.1f ns per allocation | %.2fx malloc\n", name, (int)object_size,
+        SLAB_TEST_CHURN_COUNT, time * 1000, time / SLAB_TEST_CHURN_COUNT * 1e9, malloc_time > 0 ? malloc_time / time : 1);
+    free(window);
+    return time;
+}
+
+void slab_test_benchmark(size_t object_size) {
+    double malloc_time = slab_test_churn("malloc", NULL, object_size, 0);
+
+    Slab* slab = slab_new(object_size);
+    slab_test_churn("locked", slab, object_size, malloc_time);
+    slab_thread_start();
+    slab_test_churn("cached", slab, object_size, malloc_time);
+    slab_thread_stop();
+    slab_free(slab);
+}
+
+int main(void) {
+    log_init();
+
+    slab_test_reuse();
+    slab_test_threads();
+    slab_test_benchmark(64);
+    slab_test_benchmark(8192);
+
+    log_close();
+    return EXIT_SUCCESS;
+}
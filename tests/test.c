@@ -0,0 +1,10 @@
+// PlaatCraft - Test
+
+#include "test.h"
+
+// Get the wall clock time in seconds for the benchmarks
+double test_get_time(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
@@ -0,0 +1,19 @@
+// PlaatCraft - Test Header
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tinycthread/tinycthread.h"
+
+// Stop the test with an error when the condition is false
+#define TEST_ASSERT(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "[FAIL] %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+        exit(EXIT_FAILURE); \
+    }
+
+double test_get_time(void);
+
+#endif